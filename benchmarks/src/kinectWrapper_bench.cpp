@@ -0,0 +1,645 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+\defgroup kinectWrapper_bench kinectWrapper_bench
+
+Microbenchmarks of the per-frame loops of the library.
+
+\section intro_sec Description
+Each loop run on every depth, rgb, players or skeleton frame is timed
+on synthetic data at 320x240, 640x480 and 1280x1024: the unpacking of
+the client, the point cloud and voxel grid projections, the software
+registration, the undistortion of depth and rgb, the extrinsic
+transform of the clouds, the packing of rgbd:o and the fusion of the
+skeletons seen by several sensors. No device and no
+YARP network are needed, hence the benchmark builds and runs even
+without OpenNI or the Kinect SDK.
+
+For every kernel and resolution the best time over a number of rounds
+is reported as ns/pixel, together with the memory bandwidth in GB/s
+computed on the bytes read and written by the kernel. Skeleton parsing
+and fusion are reported per joint, the bandwidth of the parsing on the
+size of the Bottle in text form, the one of the fusion on the size of
+the input joints.
+
+\section parameters_sec Parameters
+--time \e t
+- the minimum time in seconds spent on each kernel and resolution,
+  by default 0.5.
+
+--rounds \e n
+- the number of rounds the time is split into, by default 5.
+
+--bands \e n
+- the number of bands the voxel grid splits the frames in, by
+  default 1.
+
+\section tested_os_sec Tested OS
+Windows, Linux
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <deque>
+#include <vector>
+
+#include <yarp/os/Property.h>
+#include <yarp/os/Bottle.h>
+
+#include <kinectWrapper/kinectWrapper_client.h>
+#include <kinectWrapper/kinectKernels.h>
+#include <kinectWrapper/kinectCloud.h>
+#include <kinectWrapper/kinectVoxelGrid.h>
+#include <kinectWrapper/kinectRegistration.h>
+#include <kinectWrapper/kinectUndistortion.h>
+#include <kinectWrapper/kinectExtrinsics.h>
+#include <kinectWrapper/kinectRgbd.h>
+#include <kinectWrapper/kinectSkeletonFusion.h>
+#include <kinectWrapper/kinectClock.h>
+
+using namespace std;
+using namespace yarp::os;
+using namespace yarp::sig;
+using namespace kinectWrapper;
+
+
+/************************************************************************/
+class BenchClient : public KinectWrapperClient
+{
+public:
+    /************************************************************************/
+    void setup(const int width, const int height)
+    {
+        depth_width=width;
+        depth_height=height;
+        allocateBuffers();
+    }
+
+    /************************************************************************/
+    void release()
+    {
+        releaseBuffers();
+    }
+
+    /************************************************************************/
+    deque<Player> parse(Bottle *skeleton)
+    {
+        return getJoints(skeleton);
+    }
+};
+
+
+/************************************************************************/
+class Frame
+{
+public:
+    int width;
+    int height;
+    int pixels;
+    unsigned short *depth;
+    unsigned short *labels;
+    unsigned short *packed;
+    unsigned short *unpacked;
+    float *scaled;
+    Matrix players;
+    ImageOf<PixelMono16> depthIm;
+    ImageOf<PixelMono16> packedIm;
+    ImageOf<PixelRgb> rgbIm;
+    IplImage *sensor;
+    IplImage *halved;
+
+    /************************************************************************/
+    Frame(const int width, const int height) : width(width), height(height)
+    {
+        pixels=width*height;
+        depth=new unsigned short[pixels];
+        labels=new unsigned short[pixels];
+        packed=new unsigned short[pixels];
+        unpacked=new unsigned short[pixels];
+        scaled=new float[pixels];
+
+        // a ramp of depths in the sensor range with two players standing in front
+        srand(0);
+        for (int v=0; v<height; v++)
+        {
+            for (int u=0; u<width; u++)
+            {
+                int i=v*width+u;
+                depth[i]=(unsigned short)(800+(3200*v)/height+(rand()%16));
+                if ((u>width/5) && (u<2*width/5) && (v>height/4))
+                    labels[i]=1;
+                else if ((u>3*width/5) && (u<4*width/5) && (v>height/3))
+                    labels[i]=2;
+                else
+                    labels[i]=0;
+            }
+        }
+        packDepthPlayers(depth,labels,packed,pixels);
+
+        players.resize(height,width);
+        unpackPlayers(packed,players.data(),pixels);
+
+        depthIm.resize(width,height);
+        packedIm.resize(width,height);
+        for (int v=0; v<height; v++)
+        {
+            memcpy(depthIm.getRow(v),depth+v*width,width*sizeof(unsigned short));
+            memcpy(packedIm.getRow(v),packed+v*width,width*sizeof(unsigned short));
+        }
+
+        rgbIm.resize(width,height);
+        for (int v=0; v<height; v++)
+        {
+            for (int u=0; u<width; u++)
+            {
+                PixelRgb &p=rgbIm.pixel(u,v);
+                p.r=(unsigned char)u;
+                p.g=(unsigned char)v;
+                p.b=(unsigned char)(rand()%256);
+            }
+        }
+
+        sensor=cvCreateImageHeader(cvSize(width,height),IPL_DEPTH_16U,1);
+        cvSetData(sensor,packed,width*sizeof(unsigned short));
+        halved=cvCreateImage(cvSize(width/2,height/2),IPL_DEPTH_16U,1);
+    }
+
+    /************************************************************************/
+    ~Frame()
+    {
+        cvReleaseImageHeader(&sensor);
+        cvReleaseImage(&halved);
+        delete[] depth;
+        delete[] labels;
+        delete[] packed;
+        delete[] unpacked;
+        delete[] scaled;
+    }
+};
+
+
+/************************************************************************/
+class Kernel
+{
+public:
+    virtual ~Kernel() { }
+    virtual const char *name() const = 0;
+    virtual void run(Frame &frame) = 0;
+    virtual int items(const Frame &frame) const { return frame.pixels; }
+    virtual double bytes(const Frame &frame) const = 0;
+};
+
+
+namespace
+{
+
+/************************************************************************/
+class Pack : public Kernel
+{
+public:
+    const char *name() const { return "pack depth+players"; }
+    void run(Frame &f) { packDepthPlayers(f.depth,f.labels,f.packed,f.pixels); }
+    double bytes(const Frame &f) const { return 6.0*f.pixels; }
+};
+
+
+/************************************************************************/
+class Decimate : public Kernel
+{
+public:
+    const char *name() const { return "decimate depth"; }
+    void run(Frame &f) { decimateDepth(f.sensor,f.halved); }
+    int items(const Frame &f) const { return f.pixels/4; }
+    double bytes(const Frame &f) const { return 4.0*(f.pixels/4); }
+};
+
+
+/************************************************************************/
+class UnpackDepth : public Kernel
+{
+public:
+    const char *name() const { return "unpack depth (mm)"; }
+    void run(Frame &f) { unpackDepth(f.packed,f.unpacked,f.pixels); }
+    double bytes(const Frame &f) const { return 4.0*f.pixels; }
+};
+
+
+/************************************************************************/
+class UnpackDepthScaled : public Kernel
+{
+public:
+    const char *name() const { return "unpack depth (float)"; }
+    void run(Frame &f) { unpackDepthScaled(f.packed,f.scaled,f.pixels); }
+    double bytes(const Frame &f) const { return 6.0*f.pixels; }
+};
+
+
+/************************************************************************/
+class UnpackPlayers : public Kernel
+{
+public:
+    const char *name() const { return "unpack players"; }
+    void run(Frame &f) { unpackPlayers(f.packed,f.players.data(),f.pixels); }
+    double bytes(const Frame &f) const { return 10.0*f.pixels; }
+};
+
+
+/************************************************************************/
+class PlayersImage : public Kernel
+{
+protected:
+    BenchClient &client;
+    ImageOf<PixelBgr> image;
+
+public:
+    PlayersImage(BenchClient &client) : client(client) { }
+    const char *name() const { return "getPlayersImage"; }
+    void run(Frame &f) { client.getPlayersImage(f.players,image); }
+    double bytes(const Frame &f) const { return 11.0*f.pixels; }
+};
+
+
+/************************************************************************/
+class DepthImage : public Kernel
+{
+protected:
+    BenchClient &client;
+    ImageOf<PixelFloat> image;
+
+public:
+    DepthImage(BenchClient &client) : client(client) { }
+    const char *name() const { return "getDepthImage"; }
+    void run(Frame &f) { client.getDepthImage(f.depthIm,image); }
+    double bytes(const Frame &f) const { return 8.0*f.pixels; }
+};
+
+
+/************************************************************************/
+class SkeletonParsing : public Kernel
+{
+protected:
+    BenchClient &client;
+    Bottle skeleton;
+    int joints;
+
+public:
+    /************************************************************************/
+    SkeletonParsing(BenchClient &client) : client(client)
+    {
+        // six tracked players with the full set of joints of the SDK
+        const char *names[]={KINECT_TAGS_BODYPART_HEAD, KINECT_TAGS_BODYPART_SHOULDER_C,
+                             KINECT_TAGS_BODYPART_SHOULDER_L, KINECT_TAGS_BODYPART_SHOULDER_R,
+                             KINECT_TAGS_BODYPART_ELBOW_L, KINECT_TAGS_BODYPART_ELBOW_R,
+                             KINECT_TAGS_BODYPART_WRIST_L, KINECT_TAGS_BODYPART_WRIST_R,
+                             KINECT_TAGS_BODYPART_HAND_L, KINECT_TAGS_BODYPART_HAND_R,
+                             KINECT_TAGS_BODYPART_SPINE, KINECT_TAGS_BODYPART_HIP_C,
+                             KINECT_TAGS_BODYPART_HIP_L, KINECT_TAGS_BODYPART_HIP_R,
+                             KINECT_TAGS_BODYPART_KNEE_L, KINECT_TAGS_BODYPART_KNEE_R,
+                             KINECT_TAGS_BODYPART_ANKLE_L, KINECT_TAGS_BODYPART_ANKLE_R,
+                             KINECT_TAGS_BODYPART_FOOT_L, KINECT_TAGS_BODYPART_FOOT_R};
+        int n=sizeof(names)/sizeof(names[0]);
+        for (int i=0; i<6; i++)
+        {
+            Bottle &player=skeleton.addList();
+            player.addInt(i+1);
+            for (int j=0; j<n; j++)
+            {
+                Bottle &joint=player.addList();
+                joint.addString(names[j]);
+                Bottle &position=joint.addList();
+                position.addInt(100+j);
+                position.addInt(50+i);
+                position.addDouble(0.1*j);
+                position.addDouble(0.2*i);
+                position.addDouble(2.0+0.1*i);
+                position.addDouble(1.0);
+            }
+        }
+        joints=6*n;
+    }
+
+    const char *name() const { return "skeleton parsing"; }
+    void run(Frame &f) { client.parse(&skeleton); }
+    int items(const Frame &f) const { return joints; }
+    double bytes(const Frame &f) const { return (double)skeleton.toString().length(); }
+    deque<Player> getPlayers() { return client.parse(&skeleton); }
+};
+
+
+/************************************************************************/
+class Fusion : public Kernel
+{
+protected:
+    SkeletonFusion fusion;
+    vector<deque<Player> > players;
+    deque<Player> fused;
+    double timestamp;
+    int joints;
+
+public:
+    /************************************************************************/
+    Fusion(const deque<Player> &seen, const int nSensors) : players(nSensors)
+    {
+        // every sensor sees the same people a couple of cm apart
+        fusion.configure(nSensors);
+        joints=0;
+        for (int s=0; s<nSensors; s++)
+        {
+            players[s]=seen;
+            for (size_t i=0; i<players[s].size(); i++)
+            {
+                Skeleton &skeleton=players[s][i].skeleton;
+                for (Skeleton::iterator it=skeleton.begin(); it!=skeleton.end(); it++)
+                    it->second.x+=0.02*s;
+                joints+=(int)skeleton.size();
+            }
+        }
+        timestamp=0.0;
+    }
+
+    const char *name() const { return "skeleton fusion"; }
+    void run(Frame &f) { fusion.fuse(players,fused,timestamp+=0.03); }
+    int items(const Frame &f) const { return joints; }
+    double bytes(const Frame &f) const { return (double)joints*sizeof(Joint); }
+};
+
+
+/************************************************************************/
+void getIntrinsics(const Frame &f, const double focal, double *intrinsics)
+{
+    // focal lengths are given at 640x480 and scaled with the resolution
+    intrinsics[0]=intrinsics[1]=focal*f.width/640.0;
+    intrinsics[2]=0.5*f.width;
+    intrinsics[3]=0.5*f.height;
+}
+
+
+/************************************************************************/
+class Cloud : public Kernel
+{
+protected:
+    CloudProjector projector;
+    ImageOf<PixelRgbFloat> cloud;
+
+public:
+    Cloud(const Frame &f) { projector.setup(f.width,f.height,1.0862,0.7878); }
+    const char *name() const { return "cloud projection"; }
+    void run(Frame &f) { projector.project(f.packedIm,cloud); }
+    double bytes(const Frame &f) const { return 22.0*f.pixels; }
+};
+
+
+/************************************************************************/
+class Voxels : public Kernel
+{
+protected:
+    CloudProjector projector;
+    VoxelGrid grid;
+    ImageOf<PixelRgbFloat> centroids;
+
+public:
+    /************************************************************************/
+    Voxels(const Frame &f, const int nBands)
+    {
+        const double box[]={-2.0, 2.0, -2.0, 2.0, 0.5, 4.5};
+        projector.setup(f.width,f.height,1.0862,0.7878);
+        grid.configure(box,0.02,nBands);
+    }
+
+    const char *name() const { return "voxel grid (2 cm)"; }
+    void run(Frame &f) { grid.compute(f.packedIm,projector,centroids); }
+    double bytes(const Frame &f) const { return 38.0*f.pixels; }
+};
+
+
+/************************************************************************/
+class Registration : public Kernel
+{
+protected:
+    DepthRegistration registration;
+    ImageOf<PixelMono16> registered;
+
+public:
+    /************************************************************************/
+    Registration(const Frame &f)
+    {
+        // a Kinect-like rig: rgb camera 2.5 cm aside, slightly rotated
+        double depthIntrinsics[4],rgbIntrinsics[4];
+        getIntrinsics(f,575.8,depthIntrinsics);
+        getIntrinsics(f,525.0,rgbIntrinsics);
+        const double rotation[]={0.9999, 0.0, 0.0141, 0.0, 1.0, 0.0, -0.0141, 0.0, 0.9999};
+        const double translation[]={0.025, 0.0, 0.0};
+        registration.setup(f.width,f.height,depthIntrinsics,f.width,f.height,
+                           rgbIntrinsics,rotation,translation);
+    }
+
+    const char *name() const { return "depth registration"; }
+    void run(Frame &f) { registration.apply(f.packedIm,registered); }
+    double bytes(const Frame &f) const { return 20.0*f.pixels; }
+};
+
+
+/************************************************************************/
+class UndistortDepth : public Kernel
+{
+protected:
+    Undistortion undistortion;
+    ImageOf<PixelMono16> undistorted;
+
+public:
+    /************************************************************************/
+    UndistortDepth(const Frame &f)
+    {
+        double intrinsics[4];
+        getIntrinsics(f,575.8,intrinsics);
+        const double distortion[]={-0.2, 0.05, 0.001, -0.001, 0.0};
+        undistortion.setup(f.width,f.height,intrinsics,distortion,false);
+    }
+
+    const char *name() const { return "undistort depth"; }
+    void run(Frame &f) { undistortion.apply(f.packedIm,undistorted); }
+    double bytes(const Frame &f) const { return 8.0*f.pixels; }
+};
+
+
+/************************************************************************/
+class UndistortRgb : public Kernel
+{
+protected:
+    Undistortion undistortion;
+    ImageOf<PixelRgb> undistorted;
+
+public:
+    /************************************************************************/
+    UndistortRgb(const Frame &f)
+    {
+        double intrinsics[4];
+        getIntrinsics(f,525.0,intrinsics);
+        const double distortion[]={0.2, -0.5, 0.001, -0.001, 0.3};
+        undistortion.setup(f.width,f.height,intrinsics,distortion,true);
+    }
+
+    const char *name() const { return "undistort rgb"; }
+    void run(Frame &f) { undistortion.apply(f.rgbIm,undistorted); }
+    double bytes(const Frame &f) const { return 27.0*f.pixels; }
+};
+
+
+/************************************************************************/
+class Extrinsics : public Kernel
+{
+protected:
+    ExtrinsicTransform transform;
+    CloudProjector projector;
+    ImageOf<PixelRgbFloat> cloud;
+
+public:
+    /************************************************************************/
+    Extrinsics(Frame &f)
+    {
+        // a quarter of turn, so that repeated runs keep the points bounded
+        const double H[]={0.0, -1.0, 0.0, 0.1,
+                          1.0,  0.0, 0.0, 0.2,
+                          0.0,  0.0, 1.0, 0.3,
+                          0.0,  0.0, 0.0, 1.0};
+        transform.set(H);
+        projector.setup(f.width,f.height,1.0862,0.7878);
+        projector.project(f.packedIm,cloud);
+    }
+
+    const char *name() const { return "extrinsics (cloud)"; }
+    void run(Frame &f) { transform.apply(cloud); }
+    double bytes(const Frame &f) const { return 24.0*f.pixels; }
+};
+
+
+/************************************************************************/
+class RgbdPacking : public Kernel
+{
+protected:
+    RgbdFrame frame;
+    RgbdFrame received;
+
+public:
+    const char *name() const { return "rgbd pack+unpack"; }
+
+    /************************************************************************/
+    void run(Frame &f)
+    {
+        // as the server fills rgbd:o, then through the wire format
+        frame.depth=f.packedIm;
+        frame.rgb=f.rgbIm;
+        frame.timestampDepth=frame.timestampRgb=1.0;
+        Portable::copyPortable(frame,received);
+    }
+
+    double bytes(const Frame &f) const { return 30.0*f.pixels; }
+};
+
+} //end unnamed namespace
+
+
+/************************************************************************/
+void measure(Kernel &kernel, Frame &frame, const double time, const int rounds,
+             const char *resolution)
+{
+    // calibrate the number of iterations of a round
+    kernel.run(frame);
+    int iterations=1;
+    double t0=monotonicTime();
+    kernel.run(frame);
+    double dt=monotonicTime()-t0;
+    if (dt>0.0)
+        iterations=(int)(time/(rounds*dt))+1;
+
+    double best=1e9;
+    for (int r=0; r<rounds; r++)
+    {
+        t0=monotonicTime();
+        for (int i=0; i<iterations; i++)
+            kernel.run(frame);
+        dt=(monotonicTime()-t0)/iterations;
+        if (dt<best)
+            best=dt;
+    }
+
+    fprintf(stdout,"%-22s %-10s %10.3f %10.2f\n",kernel.name(),resolution,
+            1e9*best/kernel.items(frame),kernel.bytes(frame)/best*1e-9);
+}
+
+
+/************************************************************************/
+int main(int argc, char *argv[])
+{
+    Property options;
+    options.fromCommand(argc,argv);
+    double time=options.check("time",Value(0.5)).asDouble();
+    int rounds=options.check("rounds",Value(5)).asInt();
+    int nBands=options.check("bands",Value(1)).asInt();
+
+    const int resolutions[][2]={{320,240}, {640,480}, {1280,1024}};
+    const int nResolutions=sizeof(resolutions)/sizeof(resolutions[0]);
+
+    fprintf(stdout,"%-22s %-10s %10s %10s\n","kernel","resolution","ns/pixel","GB/s");
+    for (int r=0; r<nResolutions; r++)
+    {
+        int width=resolutions[r][0];
+        int height=resolutions[r][1];
+        char resolution[32];
+        sprintf(resolution,"%dx%d",width,height);
+
+        Frame frame(width,height);
+        BenchClient client;
+        client.setup(width,height);
+
+        Pack pack;
+        Decimate decimate;
+        UnpackDepth unpackD;
+        UnpackDepthScaled unpackF;
+        UnpackPlayers unpackP;
+        PlayersImage playersImage(client);
+        DepthImage depthImage(client);
+        Cloud cloud(frame);
+        Voxels voxels(frame,nBands);
+        Registration registration(frame);
+        UndistortDepth undistortD(frame);
+        UndistortRgb undistortI(frame);
+        Extrinsics extrinsics(frame);
+        RgbdPacking rgbd;
+        Kernel *kernels[]={&pack, &decimate, &unpackD, &unpackF, &unpackP,
+                           &playersImage, &depthImage, &cloud, &voxels,
+                           &registration, &undistortD, &undistortI,
+                           &extrinsics, &rgbd};
+        for (size_t k=0; k<sizeof(kernels)/sizeof(kernels[0]); k++)
+            measure(*kernels[k],frame,time,rounds,resolution);
+
+        client.release();
+    }
+
+    // skeletons do not depend on the resolution: ns/pixel stands for ns/joint
+    Frame frame(320,240);
+    BenchClient client;
+    SkeletonParsing skeleton(client);
+    measure(skeleton,frame,time,rounds,"6 players");
+    Fusion fusion(skeleton.getPlayers(),4);
+    measure(fusion,frame,time,rounds,"4x6 players");
+
+    return 0;
+}
+
@@ -0,0 +1,534 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+\defgroup kinectWrapper_throughput kinectWrapper_throughput
+
+End-to-end throughput benchmark of server and clients.
+
+\section intro_sec Description
+A KinectWrapperServer serving synthetic frames (see the synthetic
+option) and N KinectWrapperClient's run in the same process, on top of
+an in-process name server, so that no device and no yarpserver are
+needed. For every combination of carrier, resolution, streams and
+number of clients the benchmark lets the frames flow for a while and
+reports, per stream:
+- the rate at which the server publishes frames;
+- the rate delivered to the clients (mean and slowest client);
+- the frames skipped by the clients, in % of the published ones;
+- the latency from acquisition to the client, as percentiles.
+
+The CPU time is given for the whole process and for the threads
+reading the clients; the difference is spent by the server thread and
+by the YARP threads moving the data, hence it is the cost of serving,
+which is also reported on its own. All the percentages are of a single
+core.
+
+The outbound fan-out is given as the IP packets sent per published
+depth frame, from the OutRequests counter of /proc/net/snmp (Linux
+only, -1 elsewhere). The counter covers the whole host, so it is
+meaningful on an otherwise quiet machine. With tcp and udp both the packets and the
+serving cost grow with the number of clients; with mcast the server
+sends each frame once and both must stay flat: if they grow, the
+multicast group could not be joined and the clients fell back to udp.
+
+Clients poll their ports every millisecond, which bounds the
+resolution of the latencies.
+
+\section parameters_sec Parameters
+--carriers "(\e c0 \e c1 ...)"
+- carriers the clients connect through, by default (tcp udp mcast shmem);
+  \e ring stands for the shared memory rings of the server (shmem
+  option of server and client); with \e mcast the server is opened with
+  the multicast option and the clients use the carrier it suggests.
+
+--resolutions "((\e w0 \e h0) (\e w1 \e h1) ...)"
+- depth and rgb resolutions, by default ((320 240) (640 480)).
+
+--streams "(\e s0 \e s1 ...)"
+- the info of the server, by default (depth depth_rgb all_info).
+
+--clients "(\e n0 \e n1 ...)"
+- number of clients, by default (1 2 4 8).
+
+--period \e ms
+- period of the server, by default 30 ms.
+
+--duration \e t
+- seconds measured for each combination, by default 5, after one
+  second of warm-up.
+
+--players \e n
+- number of players in the synthetic scene, by default 2.
+
+--network
+- use the name server of the YARP network instead of the in-process one,
+  e.g. to watch the ports while the benchmark runs.
+
+--csv \e file
+- also write the results to \e file, one line per stream and combination.
+
+\section tested_os_sec Tested OS
+Linux
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+
+#include <yarp/os/Network.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/Bottle.h>
+#include <yarp/os/RateThread.h>
+#include <yarp/os/Semaphore.h>
+#include <yarp/os/Time.h>
+
+#include <kinectWrapper/kinectWrapper_server.h>
+#include <kinectWrapper/kinectWrapper_client.h>
+#include <kinectWrapper/kinectClock.h>
+#include <kinectWrapper/kinectLatency.h>
+
+using namespace std;
+using namespace yarp::os;
+using namespace yarp::sig;
+using namespace kinectWrapper;
+
+#define STREAM_DEPTH    0
+#define STREAM_RGB      1
+#define STREAM_JOINTS   2
+#define STREAM_COUNT    3
+
+
+namespace
+{
+
+const char *streamNames[STREAM_COUNT]={"depth","rgb","joints"};
+
+/************************************************************************/
+bool getOutPackets(double &packets)
+{
+    FILE *f=fopen("/proc/net/snmp","r");
+    if (f==NULL)
+        return false;
+
+    //the Ip: header line names the fields of the Ip: line that follows
+    char header[1024],values[1024];
+    bool ok=false;
+    while (!ok && (fgets(header,sizeof(header),f)!=NULL))
+    {
+        if ((strncmp(header,"Ip:",3)!=0) || (fgets(values,sizeof(values),f)==NULL))
+            continue;
+
+        char *hSave,*vSave;
+        char *h=strtok_r(header," \n",&hSave);
+        char *v=strtok_r(values," \n",&vSave);
+        while ((h!=NULL) && (v!=NULL))
+        {
+            if (strcmp(h,"OutRequests")==0)
+            {
+                packets=atof(v);
+                ok=true;
+                break;
+            }
+            h=strtok_r(NULL," \n",&hSave);
+            v=strtok_r(NULL," \n",&vSave);
+        }
+        break;
+    }
+
+    fclose(f);
+    return ok;
+}
+
+/************************************************************************/
+unsigned int getCounter(Property &stats, const char *stream, const char *key)
+{
+    Bottle &group=stats.findGroup(stream);
+    return group.isNull()?0:(unsigned int)group.find(key).asInt();
+}
+
+} //end unnamed namespace
+
+
+/************************************************************************/
+class Collector
+{
+protected:
+    Semaphore mutex;
+    LatencyHistogram latency[STREAM_COUNT];
+    vector<unsigned int> frames[STREAM_COUNT];
+    double cpu;
+    bool measuring;
+
+public:
+    /************************************************************************/
+    Collector(const int clients) : mutex(1), cpu(0.0), measuring(false)
+    {
+        for (int s=0; s<STREAM_COUNT; s++)
+            frames[s].assign(clients,0);
+    }
+
+    /************************************************************************/
+    void start()
+    {
+        mutex.wait();
+        measuring=true;
+        mutex.post();
+    }
+
+    /************************************************************************/
+    void stop()
+    {
+        mutex.wait();
+        measuring=false;
+        mutex.post();
+    }
+
+    /************************************************************************/
+    void add(const int client, const int stream, const double timestamp)
+    {
+        double now=monotonicTime();
+        mutex.wait();
+        if (measuring)
+        {
+            latency[stream].add(now-timestamp);
+            frames[stream][client]++;
+        }
+        mutex.post();
+    }
+
+    /************************************************************************/
+    void addCpuTime(const double seconds)
+    {
+        mutex.wait();
+        if (measuring)
+            cpu+=seconds;
+        mutex.post();
+    }
+
+    /************************************************************************/
+    double getCpuTime() const
+    {
+        return cpu;
+    }
+
+    /************************************************************************/
+    const LatencyHistogram &getLatency(const int stream) const
+    {
+        return latency[stream];
+    }
+
+    /************************************************************************/
+    const vector<unsigned int> &getFrames(const int stream) const
+    {
+        return frames[stream];
+    }
+};
+
+
+/************************************************************************/
+class Reader : public RateThread
+{
+protected:
+    KinectWrapperClient &client;
+    Collector &collector;
+    int id;
+    bool rgb;
+    bool joints;
+
+    ImageOf<PixelMono16> depth;
+    ImageOf<PixelRgb> image;
+    deque<Player> players;
+
+public:
+    /************************************************************************/
+    Reader(KinectWrapperClient &client, Collector &collector, const int id,
+           const string &info) : RateThread(1), client(client), collector(collector), id(id)
+    {
+        rgb=(info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_RGB || info==KINECT_TAGS_DEPTH_RGB_PLAYERS);
+        joints=(info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_JOINTS);
+    }
+
+    /************************************************************************/
+    void run()
+    {
+        double cpu=threadCpuTime();
+        double timestamp;
+        if (client.getDepth(depth,&timestamp))
+            collector.add(id,STREAM_DEPTH,timestamp);
+        if (rgb && client.getRgb(image,&timestamp))
+            collector.add(id,STREAM_RGB,timestamp);
+        if (joints && client.getJoints(players,&timestamp))
+            collector.add(id,STREAM_JOINTS,timestamp);
+        collector.addCpuTime(threadCpuTime()-cpu);
+    }
+};
+
+
+/************************************************************************/
+class Benchmark
+{
+protected:
+    double period;
+    double duration;
+    int players;
+    FILE *csv;
+
+public:
+    /************************************************************************/
+    Benchmark(const double period, const double duration, const int players, FILE *csv) :
+              period(period), duration(duration), players(players), csv(csv) { }
+
+    /************************************************************************/
+    bool run(const string &carrier, const int width, const int height, const string &info,
+             const int nClients)
+    {
+        bool ring=(carrier=="ring");
+        bool mcast=(carrier=="mcast");
+
+        Property serverOptions;
+        serverOptions.put("name","throughputServer");
+        serverOptions.put("period",(int)period);
+        serverOptions.put("info",info.c_str());
+        serverOptions.put("img_width",width);
+        serverOptions.put("img_height",height);
+        serverOptions.put("depth_width",width);
+        serverOptions.put("depth_height",height);
+        serverOptions.put("synthetic","true");
+        serverOptions.put("synthetic_players",players);
+        if (ring)
+            serverOptions.put("shmem","true");
+        if (mcast)
+            serverOptions.put("multicast","true");
+
+        KinectWrapperServer server;
+        if (!server.open(serverOptions))
+        {
+            fprintf(stderr,"unable to open the server\n");
+            return false;
+        }
+
+        Collector collector(nClients);
+        vector<KinectWrapperClient*> clients;
+        vector<Reader*> readers;
+        bool ok=true;
+        for (int i=0; ok && (i<nClients); i++)
+        {
+            char local[64];
+            sprintf(local,"throughputClient%d",i);
+
+            Property clientOptions;
+            clientOptions.put("remote","throughputServer");
+            clientOptions.put("local",local);
+            if (!mcast)
+                clientOptions.put("carrier",ring?"tcp":carrier.c_str());
+            if (ring)
+                clientOptions.put("shmem","true");
+
+            clients.push_back(new KinectWrapperClient);
+            if (!clients.back()->open(clientOptions))
+            {
+                fprintf(stderr,"unable to open client %d through %s\n",i,carrier.c_str());
+                ok=false;
+            }
+            else
+                readers.push_back(new Reader(*clients.back(),collector,i,info));
+        }
+
+        if (ok)
+        {
+            for (size_t i=0; i<readers.size(); i++)
+                readers[i]->start();
+
+            Time::delay(1.0);
+
+            Property serverStats0,serverStats1;
+            vector<Property> clientStats0(nClients),clientStats1(nClients);
+            server.getFrameStats(serverStats0);
+            for (int i=0; i<nClients; i++)
+                clients[i]->getFrameStats(clientStats0[i]);
+            double packets0,packets1;
+            bool packets=getOutPackets(packets0);
+            double cpu0=processCpuTime();
+            double t0=monotonicTime();
+            collector.start();
+
+            Time::delay(duration);
+
+            collector.stop();
+            double t=monotonicTime()-t0;
+            double cpu=processCpuTime()-cpu0;
+            packets&=getOutPackets(packets1);
+            for (size_t i=0; i<readers.size(); i++)
+                readers[i]->stop();
+            double readersCpu=collector.getCpuTime();
+            server.getFrameStats(serverStats1);
+            for (int i=0; i<nClients; i++)
+                clients[i]->getFrameStats(clientStats1[i]);
+
+            char resolution[32];
+            sprintf(resolution,"%dx%d",width,height);
+
+            //the cost of serving against the number of clients
+            double serving=100.0*(cpu-readersCpu)/t;
+            unsigned int depthFrames=getCounter(serverStats1,"depth","published")-
+                                     getCounter(serverStats0,"depth","published");
+            double packetsPerFrame=(packets && (depthFrames>0))?(packets1-packets0)/depthFrames:-1.0;
+
+            for (int s=0; s<STREAM_COUNT; s++)
+            {
+                const vector<unsigned int> &frames=collector.getFrames(s);
+                unsigned int total=0,slowest=frames.empty()?0:frames[0];
+                for (size_t i=0; i<frames.size(); i++)
+                {
+                    total+=frames[i];
+                    if (frames[i]<slowest)
+                        slowest=frames[i];
+                }
+                if (total==0)
+                    continue;
+
+                unsigned int published=getCounter(serverStats1,streamNames[s],"published")-
+                                       getCounter(serverStats0,streamNames[s],"published");
+                unsigned int skipped=0;
+                for (int i=0; i<nClients; i++)
+                    skipped+=getCounter(clientStats1[i],streamNames[s],"skipped")-
+                             getCounter(clientStats0[i],streamNames[s],"skipped");
+
+                const LatencyHistogram &latency=collector.getLatency(s);
+                double serverFps=published/t;
+                double meanFps=total/(t*nClients);
+                double slowestFps=slowest/t;
+                double skippedRate=(published>0)?100.0*skipped/((double)published*nClients):0.0;
+                double p50=1e3*latency.getPercentile(50.0);
+                double p90=1e3*latency.getPercentile(90.0);
+                double p99=1e3*latency.getPercentile(99.0);
+
+                fprintf(stdout,"%-7s %-10s %-18s %3d %-6s %8.1f %8.1f %8.1f %7.2f %7.2f %7.2f %7.2f %7.1f %7.1f %7.1f %8.1f\n",
+                        carrier.c_str(),resolution,info.c_str(),nClients,streamNames[s],
+                        serverFps,meanFps,slowestFps,skippedRate,p50,p90,p99,
+                        100.0*cpu/t,100.0*readersCpu/t,serving,packetsPerFrame);
+                if (csv!=NULL)
+                    fprintf(csv,"%s,%d,%d,%s,%d,%s,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g\n",
+                            carrier.c_str(),width,height,info.c_str(),nClients,streamNames[s],
+                            serverFps,meanFps,slowestFps,skippedRate,p50,p90,p99,
+                            100.0*cpu/t,100.0*readersCpu/t,serving,packetsPerFrame);
+            }
+            fflush(stdout);
+        }
+        else
+        {
+            for (size_t i=0; i<readers.size(); i++)
+                readers[i]->stop();
+        }
+
+        for (size_t i=0; i<readers.size(); i++)
+            delete readers[i];
+        for (size_t i=0; i<clients.size(); i++)
+        {
+            clients[i]->close();
+            delete clients[i];
+        }
+        server.close();
+
+        return ok;
+    }
+};
+
+
+/************************************************************************/
+Bottle getList(Property &options, const char *key, const char *defaults)
+{
+    if (Bottle *b=options.find(key).asList())
+        return *b;
+    return Bottle(defaults);
+}
+
+
+/************************************************************************/
+int main(int argc, char *argv[])
+{
+    Property options;
+    options.fromCommand(argc,argv);
+
+    if (!options.check("network"))
+        Network::setLocalMode(true);
+    Network yarp;
+    if (options.check("network") && !yarp.checkNetwork())
+    {
+        fprintf(stderr,"YARP network is not available\n");
+        return 1;
+    }
+
+    Bottle carriers=getList(options,"carriers","tcp udp mcast shmem");
+    Bottle resolutions=getList(options,"resolutions","(320 240) (640 480)");
+    Bottle streams=getList(options,"streams","depth depth_rgb all_info");
+    Bottle clients=getList(options,"clients","1 2 4 8");
+    double period=options.check("period",Value(30)).asDouble();
+    double duration=options.check("duration",Value(5.0)).asDouble();
+    int players=options.check("players",Value(2)).asInt();
+
+    FILE *csv=NULL;
+    if (options.check("csv"))
+    {
+        string fileName=options.find("csv").asString().c_str();
+        if ((csv=fopen(fileName.c_str(),"w"))==NULL)
+        {
+            fprintf(stderr,"unable to open %s\n",fileName.c_str());
+            return 1;
+        }
+        fprintf(csv,"carrier,width,height,streams,clients,stream,server_fps,client_fps,"
+                    "slowest_fps,skipped_percent,p50_ms,p90_ms,p99_ms,cpu_process_percent,"
+                    "cpu_readers_percent,cpu_serving_percent,packets_per_frame\n");
+    }
+
+    fprintf(stdout,"%-7s %-10s %-18s %3s %-6s %8s %8s %8s %7s %7s %7s %7s %7s %7s %7s %8s\n",
+            "carrier","resolution","streams","n","stream","srv fps","cli fps","slowest",
+            "skip%","p50 ms","p90 ms","p99 ms","cpu%","read%","serve%","pkt/frm");
+
+    Benchmark benchmark(period,duration,players,csv);
+    int failures=0;
+    for (int c=0; c<carriers.size(); c++)
+    {
+        for (int r=0; r<resolutions.size(); r++)
+        {
+            Bottle *res=resolutions.get(r).asList();
+            if ((res==NULL) || (res->size()<2))
+                continue;
+
+            for (int s=0; s<streams.size(); s++)
+            {
+                for (int n=0; n<clients.size(); n++)
+                {
+                    if (!benchmark.run(carriers.get(c).asString().c_str(),
+                                       res->get(0).asInt(),res->get(1).asInt(),
+                                       streams.get(s).asString().c_str(),
+                                       clients.get(n).asInt()))
+                        failures++;
+                }
+            }
+        }
+    }
+
+    if (csv!=NULL)
+        fclose(csv);
+
+    return (failures==0)?0:1;
+}
+
@@ -0,0 +1,109 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __KINECT_BANDS_H__
+#define __KINECT_BANDS_H__
+
+#include <vector>
+
+#include <yarp/os/Thread.h>
+#include <yarp/os/Semaphore.h>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* A piece of per-frame work that can be split in bands of rows.
+*/
+class BandJob
+{
+public:
+    /**
+    * Process the rows in [rowBegin,rowEnd).
+    * @param band the index of the band, in [0,nBands); each band is
+    *             processed by a single thread, hence per-band data
+    *             need no locking.
+    * @param rowBegin the first row.
+    * @param rowEnd one past the last row.
+    */
+    virtual void process(int band, int rowBegin, int rowEnd) = 0;
+
+    virtual ~BandJob() { }
+};
+
+/**
+* @ingroup kinectWrapper
+*
+* Split a frame in horizontal bands and process them in parallel. The
+* worker threads are created once and wait on a semaphore between
+* frames, the calling thread takes care of the first band.
+*/
+class BandPool
+{
+protected:
+    class Worker : public yarp::os::Thread
+    {
+    public:
+        yarp::os::Semaphore go;
+        yarp::os::Semaphore done;
+        BandJob *job;
+        int band;
+        int rowBegin;
+        int rowEnd;
+
+        Worker();
+        void run();
+        void onStop();
+    };
+
+    std::vector<Worker*> workers;
+
+public:
+    BandPool();
+
+    /**
+    * Start the worker threads.
+    * @param nBands the number of bands a frame is split in, including
+    *               the one processed by the calling thread.
+    */
+    void open(int nBands);
+
+    /**
+    * Stop the worker threads. Called by destructor.
+    */
+    void close();
+
+    /**
+    * Return the number of bands a frame is split in.
+    */
+    int getBands() const;
+
+    /**
+    * Process all the rows of a frame and wait for completion.
+    * @param job the work to be carried out on each band.
+    * @param height the number of rows of the frame.
+    */
+    void process(BandJob &job, int height);
+
+    ~BandPool();
+};
+
+}
+
+#endif
+
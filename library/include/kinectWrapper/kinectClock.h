@@ -0,0 +1,144 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __KINECT_CLOCK_H__
+#define __KINECT_CLOCK_H__
+
+#include <string>
+#include <vector>
+#include <deque>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* Retrieve the host monotonic time, i.e. a clock that is not affected
+* by the adjustments of the system time.
+* @return the time in seconds from an arbitrary origin.
+*/
+double monotonicTime();
+
+/**
+* @ingroup kinectWrapper
+*
+* Retrieve the CPU time spent by the calling thread.
+* @return the time in seconds.
+*/
+double threadCpuTime();
+
+/**
+* @ingroup kinectWrapper
+*
+* Retrieve the CPU time spent by the whole process.
+* @return the time in seconds.
+*/
+double processCpuTime();
+
+/**
+* @ingroup kinectWrapper
+*
+* Retrieve the identifier of the calling thread, as reported by
+* threadsCpuTime().
+* @return the identifier, or 0 if not available.
+*/
+int currentThreadId();
+
+/**
+* @ingroup kinectWrapper
+*
+* The CPU time spent by a thread of the process.
+*/
+struct ThreadCpuTime
+{
+    int id;
+    std::string name;
+    double time;
+};
+
+/**
+* @ingroup kinectWrapper
+*
+* Retrieve the CPU time spent by each thread of the process, including
+* the ones started by YARP (e.g. the port and rpc threads).
+* @param threads the list of the running threads.
+* @return true/false if successful/not supported on this platform.
+*/
+bool threadsCpuTime(std::vector<ThreadCpuTime> &threads);
+
+/**
+* @ingroup kinectWrapper
+*
+* Maps the clock of a device onto the host monotonic clock. Every frame
+* gives a pair (device time, host time of arrival): the drift is the
+* slope of a least-squares fit with exponential forgetting, while the
+* offset follows the lower envelope of the pairs over the last window,
+* since the transport can only delay the arrival. A device clock going
+* backwards or jumping away from the host clock restarts the estimate.
+*/
+class ClockMapper
+{
+protected:
+    struct Sample
+    {
+        double device;
+        double host;
+    };
+
+    bool valid;
+    double refDevice;
+    double refHost;
+    double sw,sx,sy,sxx,sxy;
+    double slope;
+    double offset;
+    std::deque<Sample> window;
+
+public:
+    ClockMapper();
+
+    /**
+    * Forget the estimate.
+    */
+    void reset();
+
+    /**
+    * Account for a new frame and map its device time.
+    * @param deviceTime the device time of the frame in seconds.
+    * @param hostTime the host monotonic time of arrival in seconds.
+    * @return the device time expressed in host monotonic seconds.
+    */
+    double map(const double deviceTime, const double hostTime);
+
+    /**
+    * Retrieve the current offset, such that host time is given by
+    * offset+(1+drift)*device time.
+    * @return the offset in seconds.
+    */
+    double getOffset() const;
+
+    /**
+    * Retrieve the current relative drift of the device clock (e.g.
+    * 1e-5 means 10 us of advance of the host clock every second).
+    * @return the drift.
+    */
+    double getDrift() const;
+};
+
+}
+
+#endif
+
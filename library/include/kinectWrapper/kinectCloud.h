@@ -0,0 +1,123 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __KINECT_CLOUD_H__
+#define __KINECT_CLOUD_H__
+
+#include <vector>
+
+#include <yarp/sig/Image.h>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* Turns depth images into organized point clouds. Each pixel is
+* given a ray (x/z, y/z) computed once per resolution, so that the
+* projection of a frame boils down to a multiplication by the
+* depth. The rays follow the ConvertProjectiveToRealWorld convention
+* of OpenNI, i.e. x=(u/width-0.5)*z*xzFactor and
+* y=(0.5-v/height)*z*yzFactor.
+*/
+class CloudProjector
+{
+protected:
+    int width;
+    int height;
+    std::vector<float> raysX;
+    std::vector<float> raysY;
+    std::vector<float> z;
+
+    void projectRow(const unsigned short *depth, float *cloud, int row);
+
+public:
+    CloudProjector();
+
+    /**
+    * Build the ray lookup table.
+    * @param width the width of the depth image.
+    * @param height the height of the depth image.
+    * @param xzFactor the horizontal real-world size at 1 m of distance.
+    * @param yzFactor the vertical real-world size at 1 m of distance.
+    */
+    void setup(int width, int height, double xzFactor, double yzFactor);
+
+    /**
+    * Build the ray lookup table of a pinhole camera, keeping the same
+    * axes convention (y pointing upwards).
+    * @param width the width of the depth image.
+    * @param height the height of the depth image.
+    * @param intrinsics (fx fy cx cy) of the camera in pixels.
+    */
+    void setupPinhole(int width, int height, const double *intrinsics);
+
+    /**
+    * Tell if the lookup table has been built.
+    * @return true/false if ready/not ready.
+    */
+    bool isReady() const;
+
+    /**
+    * Retrieve the width of the depth images the table is built for.
+    * @return the width.
+    */
+    int getWidth() const;
+
+    /**
+    * Retrieve the height of the depth images the table is built for.
+    * @return the height.
+    */
+    int getHeight() const;
+
+    /**
+    * Project a band of rows of a packed depth buffer (depth in mm in
+    * the 13 most significant bits, player in the 3 least significant).
+    * @param depth the packed depth buffer of the whole image.
+    * @param cloud the xyz buffer of the whole image, in meters;
+    *              invalid pixels are set to NaN.
+    * @param rowBegin the first row to project.
+    * @param rowEnd one past the last row to project.
+    */
+    void project(const unsigned short *depth, float *cloud, int rowBegin, int rowEnd);
+
+    /**
+    * Project a whole packed depth image.
+    * @param depth the packed depth image.
+    * @param cloud the resulting organized cloud in meters.
+    * @return true/false if successful/failed.
+    */
+    bool project(const yarp::sig::ImageOf<yarp::sig::PixelMono16> &depth,
+                 yarp::sig::ImageOf<yarp::sig::PixelRgbFloat> &cloud);
+
+    /**
+    * Project a single pixel of a packed depth image.
+    * @param depth the packed depth image.
+    * @param u the column of the pixel.
+    * @param v the row of the pixel.
+    * @param xyz the resulting point in meters, all zeros if the depth
+    *            is not valid.
+    * @return true/false if successful/failed (pixel out of the image).
+    */
+    bool projectPixel(const yarp::sig::ImageOf<yarp::sig::PixelMono16> &depth,
+                      const int u, const int v, double *xyz) const;
+};
+
+}
+
+#endif
+
@@ -28,6 +28,9 @@
 #ifndef __KINECT_DRIVER_H__
 #define __KINECT_DRIVER_H__
 
+#include <vector>
+#include <utility>
+
 #include <opencv2/opencv.hpp>
 
 #include <yarp/os/Property.h>
@@ -35,6 +38,8 @@
 #include <yarp/sig/Image.h>
 
 #include <kinectWrapper/kinectTags.h>
+#include <kinectWrapper/kinectLog.h>
+#include <kinectWrapper/kinectKernels.h>
 
 namespace kinectWrapper
 {
@@ -46,6 +51,11 @@ namespace kinectWrapper
 class KinectDriver
 {
 public:
+    /**
+    * Destructor.
+    */
+    virtual ~KinectDriver() { }
+
     /**
     * Configure the driver.
     * @param opt contains the set of options in form of a
@@ -76,6 +86,13 @@ public:
     * \b depth_height <int>: example (depth_height 240), specifies the
     *    height of the depth image to send. only for OpenNI driver.
     *
+    * \b device_index <int>: example (device_index 1), specifies which
+    *    of the connected devices is opened (0 by default).
+    *
+    * \b device_serial <string>: example (device_serial A00361A01234),
+    *    specifies the device to open by its serial, overriding
+    *    device_index.
+    *
     * @return true/false if successful/failed.
     */
     virtual bool initialize(yarp::os::Property &opt) = 0;
@@ -83,7 +100,7 @@ public:
     /**
     * Read the depth image from the Kinect device.
     * @param depth the read depth image.
-    * @param timestamp when the depth image has been read.
+    * @param timestamp the device time of the depth image in seconds.
     * @return true/false if successful/failed.
     */
     virtual bool readDepth(yarp::sig::ImageOf<yarp::sig::PixelMono16>& depth, double &timestamp) = 0;
@@ -91,7 +108,7 @@ public:
     /**
     * Read the rgb image from the Kinect device.
     * @param rgb the read rgb image.
-    * @param timestamp when the rgb image has been read.
+    * @param timestamp the device time of the rgb image in seconds.
     * @return true/false if successful/failed.
     */
     virtual bool readRgb(yarp::sig::ImageOf<yarp::sig::PixelRgb>& rgb, double &timestamp) = 0;
@@ -99,7 +116,7 @@ public:
     /**
     * Read the skeleton information from the Kinect device.
     * @param skeleton a Bottle where the position of the joints is saved.
-    * @param timestamp when the skeleton has been read.
+    * @param timestamp the device time of the skeleton in seconds.
     * @return true/false if successful/failed.
     */
     virtual bool readSkeleton(yarp::os::Bottle *skeleton, double &timestamp) = 0;
@@ -119,6 +136,30 @@ public:
     */
     virtual bool get3DPoint(int u, int v, yarp::sig::Vector &point3D) = 0;
 
+    /**
+    * Project a set of pixels in 3D using the same depth frame.
+    * @param pixels, the (u,v) coordinates of the pixels.
+    * @param points3D, the resultant 3D points, one per pixel.
+    * @return true/false if successful/failed.
+    */
+    virtual bool get3DPoints(const std::vector<std::pair<int,int> > &pixels, std::vector<yarp::sig::Vector> &points3D) = 0;
+
+    /**
+    * Tell if the driver provides depth images already aligned with
+    * the rgb images.
+    * @return true/false if aligned/not aligned.
+    */
+    virtual bool isDepthRegistered() = 0;
+
+    /**
+    * Get the factors that map normalized image coordinates to the real
+    * world, following x=(u/width-0.5)*z*xzFactor and y=(0.5-v/height)*z*yzFactor.
+    * @param xzFactor, the horizontal factor.
+    * @param yzFactor, the vertical factor.
+    * @return true/false if successful/failed.
+    */
+    virtual bool getProjectionFactors(double &xzFactor, double &yzFactor) = 0;
+
     /**
     * Get focal length of attached camera
     * @param focallength, the focal length of the camera.
@@ -126,6 +167,18 @@ public:
     */
     virtual bool getFocalLength(double &focallength) = 0;
 
+    /**
+    * Change the resolution of the output images while the sensor is
+    * running. Callers must not be reading images at the same time.
+    * @param img_width the new width of the rgb images.
+    * @param img_height the new height of the rgb images.
+    * @param depth_width the new width of the depth images.
+    * @param depth_height the new height of the depth images.
+    * @return true/false if the resolution is supported/not supported;
+    *         on failure the previous resolution is kept.
+    */
+    virtual bool setResolution(int img_width, int img_height, int depth_width, int depth_height) = 0;
+
     /**
     * Update all the required information.
     */
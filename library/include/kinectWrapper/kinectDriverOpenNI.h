@@ -37,6 +37,8 @@ private:
     bool seatedMode;
     bool requireCalibrationPose;
     bool requireRemapping;
+    bool depthRegistered;
+    bool kinectSensor;
     std::string info;
     int img_height;
     int img_width;
@@ -53,12 +55,13 @@ private:
     CvMat* depthMat;
 
     xn::Context context;
+    xn::Device device;
     xn::DepthGenerator depthGenerator;
     xn::ImageGenerator imageGenerator;
     xn::UserGenerator userGenerator;
 
     bool testRetVal(XnStatus nRetVal, std::string message);
-    void resizeImage(IplImage* depthTmp, IplImage* depthImage);
+    bool selectDevice(yarp::os::Property &opt, xn::Query &query);
     std::string jointNameAssociation(XnSkeletonJoint joint);
 
 public:
@@ -67,7 +70,11 @@ public:
     bool readRgb(yarp::sig::ImageOf<yarp::sig::PixelRgb> &rgb, double &timestamp);
     bool readSkeleton(yarp::os::Bottle *skeleton, double &timestamp);
     bool get3DPoint(int u, int v, yarp::sig::Vector &point3D);
+    bool get3DPoints(const std::vector<std::pair<int,int> > &pixels, std::vector<yarp::sig::Vector> &points3D);
+    bool getProjectionFactors(double &xzFactor, double &yzFactor);
+    bool isDepthRegistered();
     bool getFocalLength(double &focallength);
+    bool setResolution(int img_width, int img_height, int depth_width, int depth_height);
     bool close();
     void update();
     bool getRequireCalibrationPose();
@@ -35,6 +35,7 @@ class KinectDriverSDK: public KinectDriver
 
     USHORT* buf;
     HANDLE h1,h2,h3,h4;
+    INuiSensor* sensor;
 
     bool seatedMode;
     bool initC;
@@ -48,19 +49,23 @@ class KinectDriverSDK: public KinectDriver
 private:
     int setColorImg(HANDLE h,IplImage* color,const NUI_IMAGE_FRAME * pImageFrame);
     int setDepthImg(HANDLE h,IplImage* depth, const NUI_IMAGE_FRAME * pImageFrame );
-    const NUI_IMAGE_FRAME * retrieveImg(HANDLE h);
+    bool retrieveImg(HANDLE h, NUI_IMAGE_FRAME &imageFrame);
     std::string jointNameAssociation(int id);
     bool isJointProvided(int id);
 
 public:
 
-    KinectDriverSDK() { }
+    KinectDriverSDK() : sensor(NULL) { }
     bool initialize(yarp::os::Property &opt);
     bool readRgb(yarp::sig::ImageOf<yarp::sig::PixelRgb> &rgb, double &timestamp);
     bool readDepth(yarp::sig::ImageOf<yarp::sig::PixelMono16> &depth, double &timestamp);
     bool readSkeleton(yarp::os::Bottle *skeleton, double &timestamp);
     bool get3DPoint(int u, int v, yarp::sig::Vector &point3D);
+    bool get3DPoints(const std::vector<std::pair<int,int> > &pixels, std::vector<yarp::sig::Vector> &points3D);
+    bool getProjectionFactors(double &xzFactor, double &yzFactor);
+    bool isDepthRegistered();
     bool getFocalLength(double &focallength);
+    bool setResolution(int img_width, int img_height, int depth_width, int depth_height);
     bool close();
     void update();
 };
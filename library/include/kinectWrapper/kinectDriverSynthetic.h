@@ -0,0 +1,77 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __KINECT_DRIVER_SYNTHETIC_H__
+#define __KINECT_DRIVER_SYNTHETIC_H__
+
+#include <vector>
+
+#include <kinectWrapper/kinectTags.h>
+#include <kinectWrapper/kinectDriver.h>
+
+namespace kinectWrapper
+{
+/**
+* @ingroup kinectDriver
+*
+* A driver that generates frames instead of reading them from a
+* device: a tilted floor with players walking across it and swaying
+* skeletons. It accepts any resolution and never blocks, so that the
+* rate is given by the period of the server only. Device timestamps
+* are taken from the host monotonic clock.
+*
+* Besides the options of KinectDriver it accepts:
+*
+* \b synthetic_players <int>: example (synthetic_players 2), the
+*    number of players in the scene, at most KINECT_TAGS_MAX_USERS.
+*/
+class KinectDriverSynthetic: public KinectDriver
+{
+private:
+    std::string info;
+    int img_width;
+    int img_height;
+    int depth_width;
+    int depth_height;
+    int players;
+    unsigned int frame;
+    double frameTime;
+
+    std::vector<unsigned short> floorDepth;
+
+    void buildFloor();
+    int playerColumn(const int player) const;
+    unsigned short depthAt(const int u, const int v) const;
+
+public:
+    KinectDriverSynthetic();
+    bool initialize(yarp::os::Property &opt);
+    bool readDepth(yarp::sig::ImageOf<yarp::sig::PixelMono16> &depth, double &timestamp);
+    bool readRgb(yarp::sig::ImageOf<yarp::sig::PixelRgb> &rgb, double &timestamp);
+    bool readSkeleton(yarp::os::Bottle *skeleton, double &timestamp);
+    bool get3DPoint(int u, int v, yarp::sig::Vector &point3D);
+    bool get3DPoints(const std::vector<std::pair<int,int> > &pixels, std::vector<yarp::sig::Vector> &points3D);
+    bool getProjectionFactors(double &xzFactor, double &yzFactor);
+    bool isDepthRegistered();
+    bool getFocalLength(double &focallength);
+    bool setResolution(int img_width, int img_height, int depth_width, int depth_height);
+    bool close();
+    void update();
+};
+}
+
+#endif
+
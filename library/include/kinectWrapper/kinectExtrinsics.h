@@ -0,0 +1,96 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+
+#ifndef __KINECT_EXTRINSICS_H__
+#define __KINECT_EXTRINSICS_H__
+
+#include <yarp/os/Bottle.h>
+#include <yarp/sig/Image.h>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* Rigid transformation from the camera frame to a user frame (e.g.
+* the robot root), applied in batches to the 3D outputs. Points are
+* processed as packed xyz triplets, so that whole clouds and skeletons
+* go through the same tight loop; the identity costs nothing.
+*/
+class ExtrinsicTransform
+{
+protected:
+    double H[16];
+    float R[12];
+    bool identity;
+
+public:
+    ExtrinsicTransform();
+
+    /**
+    * Set the transformation.
+    * @param H the 4x4 row-major homogeneous matrix.
+    * @return true/false if successful/failed (the last row must be
+    *         0 0 0 1).
+    */
+    bool set(const double *H);
+
+    /**
+    * Retrieve the transformation.
+    * @param H the 4x4 row-major homogeneous matrix.
+    */
+    void get(double *H) const;
+
+    /**
+    * Tell if the transformation is the identity.
+    * @return true/false if identity/not identity.
+    */
+    bool isIdentity() const;
+
+    /**
+    * Transform a batch of points in place.
+    * @param xyz the packed xyz triplets.
+    * @param n the number of points.
+    */
+    void apply(float *xyz, const int n) const;
+
+    /**
+    * Transform a batch of points in place.
+    * @param xyz the packed xyz triplets.
+    * @param n the number of points.
+    */
+    void apply(double *xyz, const int n) const;
+
+    /**
+    * Transform an organized cloud in place; NaN points stay NaN.
+    * @param cloud the cloud.
+    */
+    void apply(yarp::sig::ImageOf<yarp::sig::PixelRgbFloat> &cloud) const;
+
+    /**
+    * Transform the 3D positions of a skeleton bottle as streamed by
+    * the drivers, i.e. ((id (name (u v x y z)) ...) ...).
+    * @param skeleton the skeleton bottle, modified in place.
+    */
+    void apply(yarp::os::Bottle &skeleton) const;
+};
+
+}
+
+#endif
+
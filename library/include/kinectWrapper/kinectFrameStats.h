@@ -0,0 +1,93 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __KINECT_FRAME_STATS_H__
+#define __KINECT_FRAME_STATS_H__
+
+#include <yarp/os/Bottle.h>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* Frame accounting of a single stream. Frames are numbered at
+* acquisition and the number travels in the count of the envelope, so
+* that the server can tell acquired frames from published ones, and the
+* frames that never became ready (unpublished) from the ones nobody was
+* reading on the shared port (unread), and the
+* client can tell the frames it missed (skipped) from the ones it got
+* twice (duplicated). Frames the server deliberately did not send to the
+* client (withheld, e.g. because of decimation) leave gaps in the
+* numbers too, hence they are not reported as skipped.
+*/
+struct FrameStats
+{
+    int lastId;
+    unsigned int acquired;
+    unsigned int published;
+    unsigned int unpublished;
+    unsigned int unread;
+    double bytes;
+    unsigned int received;
+    unsigned int skipped;
+    unsigned int duplicated;
+    unsigned int withheld;
+
+    FrameStats();
+
+    /**
+    * Reset all the counters.
+    */
+    void clear();
+
+    /**
+    * Account for a frame acquired on the server side.
+    * @return the id assigned to the frame.
+    */
+    int acquire();
+
+    /**
+    * Account for a frame received on the client side.
+    * @param id the id carried by the envelope.
+    */
+    void receive(const int id);
+
+    /**
+    * Turn the last received frame into a skipped one, e.g. because it
+    * has been found corrupted after the reception.
+    */
+    void reject();
+
+    /**
+    * Append the server counters as (key value) pairs.
+    * @param b the bottle to fill.
+    */
+    void serverToBottle(yarp::os::Bottle &b) const;
+
+    /**
+    * Append the client counters as (key value) pairs; skipped frames
+    * are net of the withheld ones.
+    * @param b the bottle to fill.
+    */
+    void clientToBottle(yarp::os::Bottle &b) const;
+};
+
+}
+
+#endif
+
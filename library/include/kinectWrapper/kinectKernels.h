@@ -0,0 +1,82 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __KINECT_KERNELS_H__
+#define __KINECT_KERNELS_H__
+
+#include <opencv2/opencv.hpp>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* Pack depth and player labels in the format streamed by the server,
+* i.e. depth in mm in the 13 most significant bits and player in the 3
+* least significant ones.
+* @param depth the depth in mm.
+* @param labels the player labels.
+* @param packed the packed buffer.
+* @param n the number of pixels.
+*/
+void packDepthPlayers(const unsigned short *depth, const unsigned short *labels,
+                      unsigned short *packed, const int n);
+
+/**
+* @ingroup kinectWrapper
+*
+* Extract the depth in mm from a packed buffer.
+* @param packed the packed buffer.
+* @param depth the depth in mm.
+* @param n the number of pixels.
+*/
+void unpackDepth(const unsigned short *packed, unsigned short *depth, const int n);
+
+/**
+* @ingroup kinectWrapper
+*
+* Extract the depth from a packed buffer, scaled in [0,1].
+* @param packed the packed buffer.
+* @param depth the scaled depth.
+* @param n the number of pixels.
+*/
+void unpackDepthScaled(const unsigned short *packed, float *depth, const int n);
+
+/**
+* @ingroup kinectWrapper
+*
+* Extract the player labels from a packed buffer.
+* @param packed the packed buffer.
+* @param players the labels, e.g. the data of a row-major Matrix.
+* @param n the number of pixels.
+*/
+void unpackPlayers(const unsigned short *packed, double *players, const int n);
+
+/**
+* @ingroup kinectWrapper
+*
+* Halve a 16 bit single channel image keeping the pixels of odd rows
+* and columns, i.e. without mixing depth values.
+* @param src the image to halve.
+* @param dst the halved image.
+*/
+void decimateDepth(const IplImage *src, IplImage *dst);
+
+}
+
+#endif
+
@@ -0,0 +1,98 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __KINECT_LATENCY_H__
+#define __KINECT_LATENCY_H__
+
+#include <yarp/os/Bottle.h>
+
+#define LATENCY_SUB_BUCKETS     16      // linear buckets per power of two
+#define LATENCY_MAGNITUDES      24      // from 1 [us] up to about 134 [s]
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* Histogram of latencies with a constant relative resolution, in the
+* spirit of HDR histograms: every power of two of microseconds is split
+* into 16 linear buckets, so that percentiles are given within about
+* 6% whatever the magnitude. The buckets are a fixed array and adding a
+* sample neither allocates nor depends on the number of samples.
+*/
+class LatencyHistogram
+{
+protected:
+    unsigned int counts[LATENCY_MAGNITUDES*LATENCY_SUB_BUCKETS];
+    unsigned int count;
+    double sum;
+    double max;
+
+    static int getBucket(const double us);
+    static double getBucketValue(const int bucket);
+
+public:
+    LatencyHistogram();
+
+    /**
+    * Forget all the samples.
+    */
+    void clear();
+
+    /**
+    * Add a sample.
+    * @param seconds the latency in seconds; negative values count as 0.
+    */
+    void add(const double seconds);
+
+    /**
+    * Retrieve the number of samples.
+    * @return the number of samples.
+    */
+    unsigned int getCount() const;
+
+    /**
+    * Retrieve the mean of the samples.
+    * @return the mean in seconds.
+    */
+    double getMean() const;
+
+    /**
+    * Retrieve the largest sample.
+    * @return the largest sample in seconds.
+    */
+    double getMax() const;
+
+    /**
+    * Retrieve a percentile.
+    * @param p the percentile in [0,100].
+    * @return the value in seconds below which p% of the samples lie.
+    */
+    double getPercentile(const double p) const;
+
+    /**
+    * Append (count n) (mean m) (p50 v) (p90 v) (p99 v) (max v), with
+    * values in [ms].
+    * @param b the bottle to fill.
+    */
+    void toBottle(yarp::os::Bottle &b) const;
+};
+
+}
+
+#endif
+
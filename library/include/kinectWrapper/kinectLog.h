@@ -0,0 +1,78 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __KINECT_LOG_H__
+#define __KINECT_LOG_H__
+
+#include <stdarg.h>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* Console output that does not stall the calling thread. Messages are
+* formatted by the caller into a ring owned by its thread and written
+* to stdout by a background thread every few milliseconds, in the order
+* they were issued; the caller never locks nor waits for the console.
+* Each call site, identified by its format string, prints at most 10
+* messages per second per thread, the others being counted and
+* reported as suppressed; messages issued while the ring of the thread
+* is full are counted as dropped.
+*
+* The background thread is started by the first message and stopped by
+* shutdown(), which the owners of YARP threads and ports call when they
+* close, before the YARP network goes down; a message issued afterwards
+* starts it again.
+*/
+class Logger
+{
+public:
+    /**
+    * Queue a message.
+    * @param prefix text put in front of the message, NULL if none.
+    * @param format the printf-like format, which identifies the site.
+    * @param ap the arguments.
+    * @return the length of the message, -1 if it has been suppressed
+    *         or dropped.
+    */
+    static int vprint(const char *prefix, const char *format, va_list ap);
+
+    /**
+    * Queue a message.
+    * @param format the printf-like format, which identifies the site.
+    * @return the length of the message, -1 if it has been suppressed
+    *         or dropped.
+    */
+    static int print(const char *format, ...);
+
+    /**
+    * Write all the queued messages before returning.
+    */
+    static void flush();
+
+    /**
+    * Stop the background thread and write all the queued messages
+    * before returning.
+    */
+    static void shutdown();
+};
+
+}
+
+#endif
+
@@ -0,0 +1,103 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __KINECT_REGISTRATION_H__
+#define __KINECT_REGISTRATION_H__
+
+#include <vector>
+
+#include <yarp/sig/Image.h>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* Software registration of packed depth images (depth in mm in the 13
+* most significant bits, player in the 3 least significant) onto the
+* rgb camera. Each depth pixel is given once the rotated ray R*K_d^-1*(u,v,1),
+* so that warping a frame costs a multiply-add per coordinate and a
+* projection; pixels landing on the same target are resolved keeping the
+* closest one.
+*/
+class DepthRegistration
+{
+protected:
+    int depthWidth;
+    int depthHeight;
+    int rgbWidth;
+    int rgbHeight;
+    float fx,fy,cx,cy;
+    float t[3];
+    std::vector<float> rays;
+
+public:
+    DepthRegistration();
+
+    /**
+    * Build the lookup tables.
+    * @param depthWidth the width of the depth image.
+    * @param depthHeight the height of the depth image.
+    * @param depthIntrinsics (fx fy cx cy) of the depth camera in pixels.
+    * @param rgbWidth the width of the registered image.
+    * @param rgbHeight the height of the registered image.
+    * @param rgbIntrinsics (fx fy cx cy) of the rgb camera in pixels,
+    *                      at the resolution of the registered image.
+    * @param rotation the 3x3 row-major rotation from the depth to the
+    *                 rgb camera frame.
+    * @param translation the translation from the depth to the rgb camera
+    *                    frame, in meters.
+    * @return true/false if successful/failed.
+    */
+    bool setup(int depthWidth, int depthHeight, const double *depthIntrinsics,
+               int rgbWidth, int rgbHeight, const double *rgbIntrinsics,
+               const double *rotation, const double *translation);
+
+    /**
+    * Tell if the lookup tables have been built.
+    * @return true/false if ready/not ready.
+    */
+    bool isReady() const;
+
+    /**
+    * Retrieve the intrinsics of the registered image.
+    * @param intrinsics (fx fy cx cy) in pixels.
+    */
+    void getRgbIntrinsics(double *intrinsics) const;
+
+    /**
+    * Warp a packed depth buffer onto the rgb camera.
+    * @param depth the packed depth buffer, depthWidth x depthHeight.
+    * @param registered the packed registered buffer, rgbWidth x rgbHeight;
+    *                   pixels not hit by any depth pixel are set to 0.
+    */
+    void apply(const unsigned short *depth, unsigned short *registered) const;
+
+    /**
+    * Warp a packed depth image onto the rgb camera.
+    * @param depth the packed depth image.
+    * @param registered the packed registered image.
+    * @return true/false if successful/failed.
+    */
+    bool apply(const yarp::sig::ImageOf<yarp::sig::PixelMono16> &depth,
+               yarp::sig::ImageOf<yarp::sig::PixelMono16> &registered) const;
+};
+
+}
+
+#endif
+
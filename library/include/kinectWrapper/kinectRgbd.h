@@ -0,0 +1,64 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __KINECT_RGBD_H__
+#define __KINECT_RGBD_H__
+
+#include <yarp/os/Portable.h>
+#include <yarp/sig/Image.h>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* Depth and rgb images acquired in the same frame, sent as a single
+* message so that they reach the readers as a matched pair. Depth is
+* packed as on depth:o (mm in the 13 most significant bits, player in
+* the 3 least significant); each image keeps its own acquisition
+* timestamp. On the wire the frame is a regular Bottle, readable by
+* any port:
+* (timestampDepth timestampRgb registered (width height {depth})
+*  (width height {rgb}))
+* where the images are blobs of unpadded rows, 16-bit depth and 8-bit
+* r,g,b triplets, in the byte order of the host.
+*/
+class RgbdFrame : public yarp::os::Portable
+{
+public:
+    yarp::sig::ImageOf<yarp::sig::PixelMono16> depth;
+    yarp::sig::ImageOf<yarp::sig::PixelRgb> rgb;
+    double timestampDepth;
+    double timestampRgb;
+    bool registered;
+
+    RgbdFrame();
+
+    /**
+    * Extract the depth in mm, dropping the player bits.
+    * @param depthMM the resulting depth image.
+    */
+    void unpackDepth(yarp::sig::ImageOf<yarp::sig::PixelMono16> &depthMM) const;
+
+    bool read(yarp::os::ConnectionReader &connection);
+    bool write(yarp::os::ConnectionWriter &connection);
+};
+
+}
+
+#endif
+
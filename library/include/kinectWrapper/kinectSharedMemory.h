@@ -0,0 +1,125 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __KINECT_SHARED_MEMORY_H__
+#define __KINECT_SHARED_MEMORY_H__
+
+#include <string>
+
+#include <yarp/sig/Image.h>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* Ring of image slots living in a POSIX shared memory segment, written
+* by the server and mapped read-only by the clients running on the same
+* host. Each slot is guarded by a sequence number which is odd while
+* the slot is being written (seqlock), so that readers never lock the
+* writer. Frames are handed to the readers as views on the segment: a
+* view stays valid until the writer wraps around the ring, i.e. for
+* slots-1 frames, which isValid() can verify. Not available on Windows.
+*/
+class SharedFrameRing
+{
+protected:
+    bool writer;
+    int fd;
+    unsigned char *base;
+    size_t size;
+    std::string name;
+    unsigned int count;
+    unsigned int viewSeq;
+    unsigned char *viewSlot;
+
+    bool map(const bool readOnly);
+    unsigned char *getSlot(const unsigned int frame) const;
+
+public:
+    SharedFrameRing();
+    ~SharedFrameRing();
+
+    /**
+    * Build the name of the segment of a stream.
+    * @param stem the port stem-name of the server.
+    * @param stream the stream (e.g. depth or rgb).
+    * @return the segment name.
+    */
+    static std::string getSegmentName(const std::string &stem, const std::string &stream);
+
+    /**
+    * Create the segment (writer side).
+    * @param name the segment name.
+    * @param slots the number of slots of the ring.
+    * @param slotBytes the capacity of each slot in bytes.
+    * @return true/false if successful/failed.
+    */
+    bool create(const std::string &name, const int slots, const int slotBytes);
+
+    /**
+    * Map an existing segment read-only (reader side); it fails if the
+    * segment has been created on a different host.
+    * @param name the segment name.
+    * @return true/false if successful/failed.
+    */
+    bool attach(const std::string &name);
+
+    /**
+    * Unmap the segment; the writer also removes it.
+    */
+    void close();
+
+    /**
+    * Tell if the segment is mapped.
+    * @return true/false if mapped/not mapped.
+    */
+    bool isOpen() const;
+
+    /**
+    * Copy a frame in the next slot.
+    * @param img the image.
+    * @param timestamp the timestamp of the frame.
+    * @param id the frame number assigned at acquisition.
+    * @return true/false if successful/failed (the image does not fit).
+    */
+    bool write(const yarp::sig::Image &img, const double timestamp, const int id);
+
+    /**
+    * Retrieve the latest frame, if not already retrieved. Only the
+    * header of the slot is checked here: the pixels are read while the
+    * writer may go on, hence isValid() must be called once the view has
+    * been used (copied, unpacked) and the frame discarded if it fails.
+    * @param view the image pointing to the segment, to be treated as
+    *             read-only; its pixel type must match the one written.
+    * @param timestamp the timestamp of the frame.
+    * @param id the frame number assigned at acquisition.
+    * @return true/false if a new frame is available/not available.
+    */
+    bool read(yarp::sig::Image &view, double &timestamp, int &id);
+
+    /**
+    * Tell if the latest view has not been overwritten yet.
+    * @return true/false if valid/overwritten.
+    */
+    bool isValid() const;
+};
+
+}
+
+#endif
+
@@ -0,0 +1,63 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __KINECT_SKELETON_H__
+#define __KINECT_SKELETON_H__
+
+#include <deque>
+
+#include <yarp/os/Bottle.h>
+
+#include <kinectWrapper/kinectWrapper.h>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* Parse a player as streamed over joints:o, i.e.
+* (id (name (u v x y z [confidence])) ...); the confidence is 1 when
+* missing, as in the streams of older servers.
+* @param player the bottle of the player.
+* @param p the parsed player.
+* @return true/false if successful/malformed bottle.
+*/
+bool parsePlayer(const yarp::os::Bottle &player, Player &p);
+
+/**
+* @ingroup kinectWrapper
+*
+* Parse the players streamed over joints:o; malformed players are
+* skipped.
+* @param skeleton the bottle containing one list per player.
+* @param players the parsed players.
+*/
+void parseSkeleton(const yarp::os::Bottle &skeleton, std::deque<Player> &players);
+
+/**
+* @ingroup kinectWrapper
+*
+* Write players in the format of joints:o.
+* @param players the players.
+* @param skeleton the resulting bottle.
+*/
+void writeSkeleton(const std::deque<Player> &players, yarp::os::Bottle &skeleton);
+
+}
+
+#endif
+
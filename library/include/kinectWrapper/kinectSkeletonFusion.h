@@ -0,0 +1,147 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+
+#ifndef __KINECT_SKELETON_FUSION_H__
+#define __KINECT_SKELETON_FUSION_H__
+
+#include <string>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <kinectWrapper/kinectWrapper.h>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* Fusion of the players seen by several sensors whose joints are
+* expressed in a common frame. Players are associated greedily by the
+* distance of their centers of mass, never merging two players seen by
+* the same sensor; joints are then averaged with weights given by the
+* joint confidence over the squared distance from the sensor, as depth
+* noise grows quadratically with the range. Fused players keep their ID
+* across calls as long as they are found within the association gate;
+* a player missed for less than a timeout (e.g. a single failed
+* detection) gets its ID back when seen again. Joint names are indexed
+* once, so that the fusion of a frame accumulates in plain arrays kept
+* across calls.
+*/
+class SkeletonFusion
+{
+protected:
+    struct Observation
+    {
+        int sensor;
+        const Player *player;
+        double center[3];
+        double weight;
+    };
+
+    struct Track
+    {
+        int ID;
+        double center[3];
+        double lastSeen;
+    };
+
+    struct Pair
+    {
+        double distance;
+        int i,j;
+        bool operator<(const Pair &p) const { return distance<p.distance; }
+    };
+
+    struct Accumulator
+    {
+        double x,y,z;
+        double weight;
+        double confidence;
+        double bestWeight;
+        int u,v;
+        Accumulator() : x(0.0), y(0.0), z(0.0), weight(0.0),
+                        confidence(0.0), bestWeight(-1.0), u(0), v(0) { }
+    };
+
+    int nSensors;
+    double gate;
+    double minRange;
+    double timeout;
+    int nextID;
+    std::vector<double> origins;
+    std::vector<Track> tracks;
+
+    //scratch of fuse(), kept to avoid allocations
+    std::vector<Observation> obs;
+    std::vector<Pair> pairs;
+    std::vector<int> parent;
+    std::vector<unsigned int> sensors;
+    std::vector<int> clusters;
+    std::vector<Track> centers;
+    std::map<std::string,int> jointIndex;
+    std::vector<std::string> jointNames;
+    std::vector<Accumulator> accumulators;
+
+    int getJointIndex(const std::string &name);
+    static bool getCenter(const Player &player, double *center);
+    static double distance(const double *a, const double *b);
+    void assignIDs(std::deque<Player> &fused, const double timestamp);
+
+public:
+    SkeletonFusion();
+
+    /**
+    * Configure the fusion.
+    * @param nSensors the number of sensors (at most 32).
+    * @param gate the maximum distance in meters between the centers of
+    *             mass of two players to be associated.
+    * @param minRange the range in meters below which the weight of a
+    *                 sensor stops growing.
+    * @param timeout the time in seconds a player not seen any longer
+    *                keeps its ID for.
+    * @return true/false if successful/failed.
+    */
+    bool configure(const int nSensors, const double gate=0.5, const double minRange=0.5,
+                   const double timeout=1.0);
+
+    /**
+    * Set the position of a sensor in the common frame (the origin by
+    * default).
+    * @param sensor the sensor index.
+    * @param origin the (x,y,z) position in meters.
+    */
+    void setSensorOrigin(const int sensor, const double *origin);
+
+    /**
+    * Fuse the players seen by the sensors.
+    * @param players the players seen by each sensor, in the common
+    *                frame; a sensor without fresh data contributes an
+    *                empty list.
+    * @param fused the fused players.
+    * @param timestamp the time of the players in seconds, used to retire
+    *                  the IDs of the players not seen any longer.
+    */
+    void fuse(const std::vector<std::deque<Player> > &players, std::deque<Player> &fused,
+              const double timestamp);
+};
+
+}
+
+#endif
+
@@ -0,0 +1,144 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __KINECT_SUBSCRIPTION_H__
+#define __KINECT_SUBSCRIPTION_H__
+
+#include <string>
+
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/sig/Image.h>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* Dedicated depth and rgb output ports opened by the server on behalf
+* of a single client. Since a shared port hides which reader is slow,
+* each subscriber gets its own connection; in adaptive mode a frame
+* still being sent when the next one is ready counts as a drop (this
+* requires a carrier that blocks the writer, such as tcp: over udp a
+* write never lasts), and
+* the stream is degraded one level at a time (first the rate, then the
+* resolution) as long as drops persist, and restored once the
+* connection has kept up for a while. Subscribers that need a slow
+* stream can also ask for a fixed decimation or a maximum rate, so that
+* the skipped frames are neither serialized nor sent.
+*/
+class Subscription
+{
+protected:
+    std::string name;
+    bool rgb;
+    bool adaptive;
+    bool connected;
+    int decimation;
+    double minPeriod;
+    double lastSent;
+    int level;
+    int counter;
+    int window;
+    int drops;
+    double lastChange;
+    unsigned int pending;
+    unsigned int withheld;
+
+    yarp::os::Stamp tsD,tsI;
+    yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelMono16> > depthPort;
+    yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> > imagePort;
+
+    void adapt(const bool dropped);
+
+public:
+    Subscription();
+
+    /**
+    * Open the ports /prefix/depth:o and, if required, /prefix/image:o.
+    * @param prefix the stem of the port names.
+    * @param rgb if true, rgb images are streamed too.
+    * @param adaptive if true, the level follows the backpressure.
+    * @param decimation one frame out of decimation is sent.
+    * @param maxRate the maximum rate in [Hz], not enforced if <=0.
+    * @return true/false if successful/failed.
+    */
+    bool open(const std::string &prefix, const bool rgb, const bool adaptive,
+              const int decimation=1, const double maxRate=0.0);
+
+    /**
+    * Close the ports.
+    */
+    void close();
+
+    /**
+    * Tell if the subscriber went away, i.e. if all the connections
+    * established since the subscription have been dropped.
+    * @return true/false if gone/alive.
+    */
+    bool isGone();
+
+    /**
+    * Send a frame, if the current level lets it through.
+    * @param depth the packed depth image.
+    * @param stampD the depth envelope.
+    * @param image the rgb image, NULL if not available.
+    * @param stampI the rgb envelope.
+    */
+    void write(const yarp::sig::ImageOf<yarp::sig::PixelMono16> &depth, const yarp::os::Stamp &stampD,
+               const yarp::sig::ImageOf<yarp::sig::PixelRgb> *image, const yarp::os::Stamp &stampI);
+
+    /**
+    * Retrieve the current level (0 is the full stream).
+    * @return the level.
+    */
+    int getLevel() const;
+
+    /**
+    * Retrieve the number of frames one frame is sent out of, combining
+    * the requested decimation with the current level.
+    * @return the decimation factor.
+    */
+    int getDecimation() const;
+
+    /**
+    * Retrieve the factor the image sides are divided by.
+    * @return the scale factor.
+    */
+    int getScale() const;
+
+    /**
+    * Retrieve the number of frames deliberately not sent, because of
+    * the decimation, the maximum rate or the current level, between
+    * the first and the last frame sent. Frames dropped because the
+    * connection lags behind are not included.
+    * @return the withheld frames.
+    */
+    unsigned int getWithheld() const;
+
+    /**
+    * Retrieve the names of the output ports.
+    * @param depthName the depth port name.
+    * @param imageName the rgb port name (empty if not streamed).
+    */
+    void getPortNames(std::string &depthName, std::string &imageName);
+};
+
+}
+
+#endif
+
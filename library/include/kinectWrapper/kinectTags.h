@@ -30,7 +30,18 @@
 #define KINECT_TAGS_CMD_ACK                 "ack"
 #define KINECT_TAGS_CMD_NACK                "nack"
 #define KINECT_TAGS_CMD_GET3DPOINT          "get3D"
+#define KINECT_TAGS_CMD_GET3DPOINTS         "get3DPoints"
 #define KINECT_TAGS_CMD_GETFOCALLENGTH      "getFL"
+#define KINECT_TAGS_CMD_SETEXTRINSICS       "setExtrinsics"
+#define KINECT_TAGS_CMD_GETEXTRINSICS       "getExtrinsics"
+#define KINECT_TAGS_CMD_RECONFIGURE         "reconfigure"
+#define KINECT_TAGS_CMD_SUBSCRIBE           "subscribe"
+#define KINECT_TAGS_CMD_UNSUBSCRIBE         "unsubscribe"
+#define KINECT_TAGS_CMD_GETSUBSCRIPTION     "getSubscription"
+#define KINECT_TAGS_CMD_GETSHAREDMEMORY     "getSharedMemory"
+#define KINECT_TAGS_CMD_GETFRAMESTATS       "getFrameStats"
+#define KINECT_TAGS_CMD_STATS               "stats"
+#define KINECT_TAGS_CMD_TRACE               "trace"
 #define KINECT_TAGS_SEATED_MODE             "seated"
 #define KINECT_TAGS_CLOSEST_PLAYER          -1
 
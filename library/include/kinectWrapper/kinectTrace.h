@@ -0,0 +1,97 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __KINECT_TRACE_H__
+#define __KINECT_TRACE_H__
+
+#include <string>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* Collects spans of work done on each frame (driver read, publish,
+* receive, unpack) and dumps them in the Chrome trace format (to be
+* opened with chrome://tracing), with times in host monotonic
+* microseconds so that traces of processes running on the same host
+* line up. Every thread records into its own ring, which only that
+* thread writes and only dump() reads, hence recording never locks;
+* spans are dropped while a ring is full. Tracing is compiled in with
+* the ENABLE_TRACING build option only: otherwise the macros below
+* expand to nothing and dump() does not produce any file.
+*/
+class Tracer
+{
+public:
+    /**
+    * Tell if tracing has been compiled in.
+    * @return true/false if available/not available.
+    */
+    static bool isEnabled();
+
+    /**
+    * Record a span of the calling thread.
+    * @param name the name of the span, which must be a literal.
+    * @param id the frame the span refers to.
+    * @param begin the start in host monotonic seconds.
+    * @param end the end in host monotonic seconds.
+    */
+    static void record(const char *name, const int id, const double begin, const double end);
+
+    /**
+    * Write the spans recorded so far by all the threads and forget
+    * them.
+    * @param fileName the json file to write.
+    * @return true/false if successful/failed.
+    */
+    static bool dump(const std::string &fileName);
+};
+
+/**
+* @ingroup kinectWrapper
+*
+* Span lasting as long as the object, recorded only if a frame has
+* been assigned to it.
+*/
+class TraceScope
+{
+protected:
+    const char *name;
+    int id;
+    double begin;
+
+public:
+    TraceScope(const char *name);
+    ~TraceScope();
+    void setId(const int id);
+};
+
+}
+
+#ifdef __KINECT_TRACING__
+    #define KINECT_TRACE_SPAN(name,id,begin,end)    kinectWrapper::Tracer::record(name,id,begin,end)
+    #define KINECT_TRACE_SCOPE(scope,name)          kinectWrapper::TraceScope scope(name)
+    #define KINECT_TRACE_ID(scope,id)               scope.setId(id)
+#else
+    #define KINECT_TRACE_SPAN(name,id,begin,end)    ((void)0)
+    #define KINECT_TRACE_SCOPE(scope,name)
+    #define KINECT_TRACE_ID(scope,id)               ((void)0)
+#endif
+
+#endif
+
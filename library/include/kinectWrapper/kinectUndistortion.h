@@ -0,0 +1,113 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __KINECT_UNDISTORTION_H__
+#define __KINECT_UNDISTORTION_H__
+
+#include <vector>
+
+#include <yarp/sig/Image.h>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* Lens undistortion through remap tables computed once per camera.
+* The plumb-bob model (k1 k2 p1 p2 k3) is used, and the undistorted
+* image keeps the intrinsics of the distorted one. Packed depth images
+* are remapped with nearest-neighbour interpolation so that depth and
+* player bits are never blended; rgb images are remapped bilinearly
+* with fixed-point weights.
+*/
+class Undistortion
+{
+protected:
+    struct Tap
+    {
+        int offset;
+        unsigned short weights[4];
+    };
+
+    int width;
+    int height;
+    bool bilinear;
+    std::vector<int> nearest;
+    std::vector<Tap> taps;
+
+public:
+    Undistortion();
+
+    /**
+    * Build the remap table.
+    * @param width the width of the image.
+    * @param height the height of the image.
+    * @param intrinsics (fx fy cx cy) of the camera in pixels.
+    * @param distortion (k1 k2 p1 p2 k3) coefficients.
+    * @param bilinear true to build the table for bilinear interpolation
+    *                 (rgb images), false for nearest-neighbour (depth).
+    * @return true/false if successful/failed.
+    */
+    bool setup(int width, int height, const double *intrinsics,
+               const double *distortion, bool bilinear);
+
+    /**
+    * Tell if the remap table has been built.
+    * @return true/false if ready/not ready.
+    */
+    bool isReady() const;
+
+    /**
+    * Undistort a packed depth buffer (nearest-neighbour table only).
+    * @param depth the distorted buffer, width x height.
+    * @param undistorted the undistorted buffer, width x height; pixels
+    *                    falling outside the source are set to 0.
+    */
+    void apply(const unsigned short *depth, unsigned short *undistorted) const;
+
+    /**
+    * Undistort an interleaved 3-channel 8-bit buffer (bilinear table
+    * only).
+    * @param rgb the distorted buffer, width x height.
+    * @param undistorted the undistorted buffer, width x height; pixels
+    *                    falling outside the source are set to 0.
+    */
+    void apply(const unsigned char *rgb, unsigned char *undistorted) const;
+
+    /**
+    * Undistort a packed depth image.
+    * @param depth the distorted image.
+    * @param undistorted the undistorted image.
+    * @return true/false if successful/failed.
+    */
+    bool apply(const yarp::sig::ImageOf<yarp::sig::PixelMono16> &depth,
+               yarp::sig::ImageOf<yarp::sig::PixelMono16> &undistorted) const;
+
+    /**
+    * Undistort an rgb image.
+    * @param rgb the distorted image.
+    * @param undistorted the undistorted image.
+    * @return true/false if successful/failed.
+    */
+    bool apply(const yarp::sig::ImageOf<yarp::sig::PixelRgb> &rgb,
+               yarp::sig::ImageOf<yarp::sig::PixelRgb> &undistorted) const;
+};
+
+}
+
+#endif
+
@@ -0,0 +1,117 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __KINECT_VOXEL_GRID_H__
+#define __KINECT_VOXEL_GRID_H__
+
+#include <vector>
+
+#include <yarp/sig/Image.h>
+
+#include <kinectWrapper/kinectCloud.h>
+#include <kinectWrapper/kinectBands.h>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* Downsample the points of a depth image on a regular grid of voxels
+* spanning a bounding box. The grid is dense and keeps the slot of each
+* occupied voxel, so that the cost of a frame is linear in the number
+* of pixels plus the number of occupied voxels. Projection, voxel
+* lookup and accumulation are carried out in parallel over bands of
+* rows, each band summing its points in a small hash table of its own;
+* the calling thread then merges the voxels occupied by the bands. With
+* a single band the points are summed straight into the grid.
+*/
+class VoxelGrid : protected BandJob
+{
+protected:
+    double box[6];
+    double voxelSize;
+    int nx,ny,nz;
+    int width;
+    int height;
+
+    std::vector<int> grid;
+    std::vector<int> occupied;
+    std::vector<float> sums;
+    std::vector<float> cloud;
+    std::vector<unsigned short> depthBuf;
+
+    //open addressing table of the voxels occupied by a band
+    struct Band
+    {
+        int shift;
+        std::vector<int> table;         // slot of each entry, -1 if free
+        std::vector<int> keys;          // voxel of each slot
+        std::vector<int> entries;       // table entry of each slot
+        std::vector<float> sums;        // x,y,z,count of each slot
+
+        Band() : shift(32) { }
+        int lookup(const int key);
+    };
+    std::vector<Band> bands;
+
+    const unsigned short *depthData;
+    CloudProjector *projector;
+    BandPool pool;
+
+    int getSlot(const int key);
+    void process(int band, int rowBegin, int rowEnd);
+    void merge(Band &band);
+
+public:
+    VoxelGrid();
+
+    /**
+    * Configure the grid.
+    * @param box the bounding box in meters given as (xmin xmax ymin
+    *            ymax zmin zmax); points outside are discarded.
+    * @param voxelSize the edge of a voxel in meters.
+    * @param nBands the number of bands the frames are split in.
+    * @return true/false if successful/failed.
+    */
+    bool configure(const double *box, double voxelSize, int nBands=1);
+
+    /**
+    * Tell if the grid has been configured.
+    * @return true/false if ready/not ready.
+    */
+    bool isReady() const;
+
+    /**
+    * Voxelize a packed depth image.
+    * @param depth the packed depth image.
+    * @param projector the projector used to compute the 3D points.
+    * @param centroids a single row image containing the centroid of
+    *                  each occupied voxel.
+    * @return the number of occupied voxels, -1 on failure (e.g. the
+    *         depth size differs from the one of the projector).
+    */
+    int compute(const yarp::sig::ImageOf<yarp::sig::PixelMono16> &depth,
+                CloudProjector &projector,
+                yarp::sig::ImageOf<yarp::sig::PixelRgbFloat> &centroids);
+
+    virtual ~VoxelGrid() { }
+};
+
+}
+
+#endif
+
@@ -34,6 +34,8 @@
 #include <string>
 #include <deque>
 #include <map>
+#include <vector>
+#include <utility>
 #include <yarp/os/BufferedPort.h>
 #include <yarp/sig/Vector.h>
 #include <yarp/sig/Matrix.h>
@@ -47,7 +49,7 @@ namespace kinectWrapper
 * @ingroup kinectWrapper 
 *  
 * Structure to model a joint position in 2D (u,v) and in 3D 
-* (x,y,z). 
+* (x,y,z), along with the tracking confidence in [0,1].
 */
 struct Joint
 {
@@ -56,6 +58,7 @@ struct Joint
     double x;
     double y;
     double z;
+    double confidence;
 };
 
 typedef std::map<std::string, Joint> Skeleton;
@@ -93,11 +96,49 @@ public:
     *    the client stem-name to be used for opening ports.
     *
     * \b carrier <string>: example (carrier udp), specifies the
-    *    protocol used to connect yarp streaming ports.
+    *    protocol used to connect yarp streaming ports. With mcast the
+    *    client joins the multicast group of each stream, so that the
+    *    server sends every frame once whatever the number of clients;
+    *    if the group cannot be joined, udp is used instead. If not
+    *    given, the carrier suggested by the server is used (see the
+    *    multicast server option), udp otherwise.
     *
     * \b verbosity <int>: example (verbosity 3), specifies the
     *    verbosity level of print-outs messages.
     *
+    * \b cloud: if present, the client connects to the organized
+    *    point cloud streamed by the server.
+    *
+    * \b rgbd: if present, the client connects to the paired depth
+    *    and rgb images streamed by the server, see getRgbd.
+    *
+    * \b adaptive: if present, the server streams depth and rgb to
+    *    this client over dedicated ports, lowering first the rate and
+    *    then the resolution while the connection lags behind and
+    *    restoring them once it catches up; the current level is
+    *    reported by getInfo as stream_level, stream_decimation,
+    *    stream_scale and stream_withheld, the frames not sent on
+    *    purpose so far. The lag is sensed through the backpressure of
+    *    the connection, which udp and mcast do not provide: with these
+    *    carriers depth and rgb are connected through tcp.
+    *
+    * \b decimation <int>: example (decimation 10), the server sends
+    *    depth and rgb to this client only once every decimation
+    *    frames, over dedicated ports as with adaptive.
+    *
+    * \b max_rate <double>: example (max_rate 2.0), the server sends
+    *    depth and rgb to this client at most at max_rate [Hz], over
+    *    dedicated ports as with adaptive.
+    *
+    * \b shmem: if present and the server runs on the same host with
+    *    the shmem option, depth and rgb are read from its shared
+    *    memory rings instead of the ports.
+    *
+    * \b trace <string>: example (trace client.json), when closed the
+    *    client writes the spans of reception and unpacking of each
+    *    frame in the Chrome trace format, if the library is built with
+    *    the ENABLE_TRACING option (see Tracer).
+    *
     * Available options for the server are:
     *
     * \b name <string>: example (name kinectServer), specifies the
@@ -128,6 +169,84 @@ public:
     * \b image_height <int>: example (image_height 240), specifies the
     *    height of the rgb image to send.
     *
+    * \b cloud: if present, the server streams the organized point
+    *    cloud computed from each depth frame over /name/cloud:o.
+    *
+    * \b voxels: if present, the server streams over /name/voxels:o
+    *    the centroids of the occupied voxels of a grid built on the
+    *    points of each depth frame, as a single row float image.
+    *
+    * \b voxel_size <double>: example (voxel_size 0.02), specifies the
+    *    edge of the voxels in meters.
+    *
+    * \b voxel_box (<double> x 6): example (voxel_box (-1 1 -1 1 0 3)),
+    *    specifies the bounding box (xmin xmax ymin ymax zmin zmax) in
+    *    meters of the voxel grid.
+    *
+    * \b voxel_bands <int>: example (voxel_bands 4), specifies the
+    *    number of bands the frame is split in to voxelize in parallel.
+    *
+    * \b depth_undistortion <group>: depth images are undistorted
+    *    through a remap table computed at start-up, with
+    *    nearest-neighbour interpolation. The group contains
+    *    intrinsics (fx fy cx cy) at the depth resolution and
+    *    distortion (k1 k2 p1 p2 [k3]).
+    *
+    * \b rgb_undistortion <group>: as depth_undistortion for the rgb
+    *    images, with bilinear interpolation and intrinsics at the rgb
+    *    resolution.
+    *
+    * \b device_index <int>: the index of the device to open.
+    *
+    * \b device_serial <string>: the serial of the device to open,
+    *    overriding device_index.
+    *
+    * \b host_clock <bool>: envelopes are always given in seconds of
+    *    the host monotonic clock; by default the device time of each
+    *    frame is mapped onto it by estimating the offset and drift of
+    *    the device clock, while if present the host time taken when the
+    *    frame is acquired is used as it is, shared by all the streams.
+    *
+    * \b extrinsics <list>: example (extrinsics (r00 r01 r02 tx ... 0 0 0 1)),
+    *    the 4x4 row-major transformation from the camera frame to the
+    *    frame all the 3D outputs are expressed in (the voxel box is
+    *    still given in the camera frame).
+    *
+    * \b registration <group>: if the driver does not align depth with
+    *    rgb, depth is registered onto the rgb camera in software. The
+    *    group contains depth_intrinsics (fx fy cx cy) at the depth
+    *    resolution, rgb_intrinsics (fx fy cx cy) at the rgb resolution,
+    *    rotation (r00 r01 ... r22) and translation (tx ty tz) in meters
+    *    from the depth to the rgb camera. If the group contains
+    *    rgbd_only, only the depth of the rgbd:o pairs is registered.
+    *
+    * \b rgbd: if present, the server streams over /name/rgbd:o the
+    *    depth and rgb images of each frame in a single message.
+    *
+    * \b shmem: if present, depth and rgb frames are also written in
+    *    POSIX shared memory rings (not available on Windows) read by
+    *    the clients on the same host.
+    *
+    * \b shmem_slots <int>: example (shmem_slots 4), the number of
+    *    frames held by each ring.
+    *
+    * \b multicast: if present, clients not asking for a specific
+    *    carrier connect to depth:o, image:o, joints:o and cloud:o
+    *    through mcast.
+    *
+    * \b trace <string>: example (trace server.json), when closed the
+    *    server writes the spans of acquisition, processing and
+    *    publication of each frame, as the client option.
+    *
+    * \b synthetic: if present, frames are generated by the server
+    *    instead of being read from a device, at any resolution and at
+    *    the rate given by period (see KinectDriverSynthetic). This is
+    *    the only driver available if the library is built without
+    *    OpenNI and the Kinect SDK.
+    *
+    * \b synthetic_players <int>: example (synthetic_players 2), the
+    *    number of players in the synthetic scene.
+    *
     * @return true/false if successful/failed.
     */
     virtual bool open(const yarp::os::Property &options) = 0;
@@ -182,6 +301,16 @@ public:
     */
     virtual bool getPlayers(yarp::sig::Matrix &players, double *timestamp) = 0;
 
+    /**
+    * Retrieve the organized point cloud computed from the depth image.
+    * @param cloud the retrieved cloud, each pixel containing the x, y
+    * and z coordinates in meters of the corresponding depth pixel; pixels
+    * with no valid depth are set to NaN.
+    * @param timestamp when the depth image has been retrieved.
+    * @return true/false if successful/failed.
+    */
+    virtual bool getCloud(yarp::sig::ImageOf<yarp::sig::PixelRgbFloat> &cloud, double *timestamp) = 0;
+
     /**
     * Retrieve the rgb image.
     * @param rgbIm the rgb image that has been retrieved.
@@ -190,6 +319,17 @@ public:
     */
     virtual bool getRgb(yarp::sig::ImageOf<yarp::sig::PixelRgb> &rgbIm, double *timestamp) = 0;
 
+    /**
+    * Retrieve depth and rgb images acquired in the same frame.
+    * @param depthIm the depth image in mm.
+    * @param rgbIm the rgb image.
+    * @param timestampDepth when the depth image has been retrieved.
+    * @param timestampRgb when the rgb image has been retrieved.
+    * @return true/false if successful/failed.
+    */
+    virtual bool getRgbd(yarp::sig::ImageOf<yarp::sig::PixelMono16> &depthIm, yarp::sig::ImageOf<yarp::sig::PixelRgb> &rgbIm,
+                         double *timestampDepth, double *timestampRgb) = 0;
+
     /**
     * Retrieve the joints position of all the players.
     * @param joints a deque of Players, each Player containing information about its joints position.
@@ -211,6 +351,8 @@ public:
     * Retrieve some info regarding which information is retrieved from kinect,
     * whether the driver is opened in seated mode, the width and the height of
     * the rgb image.
+    * The server also reports the current mapping of the device clock
+    * onto the host monotonic clock as clock_offset and clock_drift.
     * @param opt Property containing all the information.
     * @return true/false if successful/failed.
     */
@@ -252,13 +394,71 @@ public:
 
     /**
     * Project a pixel in 3D
-    * @param u, the x coordinate of the pixel.
+    * @param u, the x coordinate of the pixel of the depth image as
+    *        delivered, i.e. after registration and undistortion.
     * @param v, the y coordinate of the pixel.
     * @param point3D, the resultant 3D point in meters.
     * @return true/false if successful/failed.
     */
     virtual bool get3DPoint(int u, int v, yarp::sig::Vector &point3D) = 0;
 
+    /**
+    * Project a set of pixels in 3D in one go; all the points are
+    * computed from the same depth frame.
+    * @param pixels, the (u,v) coordinates of the pixels.
+    * @param points3D, the resultant 3D points in meters, one per pixel.
+    * @return true/false if successful/failed.
+    */
+    virtual bool get3DPoints(const std::vector<std::pair<int,int> > &pixels, std::vector<yarp::sig::Vector> &points3D) = 0;
+
+    /**
+    * Set the transformation from the camera frame to the frame all the
+    * 3D outputs (joints, 3D points and clouds) are expressed in.
+    * @param H, the 4x4 homogeneous transformation.
+    * @return true/false if successful/failed.
+    */
+    virtual bool setExtrinsics(const yarp::sig::Matrix &H) = 0;
+
+    /**
+    * Get the transformation from the camera frame to the frame all the
+    * 3D outputs are expressed in.
+    * @param H, the 4x4 homogeneous transformation.
+    * @return true/false if successful/failed.
+    */
+    virtual bool getExtrinsics(yarp::sig::Matrix &H) = 0;
+
+    /**
+    * Change the server configuration without reopening it. The new
+    * configuration is applied between two frames; connected clients
+    * are notified over /name/info:o and adapt their buffers to the
+    * incoming images.
+    * @param options, any of img_width, img_height, depth_width,
+    *                 depth_height, info and period. The new info must
+    *                 request a subset of the streams the server was
+    *                 opened with; the depth resolution is fixed when
+    *                 registration or undistortion is active.
+    * @return true/false if the request was accepted/rejected; use
+    *         getInfo to verify the configuration eventually in place,
+    *         since the driver may not support the requested resolution.
+    */
+    virtual bool reconfigure(const yarp::os::Property &options) = 0;
+
+    /**
+    * Retrieve the frame accounting of the depth, rgb and joints
+    * streams, given as the groups depth, rgb and joints. Frames are
+    * numbered at acquisition by the server and the number is carried
+    * by the count of the envelopes. The server reports the frames
+    * acquired, published, unpublished (incomplete frame) and unread
+    * (no reader on the shared port, although the frame may have reached
+    * subscriptions or the shared memory) and the bytes published; the client adds the frames it received, skipped (numbers
+    * never seen) and duplicated, along with the server counters. Frames
+    * a subscription deliberately did not send (decimation, max_rate,
+    * adaptive levels) are reported as withheld rather than skipped.
+    * @param stats, the counters.
+    * @return true/false if successful/failed.
+    */
+    virtual bool getFrameStats(yarp::os::Property &stats) = 0;
+
     /**
      * Destructor.
      */
@@ -27,6 +27,12 @@
 
 #include <kinectWrapper/kinectTags.h>
 #include <kinectWrapper/kinectWrapper.h>
+#include <kinectWrapper/kinectSharedMemory.h>
+#include <kinectWrapper/kinectRgbd.h>
+#include <kinectWrapper/kinectFrameStats.h>
+#include <kinectWrapper/kinectTrace.h>
+#include <kinectWrapper/kinectLog.h>
+#include <kinectWrapper/kinectKernels.h>
 
 namespace kinectWrapper
 {
@@ -43,22 +49,42 @@ protected:
     bool noRpc;
     bool seatedMode;
     bool drawAll;
+    bool useCloud;
+    bool useRgbd;
+    bool adaptive;
+    bool subscribed;
     int verbosity;
     int img_width;
     int img_height;
     int depth_width;
     int depth_height;
+    int server_depth_width;
+    int server_depth_height;
 
     std::string remote;
     std::string local;
     std::string carrier;
     std::string info;
+    std::string openInfo;
+    std::string traceFile;
 
     yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> > imagePort;
     yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelMono16> > depthPort;
     yarp::os::BufferedPort<yarp::os::Bottle> jointsPort;
+    yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgbFloat> > cloudPort;
+    yarp::os::BufferedPort<RgbdFrame> rgbdPort;
+    yarp::os::BufferedPort<yarp::os::Bottle> infoPort;
     yarp::os::Port rpc;
 
+    SharedFrameRing depthRing;
+    SharedFrameRing rgbRing;
+    yarp::sig::ImageOf<yarp::sig::PixelMono16> depthView;
+    yarp::sig::ImageOf<yarp::sig::PixelRgb> rgbView;
+
+    FrameStats statsD;
+    FrameStats statsI;
+    FrameStats statsS;
+
     IplImage* depthCV;
     IplImage* depthCVPl;
     IplImage* depthFCV;
@@ -69,6 +95,20 @@ protected:
     IplImage* depthToShow;
 
     int printMessage(const int level, const char *format, ...) const;
+    void allocateBuffers();
+    void releaseBuffers();
+    void checkDepthSize(const int width, const int height);
+    void toServerPixel(int &u, int &v) const;
+    void parseInfo(const yarp::os::Bottle &b, const int offset);
+    void updateInfo();
+    bool subscribe(const yarp::os::Bottle &options, std::string &depthSource, std::string &imageSource);
+    void attachSharedMemory();
+    bool connectStream(const std::string &source, const std::string &destination,
+                       const std::string &through="");
+    yarp::sig::ImageOf<yarp::sig::PixelMono16>* readDepthFrame(double &timestamp);
+    yarp::sig::ImageOf<yarp::sig::PixelRgb>* readRgbFrame(double &timestamp);
+    bool validateDepthFrame();
+    bool validateRgbFrame();
     std::deque<Player> getJoints(yarp::os::Bottle *skeleton);
     Player getJoints(yarp::os::Bottle *skeleton, int playerId);
     Player managePlayerRequest(yarp::os::Bottle *skeleton, int playerId);
@@ -85,6 +125,9 @@ public:
     bool getDepthAndPlayers(yarp::sig::ImageOf<yarp::sig::PixelFloat> &depthIm, yarp::sig::Matrix &players, double *timestamp=NULL);
     bool getPlayers(yarp::sig::Matrix &players, double *timestamp=NULL);
     bool getRgb(yarp::sig::ImageOf<yarp::sig::PixelRgb> &rgbIm, double *timestamp=NULL);
+    bool getRgbd(yarp::sig::ImageOf<yarp::sig::PixelMono16> &depthIm, yarp::sig::ImageOf<yarp::sig::PixelRgb> &rgbIm,
+                 double *timestampDepth=NULL, double *timestampRgb=NULL);
+    bool getCloud(yarp::sig::ImageOf<yarp::sig::PixelRgbFloat> &cloud, double *timestamp=NULL);
     bool getJoints(std::deque<Player> &joints, double *timestamp=NULL);
     bool getJoints(Player &joints, int player, double *timestamp=NULL);
     void getPlayersImage(const yarp::sig::Matrix &players, yarp::sig::ImageOf<yarp::sig::PixelBgr> &image);
@@ -93,6 +136,11 @@ public:
     void getDepthImage(const yarp::sig::ImageOf<yarp::sig::PixelMono16> &depth, yarp::sig::ImageOf<yarp::sig::PixelFloat> &depthToDisplay);
     bool getInfo(yarp::os::Property &opt);
     bool get3DPoint(int u, int v, yarp::sig::Vector &point3D);
+    bool get3DPoints(const std::vector<std::pair<int,int> > &pixels, std::vector<yarp::sig::Vector> &points3D);
+    bool setExtrinsics(const yarp::sig::Matrix &H);
+    bool getExtrinsics(yarp::sig::Matrix &H);
+    bool reconfigure(const yarp::os::Property &options);
+    bool getFrameStats(yarp::os::Property &stats);
     bool getFocalLength(double &focallength);
     virtual ~KinectWrapperClient();
 };
@@ -0,0 +1,202 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+
+#ifndef __KINECTWRAPPER_MULTICLIENT_H__
+#define __KINECTWRAPPER_MULTICLIENT_H__
+
+#include <string>
+#include <deque>
+#include <vector>
+
+#include <yarp/os/all.h>
+#include <yarp/sig/all.h>
+
+#include <kinectWrapper/kinectTags.h>
+#include <kinectWrapper/kinectWrapper.h>
+
+namespace kinectWrapper
+{
+
+/**
+* @ingroup kinectWrapper
+*
+* The data of one server belonging to a time-aligned set.
+*/
+struct KinectFrame
+{
+    std::string remote;
+    double timestamp;
+    yarp::sig::ImageOf<yarp::sig::PixelMono16> depth;
+    yarp::sig::Matrix players;
+    bool hasRgb;
+    double rgbTimestamp;
+    yarp::sig::ImageOf<yarp::sig::PixelRgb> rgb;
+    bool hasJoints;
+    double jointsTimestamp;
+    std::deque<Player> joints;
+};
+
+/**
+* @ingroup kinectWrapper
+*
+* Client connecting to several servers at once. The streams of each
+* server are received and unpacked by the port callbacks, i.e. in
+* parallel per stream, into a short history; getFrames() then picks from
+* each server the depth frame closest to a common reference time, along
+* with the rgb image and the skeletons closest to it. Envelopes are used
+* for the alignment, hence servers of different devices should stamp
+* with the host clock (host_clock option).
+*/
+class KinectWrapperMultiClient
+{
+protected:
+    struct DepthSample
+    {
+        double timestamp;
+        yarp::sig::ImageOf<yarp::sig::PixelMono16> depth;
+        yarp::sig::Matrix players;
+    };
+
+    struct RgbSample
+    {
+        double timestamp;
+        yarp::sig::ImageOf<yarp::sig::PixelRgb> rgb;
+    };
+
+    struct JointsSample
+    {
+        double timestamp;
+        std::deque<Player> joints;
+    };
+
+    class Remote;
+
+    class DepthReader : public yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelMono16> >
+    {
+        Remote &remote;
+    public:
+        DepthReader(Remote &remote) : remote(remote) { }
+        void onRead(yarp::sig::ImageOf<yarp::sig::PixelMono16> &img);
+    };
+
+    class RgbReader : public yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> >
+    {
+        Remote &remote;
+    public:
+        RgbReader(Remote &remote) : remote(remote) { }
+        void onRead(yarp::sig::ImageOf<yarp::sig::PixelRgb> &img);
+    };
+
+    class JointsReader : public yarp::os::BufferedPort<yarp::os::Bottle>
+    {
+        Remote &remote;
+    public:
+        JointsReader(Remote &remote) : remote(remote) { }
+        void onRead(yarp::os::Bottle &skeleton);
+    };
+
+    class Remote
+    {
+    public:
+        std::string name;
+        size_t history;
+        bool useRgb;
+        bool useJoints;
+        yarp::os::Semaphore mutex;
+        std::deque<DepthSample> depth;
+        std::deque<RgbSample> rgb;
+        std::deque<JointsSample> joints;
+        DepthReader depthPort;
+        RgbReader imagePort;
+        JointsReader jointsPort;
+
+        Remote() : depthPort(*this), imagePort(*this), jointsPort(*this) { }
+    };
+
+    bool opening;
+    int verbosity;
+    double tolerance;
+    double lastReference;
+    std::string local;
+    std::string carrier;
+    std::vector<Remote*> remotes;
+
+    int printMessage(const int level, const char *format, ...) const;
+
+public:
+    KinectWrapperMultiClient();
+
+    /**
+    * Connect to the servers.
+    * @param options contains the set of options in form of a
+    *                Property object.
+    *
+    * Available options are:
+    *
+    * \b remotes <list>: example (remotes (kinectServer/0 kinectServer/1)),
+    *    specifies the server port stem-names to connect to.
+    *
+    * \b local <string>: example (local kinectMultiClient), specifies
+    *    the client stem-name to be used for opening ports.
+    *
+    * \b carrier <string>: example (carrier udp), specifies the
+    *    protocol used to connect yarp streaming ports.
+    *
+    * \b verbosity <int>: example (verbosity 3), specifies the
+    *    verbosity level of print-outs messages.
+    *
+    * \b history <int>: example (history 5), specifies how many frames
+    *    per stream are kept to look for the best alignment.
+    *
+    * \b tolerance <double>: example (tolerance 0.02), specifies the
+    *    maximum time difference in seconds between aligned frames.
+    *
+    * rgb and skeletons are received whenever the servers stream them.
+    *
+    * @return true/false if successful/failed.
+    */
+    bool open(const yarp::os::Property &options);
+
+    /**
+    * Tell if the client is open.
+    * @return true/false if open/closed.
+    */
+    bool isOpen();
+
+    /**
+    * Disconnect from the servers.
+    */
+    void close();
+
+    /**
+    * Retrieve a new time-aligned set of frames, one per server in the
+    * order given at open().
+    * @param frames the aligned frames; depth is in mm, players hold the
+    *               player index of each pixel.
+    * @return true if a new aligned set is available, false if not all
+    *         the servers have provided frames close enough to each other
+    *         or if the set has been already retrieved.
+    */
+    bool getFrames(std::vector<KinectFrame> &frames);
+
+    virtual ~KinectWrapperMultiClient();
+};
+
+}
+
+#endif
+
@@ -17,6 +17,9 @@
 #ifndef __KINECTWRAPPER_SERVER_H__
 #define __KINECTWRAPPER_SERVER_H__
 
+#include <map>
+#include <set>
+
 #include <opencv2/opencv.hpp>
 
 #include <yarp/os/Semaphore.h>
@@ -24,6 +27,21 @@
 #include <yarp/os/RateThread.h>
 
 #include <kinectWrapper/kinectWrapper.h>
+#include <kinectWrapper/kinectCloud.h>
+#include <kinectWrapper/kinectVoxelGrid.h>
+#include <kinectWrapper/kinectRegistration.h>
+#include <kinectWrapper/kinectUndistortion.h>
+#include <kinectWrapper/kinectExtrinsics.h>
+#include <kinectWrapper/kinectSubscription.h>
+#include <kinectWrapper/kinectSharedMemory.h>
+#include <kinectWrapper/kinectRgbd.h>
+#include <kinectWrapper/kinectFrameStats.h>
+#include <kinectWrapper/kinectClock.h>
+#include <kinectWrapper/kinectLatency.h>
+#include <kinectWrapper/kinectTrace.h>
+#include <kinectWrapper/kinectLog.h>
+#include <kinectWrapper/kinectKernels.h>
+#include <kinectWrapper/kinectDriverSynthetic.h>
 
 #ifdef __USE_SDK__
 #include <kinectWrapper/kinectDriverSDK.h>
@@ -35,11 +53,44 @@
 
 namespace kinectWrapper
 {
+class KinectWrapperServer;
+
+/**
+* @ingroup kinectWrapper
+*
+* Thread publishing the health metrics of a server on stats:o once per
+* second, so that formatting and writing them never delay the
+* acquisition thread.
+*/
+class TelemetryThread : public yarp::os::RateThread
+{
+protected:
+    KinectWrapperServer *server;
+    void run();
+
+public:
+    TelemetryThread(KinectWrapperServer *server);
+};
+
 class KinectWrapperServer : public KinectWrapper,
         public yarp::os::RateThread,
         public yarp::os::PortReader
 {
+    friend class TelemetryThread;
+
 protected:
+    enum Stage
+    {
+        STAGE_UPDATE,
+        STAGE_READ_DEPTH,
+        STAGE_READ_RGB,
+        STAGE_READ_SKELETON,
+        STAGE_PROCESS,
+        STAGE_COPY,
+        STAGE_WRITE,
+        STAGE_COUNT
+    };
+
     unsigned short* buf;
     unsigned short* bufPl;
     float* bufF;
@@ -47,28 +98,87 @@ protected:
     bool opening;
     bool seatedMode;
     bool useSDK;
+    bool publishCloud;
+    bool publishVoxels;
+    bool registerDepth;
+    bool registerRgbd;
+    bool publishRgbd;
+    bool undistortDepth;
+    bool undistortRgb;
+    bool hostClock;
+    bool newD,newI,newS;
+    bool multicast;
+    bool configPending;
     int period;
     int verbosity;
     int img_width;
     int img_height;
     int depth_width;
     int depth_height;
-    yarp::os::Stamp tsD,tsI,tsS;
+    yarp::os::Stamp tsD,tsI,tsS,tsC,tsV,tsR;
     double timestampD,timestampI,timestampS;
+    int idD,idI,idS;
+    FrameStats statsD,statsI,statsS;
+    ClockMapper clockD,clockI,clockS;
+    double stageTime[STAGE_COUNT];
+    LatencyHistogram stageLatency[STAGE_COUNT];
+    LatencyHistogram tickLatency;
+    LatencyHistogram tickJitter;
+    unsigned int ticks;
+    unsigned int deadlineMisses;
+    double lastTick;
+    double publishTime;
+    double acquisitionCpu;
+    int acquisitionThread;
+    std::set<int> rpcThreads;
+    FrameStats sampleD,sampleI,sampleS;
+    LatencyHistogram publishLatency;
+    double telemetryTime;
+    double telemetryCpuAcquisition;
+    double telemetryCpuProcess;
+    std::map<int,double> telemetryCpuThreads;
+    FrameStats telemetryD,telemetryI,telemetryS;
+    TelemetryThread telemetry;
+    double frameTime;
     std::string name;
     std::string info;
+    std::string openInfo;
+    std::string traceFile;
+    yarp::os::Property pendingConfig;
 
     yarp::sig::ImageOf<yarp::sig::PixelMono16> depth;
+    yarp::sig::ImageOf<yarp::sig::PixelMono16> depthRaw;
+    yarp::sig::ImageOf<yarp::sig::PixelMono16> depthUndistorted;
     yarp::sig::ImageOf<yarp::sig::PixelRgb> image;
+    yarp::sig::ImageOf<yarp::sig::PixelRgb> imageRaw;
 
     yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelMono16> > depthPort;
     yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> > imagePort;
     yarp::os::BufferedPort<yarp::os::Bottle> jointsPort;
+    yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgbFloat> > cloudPort;
+    yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgbFloat> > voxelsPort;
+    yarp::os::BufferedPort<RgbdFrame> rgbdPort;
+    yarp::os::BufferedPort<yarp::os::Bottle> infoPort;
+    yarp::os::BufferedPort<yarp::os::Bottle> statsPort;
     yarp::os::Bottle skeleton;
 
+    CloudProjector projector;
+    VoxelGrid voxelGrid;
+    DepthRegistration registration;
+    Undistortion depthUndistortion;
+    Undistortion rgbUndistortion;
+    ExtrinsicTransform extrinsics;
+    std::map<std::string,Subscription*> subscriptions;
+    SharedFrameRing depthRing;
+    SharedFrameRing rgbRing;
+
     yarp::os::Semaphore mutexDepth;
     yarp::os::Semaphore mutexRgb;
     yarp::os::Semaphore mutexSkeleton;
+    yarp::os::Semaphore mutexExtrinsics;
+    yarp::os::Semaphore mutexConfig;
+    yarp::os::Semaphore mutexSubscriptions;
+    yarp::os::Semaphore mutexStats;
 
     yarp::os::Port rpc;
 
@@ -81,21 +191,42 @@ protected:
     IplImage* depthTmp;
     IplImage* depthToShow;
 
-#ifdef __USE_SDK__
-    KinectDriverSDK* driver;
-#endif
-
-#ifdef __USE_OPENNI__
-    KinectDriverOpenNI* driver;
-#endif
+    KinectDriver* driver;
 
     int   printMessage(const int level, const char *format, ...) const;
     bool  read(yarp::os::ConnectionReader &connection);
     void  run();
+    void  updateStageStats(const double tickStart, const double tickEnd);
+    void  writeTelemetry();
+    bool  configureRegistration(const yarp::os::Bottle &group);
+    bool  configureUndistortion(const yarp::os::Bottle &group, Undistortion &undistortion,
+                                const int width, const int height, const bool bilinear);
+    void  allocateBuffers();
+    void  releaseBuffers();
+    bool  setupProjector();
+    void  fillInfo(yarp::os::Bottle &b);
+    void  applyConfiguration();
+    bool  readDepth();
+    bool  readRgb();
+    bool  readSkeleton();
+    ExtrinsicTransform getExtrinsicTransform();
+    void  writeCloud();
+    void  writeVoxels();
+    void  publishDepth(const bool ready);
+    void  publishRgb(const bool ready);
+    void  publishJoints(const bool ready);
+    bool  fillRgbd(RgbdFrame &frame);
+    void  writeRgbd();
+    bool  subscribe(const std::string &id, const yarp::os::Property &options, yarp::os::Bottle &reply);
+    void  unsubscribe(const std::string &id);
+    void  writeSubscriptions();
+    void  openSharedMemory(const int slots);
+    void  writeSharedMemory();
     std::deque<Player> getJoints();
     Player getJoints(int playerId);
     Player managePlayerRequest(int playerId);
     void drawLimb(Skeleton &jointsMap, const std::string &point1, const std::string &point2);
+    bool threadInit();
     void threadRelease();
 
 public:
@@ -109,6 +240,9 @@ public:
     bool getDepthAndPlayers(yarp::sig::ImageOf<yarp::sig::PixelFloat> &depthIm, yarp::sig::Matrix &players, double *timestamp=NULL);
     bool getPlayers(yarp::sig::Matrix &players, double *timestamp=NULL);
     bool getRgb(yarp::sig::ImageOf<yarp::sig::PixelRgb> &rgbIm, double *timestamp=NULL);
+    bool getRgbd(yarp::sig::ImageOf<yarp::sig::PixelMono16> &depthIm, yarp::sig::ImageOf<yarp::sig::PixelRgb> &rgbIm,
+                 double *timestampDepth=NULL, double *timestampRgb=NULL);
+    bool getCloud(yarp::sig::ImageOf<yarp::sig::PixelRgbFloat> &cloud, double *timestamp=NULL);
     bool getJoints(std::deque<Player> &joints, double *timestamp=NULL);
     bool getJoints(Player &joints, int player, double *timestamp=NULL);
     void getPlayersImage(const yarp::sig::Matrix &players, yarp::sig::ImageOf<yarp::sig::PixelBgr> &image);
@@ -117,6 +251,13 @@ public:
     void getDepthImage(const yarp::sig::ImageOf<yarp::sig::PixelMono16> &depth, yarp::sig::ImageOf<yarp::sig::PixelFloat> &depthToDisplay);
     bool getInfo(yarp::os::Property &opt);
     bool get3DPoint(int u, int v, yarp::sig::Vector &point3D);
+    bool get3DPoints(const std::vector<std::pair<int,int> > &pixels, std::vector<yarp::sig::Vector> &points3D);
+    bool setExtrinsics(const yarp::sig::Matrix &H);
+    bool getExtrinsics(yarp::sig::Matrix &H);
+    bool getFrameStats(yarp::os::Property &stats);
+    void getStageStats(yarp::os::Bottle &stats);
+    void clearStageStats();
+    bool reconfigure(const yarp::os::Property &options);
     bool getFocalLength(double &focallength);
     virtual ~KinectWrapperServer();
 };
@@ -0,0 +1,110 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <cstddef>
+#include <kinectWrapper/kinectBands.h>
+
+using namespace std;
+using namespace yarp::os;
+using namespace kinectWrapper;
+
+/************************************************************************/
+BandPool::Worker::Worker() : go(0), done(0)
+{
+    job=NULL;
+    band=rowBegin=rowEnd=0;
+}
+
+/************************************************************************/
+void BandPool::Worker::run()
+{
+    while (true)
+    {
+        go.wait();
+        if (isStopping())
+            break;
+
+        job->process(band,rowBegin,rowEnd);
+        done.post();
+    }
+}
+
+/************************************************************************/
+void BandPool::Worker::onStop()
+{
+    go.post();
+}
+
+/************************************************************************/
+BandPool::BandPool()
+{
+}
+
+/************************************************************************/
+BandPool::~BandPool()
+{
+    close();
+}
+
+/************************************************************************/
+void BandPool::open(int nBands)
+{
+    close();
+    for (int i=1; i<nBands; i++)
+    {
+        Worker *worker=new Worker;
+        worker->start();
+        workers.push_back(worker);
+    }
+}
+
+/************************************************************************/
+void BandPool::close()
+{
+    for (size_t i=0; i<workers.size(); i++)
+    {
+        workers[i]->stop();
+        delete workers[i];
+    }
+    workers.clear();
+}
+
+/************************************************************************/
+int BandPool::getBands() const
+{
+    return (int)workers.size()+1;
+}
+
+/************************************************************************/
+void BandPool::process(BandJob &job, int height)
+{
+    int nBands=getBands();
+    int rows=height/nBands;
+
+    for (size_t i=0; i<workers.size(); i++)
+    {
+        workers[i]->job=&job;
+        workers[i]->band=(int)i+1;
+        workers[i]->rowBegin=(int)(i+1)*rows;
+        workers[i]->rowEnd=(i+1==workers.size())?height:(int)(i+2)*rows;
+        workers[i]->go.post();
+    }
+
+    job.process(0,0,(nBands>1)?rows:height);
+
+    for (size_t i=0; i<workers.size(); i++)
+        workers[i]->done.wait();
+}
@@ -0,0 +1,288 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <tlhelp32.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <dirent.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#endif
+
+#include <kinectWrapper/kinectClock.h>
+
+#define CLOCK_WINDOW        128     // samples of the offset envelope
+#define CLOCK_FORGET        0.999   // forgetting factor of the drift fit
+#define CLOCK_MIN_SPAN      2.0     // [s] before the drift is estimated
+#define CLOCK_MAX_DRIFT     1e-3
+#define CLOCK_MAX_JUMP      0.5     // [s] of disagreement between clocks
+
+using namespace std;
+using namespace kinectWrapper;
+
+/************************************************************************/
+double kinectWrapper::monotonicTime()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency,counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart/(double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (double)ts.tv_sec+1e-9*(double)ts.tv_nsec;
+#endif
+}
+
+#ifdef _WIN32
+namespace
+{
+
+/************************************************************************/
+double fromFileTimes(const FILETIME &kernel, const FILETIME &user)
+{
+    //FILETIME counts 100 [ns]
+    ULARGE_INTEGER k,u;
+    k.LowPart=kernel.dwLowDateTime;
+    k.HighPart=kernel.dwHighDateTime;
+    u.LowPart=user.dwLowDateTime;
+    u.HighPart=user.dwHighDateTime;
+    return 1e-7*(double)(k.QuadPart+u.QuadPart);
+}
+
+} //end unnamed namespace
+#endif
+
+/************************************************************************/
+double kinectWrapper::threadCpuTime()
+{
+#ifdef _WIN32
+    FILETIME creation,exit,kernel,user;
+    if (!GetThreadTimes(GetCurrentThread(),&creation,&exit,&kernel,&user))
+        return 0.0;
+    return fromFileTimes(kernel,user);
+#else
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts)!=0)
+        return 0.0;
+    return (double)ts.tv_sec+1e-9*(double)ts.tv_nsec;
+#endif
+}
+
+/************************************************************************/
+double kinectWrapper::processCpuTime()
+{
+#ifdef _WIN32
+    FILETIME creation,exit,kernel,user;
+    if (!GetProcessTimes(GetCurrentProcess(),&creation,&exit,&kernel,&user))
+        return 0.0;
+    return fromFileTimes(kernel,user);
+#else
+    struct timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&ts)!=0)
+        return 0.0;
+    return (double)ts.tv_sec+1e-9*(double)ts.tv_nsec;
+#endif
+}
+
+/************************************************************************/
+int kinectWrapper::currentThreadId()
+{
+#if defined(_WIN32)
+    return (int)GetCurrentThreadId();
+#elif defined(__linux__)
+    return (int)syscall(SYS_gettid);
+#else
+    return 0;
+#endif
+}
+
+/************************************************************************/
+bool kinectWrapper::threadsCpuTime(vector<ThreadCpuTime> &threads)
+{
+    threads.clear();
+#if defined(_WIN32)
+    HANDLE snapshot=CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD,0);
+    if (snapshot==INVALID_HANDLE_VALUE)
+        return false;
+
+    THREADENTRY32 entry;
+    entry.dwSize=sizeof(entry);
+    DWORD pid=GetCurrentProcessId();
+    for (BOOL ok=Thread32First(snapshot,&entry); ok; ok=Thread32Next(snapshot,&entry))
+    {
+        if (entry.th32OwnerProcessID!=pid)
+            continue;
+
+        HANDLE thread=OpenThread(THREAD_QUERY_INFORMATION,FALSE,entry.th32ThreadID);
+        if (thread==NULL)
+            continue;
+
+        FILETIME creation,exit,kernel,user;
+        if (GetThreadTimes(thread,&creation,&exit,&kernel,&user))
+        {
+            ThreadCpuTime t;
+            t.id=(int)entry.th32ThreadID;
+            t.name="thread";
+            t.time=fromFileTimes(kernel,user);
+            threads.push_back(t);
+        }
+        CloseHandle(thread);
+    }
+    CloseHandle(snapshot);
+    return true;
+#elif defined(__linux__)
+    DIR *dir=opendir("/proc/self/task");
+    if (dir==NULL)
+        return false;
+
+    double tick=1.0/(double)sysconf(_SC_CLK_TCK);
+    while (struct dirent *task=readdir(dir))
+    {
+        if (task->d_name[0]=='.')
+            continue;
+
+        char path[64];
+        snprintf(path,sizeof(path),"/proc/self/task/%s/stat",task->d_name);
+        FILE *f=fopen(path,"r");
+        if (f==NULL)
+            continue;   // the thread has just exited
+
+        char line[512];
+        bool ok=(fgets(line,sizeof(line),f)!=NULL);
+        fclose(f);
+
+        //the name is enclosed in parentheses and may contain spaces
+        char *begin=ok?strchr(line,'('):NULL;
+        char *end=ok?strrchr(line,')'):NULL;
+        if ((begin==NULL) || (end==NULL) || (end<begin))
+            continue;
+
+        //utime and stime are the 12th and 13th fields after the name
+        unsigned long utime,stime;
+        if (sscanf(end+1," %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                   &utime,&stime)!=2)
+            continue;
+
+        ThreadCpuTime t;
+        t.id=atoi(task->d_name);
+        t.name.assign(begin+1,end);
+        t.time=tick*(double)(utime+stime);
+        threads.push_back(t);
+    }
+    closedir(dir);
+    return true;
+#else
+    return false;
+#endif
+}
+
+/************************************************************************/
+ClockMapper::ClockMapper()
+{
+    reset();
+}
+
+/************************************************************************/
+void ClockMapper::reset()
+{
+    valid=false;
+    refDevice=refHost=0.0;
+    sw=sx=sy=sxx=sxy=0.0;
+    slope=1.0;
+    offset=0.0;
+    window.clear();
+}
+
+/************************************************************************/
+double ClockMapper::map(const double deviceTime, const double hostTime)
+{
+    if (valid)
+    {
+        const Sample &last=window.back();
+        double dDevice=deviceTime-last.device;
+        double dHost=hostTime-last.host;
+        if ((dDevice<0.0) || (fabs(dDevice-dHost)>CLOCK_MAX_JUMP))
+            reset();
+    }
+
+    if (!valid)
+    {
+        refDevice=deviceTime;
+        refHost=hostTime;
+        valid=true;
+    }
+
+    double x=deviceTime-refDevice;
+    double y=hostTime-refHost;
+
+    sw=CLOCK_FORGET*sw+1.0;
+    sx=CLOCK_FORGET*sx+x;
+    sy=CLOCK_FORGET*sy+y;
+    sxx=CLOCK_FORGET*sxx+x*x;
+    sxy=CLOCK_FORGET*sxy+x*y;
+
+    Sample sample;
+    sample.device=deviceTime;
+    sample.host=hostTime;
+    window.push_back(sample);
+    if (window.size()>CLOCK_WINDOW)
+        window.pop_front();
+
+    //the drift needs some span of device time to be observable
+    double den=sw*sxx-sx*sx;
+    if ((x>CLOCK_MIN_SPAN) && (den>0.0))
+    {
+        slope=(sw*sxy-sx*sy)/den;
+        if (fabs(slope-1.0)>CLOCK_MAX_DRIFT)
+            slope=(slope>1.0)?1.0+CLOCK_MAX_DRIFT:1.0-CLOCK_MAX_DRIFT;
+    }
+
+    //the sample that arrived with the least delay gives the offset
+    offset=window.front().host-refHost-slope*(window.front().device-refDevice);
+    for (size_t i=1; i<window.size(); i++)
+    {
+        double r=window[i].host-refHost-slope*(window[i].device-refDevice);
+        if (r<offset)
+            offset=r;
+    }
+
+    return refHost+offset+slope*x;
+}
+
+/************************************************************************/
+double ClockMapper::getOffset() const
+{
+    return (refHost+offset)-slope*refDevice;
+}
+
+/************************************************************************/
+double ClockMapper::getDrift() const
+{
+    return slope-1.0;
+}
+
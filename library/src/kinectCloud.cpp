@@ -0,0 +1,155 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <limits>
+#include <kinectWrapper/kinectCloud.h>
+
+using namespace std;
+using namespace yarp::sig;
+using namespace kinectWrapper;
+
+/************************************************************************/
+CloudProjector::CloudProjector()
+{
+    width=0;
+    height=0;
+}
+
+/************************************************************************/
+void CloudProjector::setup(int width, int height, double xzFactor, double yzFactor)
+{
+    this->width=width;
+    this->height=height;
+    raysX.resize(width*height);
+    raysY.resize(width*height);
+    z.resize(width*height);
+
+    for (int v=0; v<height; v++)
+    {
+        for (int u=0; u<width; u++)
+        {
+            raysX[v*width+u]=(float)((1.0*u/width-0.5)*xzFactor);
+            raysY[v*width+u]=(float)((0.5-1.0*v/height)*yzFactor);
+        }
+    }
+}
+
+/************************************************************************/
+void CloudProjector::setupPinhole(int width, int height, const double *intrinsics)
+{
+    this->width=width;
+    this->height=height;
+    raysX.resize(width*height);
+    raysY.resize(width*height);
+    z.resize(width*height);
+
+    for (int v=0; v<height; v++)
+    {
+        for (int u=0; u<width; u++)
+        {
+            raysX[v*width+u]=(float)((u-intrinsics[2])/intrinsics[0]);
+            raysY[v*width+u]=(float)((intrinsics[3]-v)/intrinsics[1]);
+        }
+    }
+}
+
+/************************************************************************/
+bool CloudProjector::isReady() const
+{
+    return (width>0) && (height>0);
+}
+
+/************************************************************************/
+int CloudProjector::getWidth() const
+{
+    return width;
+}
+
+/************************************************************************/
+int CloudProjector::getHeight() const
+{
+    return height;
+}
+
+/************************************************************************/
+void CloudProjector::projectRow(const unsigned short *depth, float *cloud, int row)
+{
+    const float nan=numeric_limits<float>::quiet_NaN();
+    const float *rx=&raysX[row*width];
+    const float *ry=&raysY[row*width];
+    float *pz=&z[row*width];
+
+    //the first 13 bits contain the depth value in mm, we want meters;
+    //kept apart from the loop below so that it gets vectorized
+    for (int i=0; i<width; i++)
+        pz[i]=0.001f*(float)(depth[i]>>3);
+
+    for (int i=0; i<width; i++)
+    {
+        float zi=pz[i];
+        float *p=cloud+3*i;
+        if (zi>0.0f)
+        {
+            p[0]=rx[i]*zi;
+            p[1]=ry[i]*zi;
+            p[2]=zi;
+        }
+        else
+            p[0]=p[1]=p[2]=nan;
+    }
+}
+
+/************************************************************************/
+void CloudProjector::project(const unsigned short *depth, float *cloud, int rowBegin, int rowEnd)
+{
+    for (int v=rowBegin; v<rowEnd; v++)
+        projectRow(depth+v*width,cloud+3*v*width,v);
+}
+
+/************************************************************************/
+bool CloudProjector::project(const ImageOf<PixelMono16> &depth, ImageOf<PixelRgbFloat> &cloud)
+{
+    if ((depth.width()!=width) || (depth.height()!=height))
+        return false;
+
+    cloud.resize(width,height);
+    for (int v=0; v<height; v++)
+        projectRow((const unsigned short*)depth.getRow(v),(float*)cloud.getRow(v),v);
+
+    return true;
+}
+
+/************************************************************************/
+bool CloudProjector::projectPixel(const ImageOf<PixelMono16> &depth, const int u, const int v,
+                                  double *xyz) const
+{
+    if ((depth.width()!=width) || (depth.height()!=height) ||
+        (u<0) || (u>=width) || (v<0) || (v>=height))
+        return false;
+
+    //same arithmetic of projectRow, so that the point matches the cloud
+    float zi=0.001f*(float)(((const unsigned short*)depth.getRow(v))[u]>>3);
+    if (zi>0.0f)
+    {
+        xyz[0]=raysX[v*width+u]*zi;
+        xyz[1]=raysY[v*width+u]*zi;
+        xyz[2]=zi;
+    }
+    else
+        xyz[0]=xyz[1]=xyz[2]=0.0;
+
+    return true;
+}
@@ -14,6 +14,7 @@
  * Public License for more details
  */
 
+#include <cmath>
 #include <kinectWrapper/kinectDriverOpenNI.h>
 
 using namespace std;
@@ -28,7 +29,7 @@ namespace
 
 void XN_CALLBACK_TYPE User_NewUser(xn::UserGenerator& userGenerator,XnUserID nId,void* pCookie)
 {
-    fprintf(stdout, "New user, asking for calibration\n");
+    Logger::print("New user, asking for calibration\n");
     KinectDriverOpenNI* ki = static_cast<KinectDriverOpenNI*>(pCookie);
 
     if (ki->getRequireCalibrationPose())
@@ -48,7 +49,7 @@ void XN_CALLBACK_TYPE User_LostUser(xn::UserGenerator& userGenerator,XnUserID nI
 
 void XN_CALLBACK_TYPE UserPose_PoseDetected(xn::PoseDetectionCapability& capability,const XnChar* strPose,XnUserID nId,void* pCookie)
 {
-    fprintf(stdout, "Pose detected\n");
+    Logger::print("Pose detected\n");
     capability.StopPoseDetection(nId);
     UserGenerator* userGenerator=(UserGenerator*)pCookie;
     userGenerator->GetSkeletonCap().RequestCalibration(nId, true);
@@ -56,14 +57,14 @@ void XN_CALLBACK_TYPE UserPose_PoseDetected(xn::PoseDetectionCapability& capabil
 
 void XN_CALLBACK_TYPE UserCalibration_CalibrationStart(xn::SkeletonCapability& capability,XnUserID nId,void* pCookie)
 {
-    fprintf(stdout, "Calibration starting\n");
+    Logger::print("Calibration starting\n");
 }
 
 void XN_CALLBACK_TYPE UserCalibration_CalibrationComplete(xn::SkeletonCapability& capability,XnUserID nId,XnCalibrationStatus eStatus,void* pCookie)
 {
     if (eStatus == XN_CALIBRATION_STATUS_OK)
     {
-        fprintf(stdout, "Calibration complete, start tracking\n");
+        Logger::print("Calibration complete, start tracking\n");
         capability.StartTracking(nId);
     }
     else
@@ -92,11 +93,13 @@ bool KinectDriverOpenNI::initialize(Property &opt)
     this->depth_width=opt.check("depth_width",Value(320)).asInt();
     this->depth_height=opt.check("depth_height",Value(240)).asInt();
     this->requireRemapping=opt.check("remap");
+    this->depthRegistered=false;
 
-    cout << "Resolution RGB: " << img_width << "x" << img_height << endl;
-    cout << "Resolution Depth: " << depth_width << "x" << depth_height << endl;
+    Logger::print("Resolution RGB: %dx%d\n",img_width,img_height);
+    Logger::print("Resolution Depth: %dx%d\n",depth_width,depth_height);
 
-    if (opt.find("device").asString()=="kinect") {
+    this->kinectSensor=(opt.find("device").asString()=="kinect");
+    if (kinectSensor) {
         this->depth_width_sensor = 640;
         this->depth_height_sensor = 480;
         this->img_width_sensor = 640;
@@ -120,7 +123,11 @@ bool KinectDriverOpenNI::initialize(Property &opt)
 
     context.SetGlobalMirror(true);
 
-    nRetVal = depthGenerator.Create(context);
+    Query query;
+    if (!selectDevice(opt,query))
+        return false;
+
+    nRetVal = depthGenerator.Create(context,&query);
     if (!testRetVal(nRetVal, "Depth generator"))
         return false;
 
@@ -134,7 +141,7 @@ bool KinectDriverOpenNI::initialize(Property &opt)
 
     if (info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_RGB || info==KINECT_TAGS_DEPTH_RGB_PLAYERS)
     {
-        nRetVal = imageGenerator.Create(context);
+        nRetVal = imageGenerator.Create(context,&query);
         if (!testRetVal(nRetVal, "Image generator"))
             return false;
 
@@ -147,18 +154,18 @@ bool KinectDriverOpenNI::initialize(Property &opt)
             return false;
 
         if (requireRemapping && depthGenerator.IsCapabilitySupported(XN_CAPABILITY_ALTERNATIVE_VIEW_POINT))
-            depthGenerator.GetAlternativeViewPointCap().SetViewPoint(imageGenerator);
+            depthRegistered=(depthGenerator.GetAlternativeViewPointCap().SetViewPoint(imageGenerator)==XN_STATUS_OK);
     }
 
     if (info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_JOINTS || info==KINECT_TAGS_DEPTH_PLAYERS || info==KINECT_TAGS_DEPTH_RGB_PLAYERS)
     {
-        nRetVal = userGenerator.Create(context);
+        nRetVal = userGenerator.Create(context,&query);
         if (!testRetVal(nRetVal, "User generator"))
             return false;
 
         if ((info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_JOINTS) && !userGenerator.IsCapabilitySupported(XN_CAPABILITY_SKELETON))
         {
-            fprintf(stdout, "Skeleton not supported\n");
+            Logger::print("Skeleton not supported\n");
             return false;
         }
 
@@ -183,7 +190,7 @@ bool KinectDriverOpenNI::initialize(Property &opt)
             this->requireCalibrationPose=true;
             if (!userGenerator.IsCapabilitySupported(XN_CAPABILITY_POSE_DETECTION))
             {
-                fprintf(stdout, "Pose required but not supported\n");
+                Logger::print("Pose required but not supported\n");
                 return false;
             }
             nRetVal=userGenerator.GetPoseDetectionCap().RegisterToPoseDetected(UserPose_PoseDetected, NULL, hPoseDetected);
@@ -208,35 +215,68 @@ bool KinectDriverOpenNI::initialize(Property &opt)
 }
 
 /************************************************************************/
-bool KinectDriverOpenNI::readDepth(ImageOf<PixelMono16> &depth, double &timestamp)
+bool KinectDriverOpenNI::selectDevice(Property &opt, Query &query)
 {
-    const XnDepthPixel* pDepthMap = depthGenerator.GetDepthMap();
-    int ts=(int)depthGenerator.GetTimestamp();
-    timestamp=(double)ts/1000.0;
+    NodeInfoList devices;
+    XnStatus nRetVal = context.EnumerateProductionTrees(XN_NODE_TYPE_DEVICE,NULL,devices);
+    if (!testRetVal(nRetVal, "Devices enumeration"))
+        return false;
 
-    SceneMetaData smd;
-    userGenerator.GetUserPixels(0,smd);
+    //the device is chosen by serial if given, by index otherwise
+    string serial=opt.check("device_serial",Value("")).asString().c_str();
+    int index=opt.check("device_index",Value(0)).asInt();
 
-    for (int y=0; y<this->depth_height_sensor; y++)
+    int i=0;
+    for (NodeInfoList::Iterator it=devices.Begin(); it!=devices.End(); ++it, i++)
     {
-        for(int x=0;x<this->depth_width_sensor;x++)
+        if (serial.empty() && (i!=index))
+            continue;
+
+        NodeInfo deviceInfo=*it;
+        nRetVal = context.CreateProductionTree(deviceInfo,device);
+        if (!testRetVal(nRetVal, "Device creation"))
+            return false;
+
+        if (!serial.empty())
         {
-            int player=(smd[y * this->depth_width_sensor + x]);
-            int depth=(pDepthMap[y * this->depth_width_sensor + x]);
-            int finalValue=0;
-            finalValue|=((depth<<3)&0XFFF8);
-            finalValue|=(player&0X0007);
-            //if (x==320 && y==240)
-            //   fprintf(stdout, "%d %d\n", ((finalValue&0XFFF8)>>3), finalValue&0X0007);
-            //We associate the depth to the first 13 bits, using the last 3 for the player identification
-            depthMat->data.s[y * this->depth_width_sensor + x ]=finalValue;
+            //not all the devices expose the serial, the usb path is fine too
+            XnChar deviceSerial[64]="";
+            if (device.IsCapabilitySupported(XN_CAPABILITY_DEVICE_IDENTIFICATION))
+                device.GetIdentificationCap().GetSerialNumber(deviceSerial,sizeof(deviceSerial));
+            if ((serial!=deviceSerial) && (serial!=deviceInfo.GetCreationInfo()))
+            {
+                device.Release();
+                continue;
+            }
         }
+
+        Logger::print("Device: %s\n",deviceInfo.GetCreationInfo());
+        query.AddNeededNode(deviceInfo.GetInstanceName());
+        return true;
     }
 
+    Logger::print("Device not found\n");
+    return false;
+}
+
+/************************************************************************/
+bool KinectDriverOpenNI::readDepth(ImageOf<PixelMono16> &depth, double &timestamp)
+{
+    const XnDepthPixel* pDepthMap = depthGenerator.GetDepthMap();
+    //the device clock counts microseconds on 64 bits
+    timestamp=1e-6*(double)depthGenerator.GetTimestamp();
+
+    SceneMetaData smd;
+    userGenerator.GetUserPixels(0,smd);
+
+    //We associate the depth to the first 13 bits, using the last 3 for the player identification
+    packDepthPlayers(pDepthMap,&smd[0],(unsigned short*)depthMat->data.s,
+                     this->depth_width_sensor*this->depth_height_sensor);
+
     if(depth_width == 320 && depth_width_sensor == 640)
     {
         cvGetImage(depthMat,depthTmp);
-        resizeImage(depthTmp,depthImage);
+        decimateDepth(depthTmp,depthImage);
     } else {
         cvGetImage(depthMat,depthImage);
     }
@@ -252,8 +292,7 @@ bool KinectDriverOpenNI::readRgb(ImageOf<PixelRgb> &rgb, double &timestamp)
     XnRGB24Pixel* ucpImage = const_cast<XnRGB24Pixel*> (pImage);
     cvSetData(rgb_big,ucpImage,this->img_width_sensor*3);
     cvResize(rgb_big,(IplImage*)rgb.getIplImage());
-    int ts=(int)imageGenerator.GetTimestamp();
-    timestamp=(double)ts/1000.0;
+    timestamp=1e-6*(double)imageGenerator.GetTimestamp();
     return true;
 }
 
@@ -261,8 +300,7 @@ bool KinectDriverOpenNI::readRgb(ImageOf<PixelRgb> &rgb, double &timestamp)
 bool KinectDriverOpenNI::readSkeleton(Bottle *skeleton, double &timestamp)
 {
     skeleton->clear();
-    int ts=(int)userGenerator.GetTimestamp();
-    timestamp=(double)ts/1000.0;
+    timestamp=1e-6*(double)userGenerator.GetTimestamp();
     bool isTracking=false;
     if((info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_JOINTS))
     {
@@ -279,6 +317,7 @@ bool KinectDriverOpenNI::readSkeleton(Bottle *skeleton, double &timestamp)
                 double comx=0.0;
                 double comy=0.0;
                 double comz=0.0;
+                double comc=0.0;
                 Bottle &player=bones.addList();
                 player.addInt(aUsers[i]);
                 XnUInt16 nJoints = KINECT_TAGS_N_JOINTS;
@@ -300,6 +339,7 @@ bool KinectDriverOpenNI::readSkeleton(Bottle *skeleton, double &timestamp)
                         comx+=joint.position.X/1000;
                         comy+=joint.position.Y/1000;
                         comz+=joint.position.Z/1000;
+                        comc+=joint.fConfidence;
                         depthGenerator.ConvertRealWorldToProjective(1,&joint.position,&p);
                         //kinect with openni does not support 320x240 depth resolution, but we
                         //need to send 320x240 depth images to avoid bandwidth problems, so
@@ -318,6 +358,7 @@ bool KinectDriverOpenNI::readSkeleton(Bottle *skeleton, double &timestamp)
                         limb.addDouble(joint.position.X/1000);
                         limb.addDouble(joint.position.Y/1000);
                         limb.addDouble(joint.position.Z/1000);
+                        limb.addDouble(joint.fConfidence);
                     }
                     else
                         activeJoints-=1;
@@ -326,6 +367,7 @@ bool KinectDriverOpenNI::readSkeleton(Bottle *skeleton, double &timestamp)
                 comx/=activeJoints;
                 comy/=activeJoints;
                 comz/=activeJoints;
+                comc/=activeJoints;
                 com.X=comx;
                 com.Y=comy;
                 com.Z=comz;
@@ -341,6 +383,7 @@ bool KinectDriverOpenNI::readSkeleton(Bottle *skeleton, double &timestamp)
                 limb.addDouble(comx);
                 limb.addDouble(comy);
                 limb.addDouble(comz);
+                limb.addDouble(comc);
             }
         }
         if(isTracking)
@@ -378,7 +421,7 @@ bool KinectDriverOpenNI::testRetVal(XnStatus nRetVal, string message)
 {
     if (nRetVal!=XN_STATUS_OK)
     {
-        fprintf(stdout, "%s failed\n", message.c_str());
+        Logger::print("%s failed\n", message.c_str());
         return false;
     }
     return true;
@@ -502,21 +545,113 @@ bool KinectDriverOpenNI::get3DPoint(int u, int v, yarp::sig::Vector &point3D)
 }
 
 /************************************************************************/
-void KinectDriverOpenNI::resizeImage(IplImage* depthTmp, IplImage* depthImage)
+bool KinectDriverOpenNI::get3DPoints(const vector<pair<int,int> > &pixels, vector<Vector> &points3D)
 {
-    for (int i=0; i<depthTmp->height; i++)
+    const XnDepthPixel* pDepthMap = depthGenerator.GetDepthMap();
+    int scale=1;
+    //requests arrive with respect to the 320x240 image, as for get3DPoint
+    if(depth_width == 320 && depth_width_sensor == 640)
+        scale=2;
+
+    //all the points are projected at once from the same depth map
+    vector<XnPoint3D> p2D(pixels.size());
+    vector<XnPoint3D> p3D(pixels.size());
+    for (size_t i=0; i<pixels.size(); i++)
     {
-        if (i%2==0)
-            continue;
-        for (int j=0; j<depthTmp->width; j++)
+        int newU=pixels[i].first*scale;
+        int newV=pixels[i].second*scale;
+        p2D[i].X = newU;
+        p2D[i].Y = newV;
+        if (newU>=0 && newU<this->depth_width_sensor && newV>=0 && newV<this->depth_height_sensor)
+            p2D[i].Z = pDepthMap[newV*this->depth_width_sensor+newU];
+        else
+            p2D[i].Z = 0;
+    }
+
+    if (!p2D.empty())
+        depthGenerator.ConvertProjectiveToRealWorld((XnUInt32)p2D.size(), &p2D[0], &p3D[0]);
+
+    //We provide the 3D points in meters
+    points3D.resize(pixels.size());
+    for (size_t i=0; i<p3D.size(); i++)
+    {
+        points3D[i].resize(3,0.0);
+        points3D[i][0]=p3D[i].X/1000;
+        points3D[i][1]=p3D[i].Y/1000;
+        points3D[i][2]=p3D[i].Z/1000;
+    }
+
+    return true;
+}
+
+/************************************************************************/
+bool KinectDriverOpenNI::setResolution(int img_width, int img_height, int depth_width, int depth_height)
+{
+    if ((img_width<=0) || (img_height<=0))
+        return false;
+
+    if ((depth_width!=this->depth_width) || (depth_height!=this->depth_height))
+    {
+        if (kinectSensor)
         {
-            if (j%2==0)
-                continue;
-            cvSet2D(depthImage,i/2,j/2,cvGet2D(depthTmp,i,j));
+            //the kinect always streams VGA depth, which can only be halved
+            if (!((depth_width==640 && depth_height==480) || (depth_width==320 && depth_height==240)))
+                return false;
+        }
+        else
+        {
+            XnMapOutputMode mapMode;
+            mapMode.nXRes = depth_width;
+            mapMode.nYRes = depth_height;
+            mapMode.nFPS = 30;
+            if (!testRetVal(depthGenerator.SetMapOutputMode(mapMode), "Depth Output Setting"))
+                return false;
+
+            this->depth_width_sensor = depth_width;
+            this->depth_height_sensor = depth_height;
+            cvReleaseImage(&depthTmp);
+            cvReleaseMat(&depthMat);
+            depthTmp=cvCreateImage(cvSize(depth_width_sensor,depth_height_sensor),IPL_DEPTH_16U,1);
+            depthMat = cvCreateMat(depth_height_sensor,depth_width_sensor,CV_16UC1);
         }
+
+        this->depth_width=depth_width;
+        this->depth_height=depth_height;
+        cvReleaseImage(&depthImage);
+        depthImage=cvCreateImage(cvSize(depth_width,depth_height),IPL_DEPTH_16U,1);
     }
+
+    //rgb images are resized from the sensor resolution, which stays untouched
+    this->img_width=img_width;
+    this->img_height=img_height;
+
+    Logger::print("Resolution RGB: %dx%d\n",img_width,img_height);
+    Logger::print("Resolution Depth: %dx%d\n",depth_width,depth_height);
+
+    return true;
+}
+
+/************************************************************************/
+bool KinectDriverOpenNI::isDepthRegistered()
+{
+    return depthRegistered;
 }
 
+/************************************************************************/
+bool KinectDriverOpenNI::getProjectionFactors(double &xzFactor, double &yzFactor)
+{
+    XnFieldOfView fov;
+    if (depthGenerator.GetFieldOfView(fov)!=XN_STATUS_OK)
+        return false;
+
+    //same factors used by ConvertProjectiveToRealWorld
+    xzFactor=2.0*tan(fov.fHFOV/2.0);
+    yzFactor=2.0*tan(fov.fVFOV/2.0);
+
+    return true;
+}
+
+/************************************************************************/
 bool KinectDriverOpenNI::getFocalLength(double &focallength)
 {
     XnUInt64 zeroPlanDistance;
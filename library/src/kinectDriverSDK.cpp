@@ -48,18 +48,34 @@ bool KinectDriverSDK::initialize(Property &opt)
 
     HRESULT hr;
 
+    //the device is chosen by serial if given, by index otherwise
+    if (opt.check("device_serial"))
+    {
+        string serial=opt.find("device_serial").asString().c_str();
+        wstring id(serial.begin(),serial.end());
+        hr=NuiCreateSensorById(id.c_str(),&sensor);
+    }
+    else
+        hr=NuiCreateSensorByIndex(opt.check("device_index",Value(0)).asInt(),&sensor);
+
+    if (FAILED(hr))
+    {
+        Logger::print("Device not found\n");
+        return false;
+    }
+
     if (info==KINECT_TAGS_ALL_INFO)
-        hr= NuiInitialize(NUI_INITIALIZE_FLAG_USES_SKELETON| NUI_INITIALIZE_FLAG_USES_DEPTH_AND_PLAYER_INDEX |NUI_INITIALIZE_FLAG_USES_COLOR);
+        hr= sensor->NuiInitialize(NUI_INITIALIZE_FLAG_USES_SKELETON| NUI_INITIALIZE_FLAG_USES_DEPTH_AND_PLAYER_INDEX |NUI_INITIALIZE_FLAG_USES_COLOR);
     else if (info==KINECT_TAGS_DEPTH_JOINTS)
-        hr= NuiInitialize( NUI_INITIALIZE_FLAG_USES_SKELETON| NUI_INITIALIZE_FLAG_USES_DEPTH_AND_PLAYER_INDEX);
+        hr= sensor->NuiInitialize( NUI_INITIALIZE_FLAG_USES_SKELETON| NUI_INITIALIZE_FLAG_USES_DEPTH_AND_PLAYER_INDEX);
     else if (info==KINECT_TAGS_DEPTH_RGB || info==KINECT_TAGS_DEPTH_RGB_PLAYERS)
-        hr= NuiInitialize(NUI_INITIALIZE_FLAG_USES_DEPTH_AND_PLAYER_INDEX |NUI_INITIALIZE_FLAG_USES_COLOR);
+        hr= sensor->NuiInitialize(NUI_INITIALIZE_FLAG_USES_DEPTH_AND_PLAYER_INDEX |NUI_INITIALIZE_FLAG_USES_COLOR);
     else
-        hr= NuiInitialize(NUI_INITIALIZE_FLAG_USES_DEPTH_AND_PLAYER_INDEX);
+        hr= sensor->NuiInitialize(NUI_INITIALIZE_FLAG_USES_DEPTH_AND_PLAYER_INDEX);
 
     if( hr != S_OK )
     {
-         fprintf(stdout,"NuiInitialize failed\n");
+         Logger::print("NuiInitialize failed\n");
          return false;
     }
 
@@ -68,11 +84,11 @@ bool KinectDriverSDK::initialize(Property &opt)
 
     if (info==KINECT_TAGS_DEPTH_RGB || info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_RGB_PLAYERS)
     {
-        hr = NuiImageStreamOpen(NUI_IMAGE_TYPE_COLOR,NUI_IMAGE_RESOLUTION_640x480, 0, 2, h1, &h2);
+        hr = sensor->NuiImageStreamOpen(NUI_IMAGE_TYPE_COLOR,NUI_IMAGE_RESOLUTION_640x480, 0, 2, h1, &h2);
 
         if( FAILED( hr ) )
         {
-            fprintf(stdout,"Could not open image stream video\n");
+            Logger::print("Could not open image stream video\n");
             return false;
         }
     }
@@ -80,19 +96,19 @@ bool KinectDriverSDK::initialize(Property &opt)
     h3 = CreateEvent( NULL, TRUE, FALSE, NULL );
     h4 = NULL;
 
-    hr = NuiImageStreamOpen(NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX, NUI_IMAGE_RESOLUTION_320x240, 0, 2, h3, &h4);
+    hr = sensor->NuiImageStreamOpen(NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX, NUI_IMAGE_RESOLUTION_320x240, 0, 2, h3, &h4);
 
-    if(NuiImageStreamSetImageFrameFlags(h4, NUI_IMAGE_STREAM_FLAG_ENABLE_NEAR_MODE )!=S_OK)
-        fprintf(stdout,"NO NEAR MODE\n");
+    if(sensor->NuiImageStreamSetImageFrameFlags(h4, NUI_IMAGE_STREAM_FLAG_ENABLE_NEAR_MODE )!=S_OK)
+        Logger::print("NO NEAR MODE\n");
 
     if( FAILED( hr ) )
     {
-       fprintf(stdout,"Could not open depth stream video\n");
+       Logger::print("Could not open depth stream video\n");
         return false;
     }
 
     if(seatedMode && (info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_JOINTS))
-        NuiSkeletonTrackingEnable(h3,NUI_SKELETON_TRACKING_FLAG_ENABLE_SEATED_SUPPORT);
+        sensor->NuiSkeletonTrackingEnable(h3,NUI_SKELETON_TRACKING_FLAG_ENABLE_SEATED_SUPPORT);
 
     return true;
 }
@@ -105,7 +121,12 @@ bool KinectDriverSDK::close()
 
     cvDestroyAllWindows();
 
-    NuiShutdown();
+    if (sensor!=NULL)
+    {
+        sensor->NuiShutdown();
+        sensor->Release();
+        sensor=NULL;
+    }
 
     delete[] buf;
 
@@ -147,24 +168,23 @@ int KinectDriverSDK::setDepthImg(HANDLE h,IplImage* depth, const NUI_IMAGE_FRAME
 }
 
 /************************************************************************/
-const NUI_IMAGE_FRAME * KinectDriverSDK::retrieveImg(HANDLE h)
+bool KinectDriverSDK::retrieveImg(HANDLE h, NUI_IMAGE_FRAME &imageFrame)
 {
-    const NUI_IMAGE_FRAME * pImageFrame = NULL;
-    HRESULT hr = NuiImageStreamGetNextFrame( h, 0, &pImageFrame );
-
-    if( FAILED( hr ) )
-        return NULL;
-    else
-        return pImageFrame;
+    HRESULT hr = sensor->NuiImageStreamGetNextFrame( h, 0, &imageFrame );
+    return !FAILED( hr );
 }
 
 /************************************************************************/
 bool KinectDriverSDK::readRgb(ImageOf<PixelRgb> &rgb, double &timestamp)
 {
     rgb.resize(img_width,img_height);
-    const NUI_IMAGE_FRAME *colIm;
+    NUI_IMAGE_FRAME colorFrame;
+    NUI_IMAGE_FRAME *colIm=&colorFrame;
     if (info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_RGB || info==KINECT_TAGS_DEPTH_RGB_PLAYERS)
-        colIm=retrieveImg(h2);
+    {
+        if (!retrieveImg(h2,colorFrame))
+            colIm=NULL;
+    }
     else
         return false;
 
@@ -179,9 +199,10 @@ bool KinectDriverSDK::readRgb(ImageOf<PixelRgb> &rgb, double &timestamp)
         cvSplit(color,r,g,b,foo);
         cvMerge(b,g,r,NULL,rgb_big);
         cvResize(rgb_big,(IplImage*)rgb.getIplImage());
-        NuiImageStreamReleaseFrame(h2, colIm);
+        sensor->NuiImageStreamReleaseFrame(h2, colIm);
         initC=true;
-        timestamp=(double)(colIm->liTimeStamp).QuadPart;
+        //the device clock counts milliseconds
+        timestamp=1e-3*(double)(colIm->liTimeStamp).QuadPart;
         cvReleaseImage(&rgb_big);
         cvReleaseImage(&foo);
         cvReleaseImage(&r);
@@ -195,14 +216,15 @@ bool KinectDriverSDK::readRgb(ImageOf<PixelRgb> &rgb, double &timestamp)
 /************************************************************************/
 bool KinectDriverSDK::readDepth(ImageOf<PixelMono16> &depth, double &timestamp)
 {
-    const NUI_IMAGE_FRAME *depthIm=retrieveImg(h4);
-    if(depthIm!=NULL)
+    NUI_IMAGE_FRAME depthFrame;
+    NUI_IMAGE_FRAME *depthIm=&depthFrame;
+    if(retrieveImg(h4,depthFrame))
     {
         setDepthImg(h4,depthTmp,depthIm);
         depth.wrapIplImage(depthTmp);
-        NuiImageStreamReleaseFrame(h4, depthIm);
+        sensor->NuiImageStreamReleaseFrame(h4, depthIm);
         initD=true;
-        timestamp=(double)(depthIm->liTimeStamp).QuadPart;
+        timestamp=1e-3*(double)(depthIm->liTimeStamp).QuadPart;
         return true;
     }
     return false;
@@ -215,7 +237,9 @@ bool KinectDriverSDK::readSkeleton(Bottle *skeleton, double &timestamp)
     if(initC && initD && (info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_JOINTS))
     {
         NUI_SKELETON_FRAME SkeletonFrame;
-        HRESULT hr = NuiSkeletonGetNextFrame( 0, &SkeletonFrame );
+        HRESULT hr = sensor->NuiSkeletonGetNextFrame( 0, &SkeletonFrame );
+        if (SUCCEEDED(hr))
+            timestamp=1e-3*(double)SkeletonFrame.liTimeStamp.QuadPart;
 
         Bottle bones;
         bones.clear();
@@ -229,9 +253,10 @@ bool KinectDriverSDK::readSkeleton(Bottle *skeleton, double &timestamp)
                 double comx=0.0;
                 double comy=0.0;
                 double comz=0.0;
+                double comc=0.0;
                 Bottle &player=bones.addList();
                 player.addInt(i+1);
-                NuiTransformSmooth(&SkeletonFrame,NULL);
+                sensor->NuiTransformSmooth(&SkeletonFrame,NULL);
                 for (int j = 0; j < NUI_SKELETON_POSITION_COUNT; j++)
                 {
                     if (isJointProvided(j))
@@ -246,6 +271,14 @@ bool KinectDriverSDK::readSkeleton(Bottle *skeleton, double &timestamp)
                         joint.addDouble(SkeletonFrame.SkeletonData[i].SkeletonPositions[j].x);
                         joint.addDouble(SkeletonFrame.SkeletonData[i].SkeletonPositions[j].y);
                         joint.addDouble(SkeletonFrame.SkeletonData[i].SkeletonPositions[j].z);
+                        //inferred joints are less reliable than tracked ones
+                        double confidence=0.0;
+                        if (SkeletonFrame.SkeletonData[i].eSkeletonPositionTrackingState[j]==NUI_SKELETON_POSITION_TRACKED)
+                            confidence=1.0;
+                        else if (SkeletonFrame.SkeletonData[i].eSkeletonPositionTrackingState[j]==NUI_SKELETON_POSITION_INFERRED)
+                            confidence=0.5;
+                        joint.addDouble(confidence);
+                        comc+=confidence;
                         comx+=SkeletonFrame.SkeletonData[i].SkeletonPositions[j].x;
                         comy+=SkeletonFrame.SkeletonData[i].SkeletonPositions[j].y;
                         comz+=SkeletonFrame.SkeletonData[i].SkeletonPositions[j].z;
@@ -254,6 +287,7 @@ bool KinectDriverSDK::readSkeleton(Bottle *skeleton, double &timestamp)
                 comx/=nJointsUsed;
                 comy/=nJointsUsed;
                 comz/=nJointsUsed;
+                comc/=nJointsUsed;
                 Vector4 pos;
                 pos.x=comx;
                 pos.y=comy;
@@ -269,6 +303,7 @@ bool KinectDriverSDK::readSkeleton(Bottle *skeleton, double &timestamp)
                 limb.addDouble((double)comx);
                 limb.addDouble((double)comy);
                 limb.addDouble((double)comz);
+                limb.addDouble(comc);
             }
         }
         *skeleton=bones;
@@ -435,15 +470,70 @@ bool KinectDriverSDK::get3DPoint(int u, int v, yarp::sig::Vector &point3D)
     return true;
 }
 
+/************************************************************************/
+bool KinectDriverSDK::get3DPoints(const vector<pair<int,int> > &pixels, vector<Vector> &points3D)
+{
+    points3D.resize(pixels.size());
+    for (size_t i=0; i<pixels.size(); i++)
+    {
+        int u=pixels[i].first;
+        int v=pixels[i].second;
+        USHORT depthValue=0;
+        if (u>=0 && u<KINECT_TAGS_DEPTH_WIDTH && v>=0 && v<KINECT_TAGS_DEPTH_HEIGHT)
+            depthValue=buf[v*KINECT_TAGS_DEPTH_WIDTH+u];
+        Vector4 point = NuiTransformDepthImageToSkeleton(u,v,depthValue,NUI_IMAGE_RESOLUTION_320x240);
+        points3D[i].resize(3,0.0);
+        points3D[i][0]=point.x;
+        points3D[i][1]=point.y;
+        points3D[i][2]=point.z;
+    }
+
+    return true;
+}
+
 /************************************************************************/
 void KinectDriverSDK::update()
 {
     //sdk updates one data stream per time
 }
 
+/************************************************************************/
+bool KinectDriverSDK::isDepthRegistered()
+{
+    return false;
+}
+
+/************************************************************************/
+bool KinectDriverSDK::getProjectionFactors(double &xzFactor, double &yzFactor)
+{
+    //same factors used by NuiTransformDepthImageToSkeleton
+    xzFactor=KINECT_TAGS_DEPTH_WIDTH*NUI_CAMERA_DEPTH_NOMINAL_INVERSE_FOCAL_LENGTH_IN_PIXELS;
+    yzFactor=KINECT_TAGS_DEPTH_HEIGHT*NUI_CAMERA_DEPTH_NOMINAL_INVERSE_FOCAL_LENGTH_IN_PIXELS;
+
+    return true;
+}
+
+/************************************************************************/
 bool KinectDriverSDK::getFocalLength(double &focallength)
 {
     focallength = NUI_CAMERA_DEPTH_NOMINAL_FOCAL_LENGTH_IN_PIXELS;
 
     return true;
 }
+
+/************************************************************************/
+bool KinectDriverSDK::setResolution(int img_width, int img_height, int depth_width, int depth_height)
+{
+    //the depth stream is opened at a fixed resolution
+    if ((depth_width!=KINECT_TAGS_DEPTH_WIDTH) || (depth_height!=KINECT_TAGS_DEPTH_HEIGHT))
+        return false;
+
+    if ((img_width<=0) || (img_height<=0))
+        return false;
+
+    //rgb images are resized from the default resolution in readRgb
+    this->img_width=img_width;
+    this->img_height=img_height;
+
+    return true;
+}
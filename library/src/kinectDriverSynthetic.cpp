@@ -0,0 +1,322 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <cmath>
+#include <kinectWrapper/kinectDriverSynthetic.h>
+#include <kinectWrapper/kinectClock.h>
+
+using namespace std;
+using namespace yarp::os;
+using namespace yarp::sig;
+using namespace kinectWrapper;
+
+namespace
+{
+
+//field of view of the Kinect depth camera (57x43 degrees)
+const double xzFactor=1.0862;
+const double yzFactor=0.7878;
+
+//the arms sway at 0.5 Hz
+const double swayFrequency=0.5;
+
+struct JointTemplate
+{
+    const char *name;
+    double x,y;
+};
+
+//joint positions in meters w.r.t. the hip center, y pointing upwards
+const JointTemplate joints[]=
+{
+    {KINECT_TAGS_BODYPART_HEAD,        0.00, 0.75},
+    {KINECT_TAGS_BODYPART_SHOULDER_C,  0.00, 0.55},
+    {KINECT_TAGS_BODYPART_SHOULDER_L, -0.18, 0.52},
+    {KINECT_TAGS_BODYPART_SHOULDER_R,  0.18, 0.52},
+    {KINECT_TAGS_BODYPART_ELBOW_L,    -0.25, 0.27},
+    {KINECT_TAGS_BODYPART_ELBOW_R,     0.25, 0.27},
+    {KINECT_TAGS_BODYPART_WRIST_L,    -0.28, 0.05},
+    {KINECT_TAGS_BODYPART_WRIST_R,     0.28, 0.05},
+    {KINECT_TAGS_BODYPART_HAND_L,     -0.29,-0.03},
+    {KINECT_TAGS_BODYPART_HAND_R,      0.29,-0.03},
+    {KINECT_TAGS_BODYPART_SPINE,       0.00, 0.25},
+    {KINECT_TAGS_BODYPART_HIP_C,       0.00, 0.00},
+    {KINECT_TAGS_BODYPART_HIP_L,      -0.10,-0.02},
+    {KINECT_TAGS_BODYPART_HIP_R,       0.10,-0.02},
+    {KINECT_TAGS_BODYPART_KNEE_L,     -0.11,-0.45},
+    {KINECT_TAGS_BODYPART_KNEE_R,      0.11,-0.45},
+    {KINECT_TAGS_BODYPART_ANKLE_L,    -0.11,-0.85},
+    {KINECT_TAGS_BODYPART_ANKLE_R,     0.11,-0.85},
+    {KINECT_TAGS_BODYPART_FOOT_L,     -0.11,-0.92},
+    {KINECT_TAGS_BODYPART_FOOT_R,      0.11,-0.92}
+};
+
+const int nJoints=sizeof(joints)/sizeof(joints[0]);
+
+/************************************************************************/
+unsigned short playerDepth(const int player)
+{
+    return (unsigned short)(1500+300*player);
+}
+
+} //end unnamed namespace
+
+/************************************************************************/
+KinectDriverSynthetic::KinectDriverSynthetic()
+{
+    players=2;
+    frame=0;
+    frameTime=0.0;
+}
+
+/************************************************************************/
+bool KinectDriverSynthetic::initialize(Property &opt)
+{
+    this->info=opt.check("info",Value(KINECT_TAGS_ALL_INFO)).asString().c_str();
+    this->img_width=opt.check("img_width",Value(320)).asInt();
+    this->img_height=opt.check("img_height",Value(240)).asInt();
+    this->depth_width=opt.check("depth_width",Value(320)).asInt();
+    this->depth_height=opt.check("depth_height",Value(240)).asInt();
+    this->players=opt.check("synthetic_players",Value(2)).asInt();
+    if ((players<0) || (players>KINECT_TAGS_MAX_USERS))
+    {
+        Logger::print("synthetic_players must be in [0,%d]\n",KINECT_TAGS_MAX_USERS);
+        return false;
+    }
+
+    if ((img_width<=0) || (img_height<=0) || (depth_width<=0) || (depth_height<=0))
+        return false;
+
+    Logger::print("Synthetic frames with %d players\n",players);
+    Logger::print("Resolution RGB: %dx%d\n",img_width,img_height);
+    Logger::print("Resolution Depth: %dx%d\n",depth_width,depth_height);
+
+    buildFloor();
+    update();
+    return true;
+}
+
+/************************************************************************/
+void KinectDriverSynthetic::buildFloor()
+{
+    //the floor goes from 4 m at the top of the image to 1 m at the bottom
+    floorDepth.resize(depth_height);
+    for (int v=0; v<depth_height; v++)
+        floorDepth[v]=(unsigned short)(4000-(3000*v)/depth_height);
+}
+
+/************************************************************************/
+int KinectDriverSynthetic::playerColumn(const int player) const
+{
+    //players walk to the right by 1% of the image per frame
+    int width=depth_width/10+1;
+    int range=depth_width-width;
+    if (range<=0)
+        return 0;
+    return (int)((player*depth_width/(players+1)+(frame*depth_width)/100)%range);
+}
+
+/************************************************************************/
+unsigned short KinectDriverSynthetic::depthAt(const int u, const int v) const
+{
+    if ((u<0) || (u>=depth_width) || (v<0) || (v>=depth_height))
+        return 0;
+
+    //the players closest to the camera occlude the others
+    unsigned short nearest=floorDepth[v];
+    if ((v>=depth_height/4) && (v<9*depth_height/10))
+    {
+        int width=depth_width/10+1;
+        for (int p=players-1; p>=0; p--)
+        {
+            int col=playerColumn(p);
+            if ((u>=col) && (u<col+width))
+                nearest=playerDepth(p);
+        }
+    }
+    return nearest;
+}
+
+/************************************************************************/
+void KinectDriverSynthetic::update()
+{
+    frame++;
+    frameTime=monotonicTime();
+}
+
+/************************************************************************/
+bool KinectDriverSynthetic::readDepth(ImageOf<PixelMono16> &depth, double &timestamp)
+{
+    timestamp=frameTime;
+    depth.resize(depth_width,depth_height);
+
+    int width=depth_width/10+1;
+    for (int v=0; v<depth_height; v++)
+    {
+        unsigned short *row=(unsigned short*)depth.getRow(v);
+        unsigned short floor=(unsigned short)((floorDepth[v]<<3)&0xFFF8);
+        for (int u=0; u<depth_width; u++)
+            row[u]=floor;
+
+        if ((v>=depth_height/4) && (v<9*depth_height/10))
+        {
+            //farther players first, so that the closest ones occlude them
+            for (int p=players-1; p>=0; p--)
+            {
+                unsigned short value=(unsigned short)(((playerDepth(p)<<3)&0xFFF8)|((p%7)+1));
+                int col=playerColumn(p);
+                for (int u=col; (u<col+width) && (u<depth_width); u++)
+                    row[u]=value;
+            }
+        }
+    }
+    return true;
+}
+
+/************************************************************************/
+bool KinectDriverSynthetic::readRgb(ImageOf<PixelRgb> &rgb, double &timestamp)
+{
+    timestamp=frameTime;
+    rgb.resize(img_width,img_height);
+    for (int v=0; v<img_height; v++)
+    {
+        PixelRgb *row=(PixelRgb*)rgb.getRow(v);
+        for (int u=0; u<img_width; u++)
+        {
+            row[u].r=(unsigned char)(u+frame);
+            row[u].g=(unsigned char)v;
+            row[u].b=128;
+        }
+    }
+    return true;
+}
+
+/************************************************************************/
+bool KinectDriverSynthetic::readSkeleton(Bottle *skeleton, double &timestamp)
+{
+    skeleton->clear();
+    timestamp=frameTime;
+    if ((info!=KINECT_TAGS_ALL_INFO) && (info!=KINECT_TAGS_DEPTH_JOINTS))
+        return false;
+
+    int width=depth_width/10+1;
+    double sway=0.1*sin(2.0*3.14159265358979*swayFrequency*frameTime);
+    for (int p=0; p<players; p++)
+    {
+        //the hip center stands in the middle of the player silhouette
+        double z=0.001*playerDepth(p);
+        double uc=playerColumn(p)+0.5*width;
+        double xc=(uc/depth_width-0.5)*z*xzFactor;
+        double comx=0.0,comy=0.0;
+
+        Bottle &player=skeleton->addList();
+        player.addInt(p+1);
+        for (int j=0; j<nJoints; j++)
+        {
+            double x=xc+joints[j].x;
+            double y=joints[j].y+((fabs(joints[j].x)>0.2)?sway:0.0);
+            comx+=x;
+            comy+=y;
+
+            Bottle &joint=player.addList();
+            joint.addString(joints[j].name);
+            Bottle &limb=joint.addList();
+            limb.addInt((int)((x/(z*xzFactor)+0.5)*depth_width));
+            limb.addInt((int)((0.5-y/(z*yzFactor))*depth_height));
+            limb.addDouble(x);
+            limb.addDouble(y);
+            limb.addDouble(z);
+            limb.addDouble(1.0);
+        }
+
+        comx/=nJoints;
+        comy/=nJoints;
+        Bottle &joint=player.addList();
+        joint.addString(KINECT_TAGS_BODYPART_COM);
+        Bottle &limb=joint.addList();
+        limb.addInt((int)((comx/(z*xzFactor)+0.5)*depth_width));
+        limb.addInt((int)((0.5-comy/(z*yzFactor))*depth_height));
+        limb.addDouble(comx);
+        limb.addDouble(comy);
+        limb.addDouble(z);
+        limb.addDouble(1.0);
+    }
+    return true;
+}
+
+/************************************************************************/
+bool KinectDriverSynthetic::get3DPoint(int u, int v, Vector &point3D)
+{
+    double z=0.001*depthAt(u,v);
+    point3D.resize(3,0.0);
+    point3D[0]=((double)u/depth_width-0.5)*z*xzFactor;
+    point3D[1]=(0.5-(double)v/depth_height)*z*yzFactor;
+    point3D[2]=z;
+    return true;
+}
+
+/************************************************************************/
+bool KinectDriverSynthetic::get3DPoints(const vector<pair<int,int> > &pixels, vector<Vector> &points3D)
+{
+    points3D.resize(pixels.size());
+    for (size_t i=0; i<pixels.size(); i++)
+        get3DPoint(pixels[i].first,pixels[i].second,points3D[i]);
+    return true;
+}
+
+/************************************************************************/
+bool KinectDriverSynthetic::getProjectionFactors(double &xzFactor, double &yzFactor)
+{
+    xzFactor=::xzFactor;
+    yzFactor=::yzFactor;
+    return true;
+}
+
+/************************************************************************/
+bool KinectDriverSynthetic::isDepthRegistered()
+{
+    return true;
+}
+
+/************************************************************************/
+bool KinectDriverSynthetic::getFocalLength(double &focallength)
+{
+    //in pixels of the depth image
+    focallength=depth_width/xzFactor;
+    return true;
+}
+
+/************************************************************************/
+bool KinectDriverSynthetic::setResolution(int img_width, int img_height, int depth_width, int depth_height)
+{
+    if ((img_width<=0) || (img_height<=0) || (depth_width<=0) || (depth_height<=0))
+        return false;
+
+    this->img_width=img_width;
+    this->img_height=img_height;
+    this->depth_width=depth_width;
+    this->depth_height=depth_height;
+    buildFloor();
+    return true;
+}
+
+/************************************************************************/
+bool KinectDriverSynthetic::close()
+{
+    floorDepth.clear();
+    return true;
+}
+
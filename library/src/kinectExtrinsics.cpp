@@ -0,0 +1,165 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+
+#include <cmath>
+#include <vector>
+#include <kinectWrapper/kinectExtrinsics.h>
+
+using namespace std;
+using namespace yarp::os;
+using namespace yarp::sig;
+using namespace kinectWrapper;
+
+/************************************************************************/
+ExtrinsicTransform::ExtrinsicTransform()
+{
+    double eye[16]={1.0, 0.0, 0.0, 0.0,
+                    0.0, 1.0, 0.0, 0.0,
+                    0.0, 0.0, 1.0, 0.0,
+                    0.0, 0.0, 0.0, 1.0};
+    set(eye);
+}
+
+/************************************************************************/
+bool ExtrinsicTransform::set(const double *H)
+{
+    if ((fabs(H[12])>1e-9) || (fabs(H[13])>1e-9) || (fabs(H[14])>1e-9) ||
+        (fabs(H[15]-1.0)>1e-9))
+        return false;
+
+    identity=true;
+    for (int i=0; i<16; i++)
+    {
+        this->H[i]=H[i];
+        if (i<12)
+            R[i]=(float)H[i];
+        if (H[i]!=((i%5==0)?1.0:0.0))
+            identity=false;
+    }
+
+    return true;
+}
+
+/************************************************************************/
+void ExtrinsicTransform::get(double *H) const
+{
+    for (int i=0; i<16; i++)
+        H[i]=this->H[i];
+}
+
+/************************************************************************/
+bool ExtrinsicTransform::isIdentity() const
+{
+    return identity;
+}
+
+/************************************************************************/
+void ExtrinsicTransform::apply(float *xyz, const int n) const
+{
+    if (identity)
+        return;
+
+    //local copies let the compiler keep the coefficients in registers
+    const float r00=R[0], r01=R[1], r02=R[2],  tx=R[3];
+    const float r10=R[4], r11=R[5], r12=R[6],  ty=R[7];
+    const float r20=R[8], r21=R[9], r22=R[10], tz=R[11];
+    for (int i=0; i<n; i++, xyz+=3)
+    {
+        float x=xyz[0], y=xyz[1], z=xyz[2];
+        xyz[0]=r00*x+r01*y+r02*z+tx;
+        xyz[1]=r10*x+r11*y+r12*z+ty;
+        xyz[2]=r20*x+r21*y+r22*z+tz;
+    }
+}
+
+/************************************************************************/
+void ExtrinsicTransform::apply(double *xyz, const int n) const
+{
+    if (identity)
+        return;
+
+    for (int i=0; i<n; i++, xyz+=3)
+    {
+        double x=xyz[0], y=xyz[1], z=xyz[2];
+        xyz[0]=H[0]*x+H[1]*y+H[2]*z+H[3];
+        xyz[1]=H[4]*x+H[5]*y+H[6]*z+H[7];
+        xyz[2]=H[8]*x+H[9]*y+H[10]*z+H[11];
+    }
+}
+
+/************************************************************************/
+void ExtrinsicTransform::apply(ImageOf<PixelRgbFloat> &cloud) const
+{
+    if (identity)
+        return;
+
+    for (int v=0; v<cloud.height(); v++)
+        apply((float*)cloud.getRow(v),cloud.width());
+}
+
+/************************************************************************/
+void ExtrinsicTransform::apply(Bottle &skeleton) const
+{
+    if (identity)
+        return;
+
+    //gather all the positions, transform them at once and rebuild
+    vector<double> xyz;
+    for (int i=0; i<skeleton.size(); i++)
+    {
+        Bottle *player=skeleton.get(i).asList();
+        for (int j=1; j<player->size(); j++)
+        {
+            Bottle *position=player->get(j).asList()->get(1).asList();
+            xyz.push_back(position->get(2).asDouble());
+            xyz.push_back(position->get(3).asDouble());
+            xyz.push_back(position->get(4).asDouble());
+        }
+    }
+
+    if (xyz.empty())
+        return;
+
+    apply(&xyz[0],(int)xyz.size()/3);
+
+    Bottle transformed;
+    const double *p=&xyz[0];
+    for (int i=0; i<skeleton.size(); i++)
+    {
+        Bottle *player=skeleton.get(i).asList();
+        Bottle &playerOut=transformed.addList();
+        playerOut.addInt(player->get(0).asInt());
+        for (int j=1; j<player->size(); j++, p+=3)
+        {
+            Bottle *joint=player->get(j).asList();
+            Bottle *position=joint->get(1).asList();
+            Bottle &jointOut=playerOut.addList();
+            jointOut.addString(joint->get(0).asString());
+            Bottle &positionOut=jointOut.addList();
+            positionOut.addInt(position->get(0).asInt());
+            positionOut.addInt(position->get(1).asInt());
+            positionOut.addDouble(p[0]);
+            positionOut.addDouble(p[1]);
+            positionOut.addDouble(p[2]);
+            //keep any further field untouched
+            for (int k=5; k<position->size(); k++)
+                positionOut.add(position->get(k));
+        }
+    }
+
+    skeleton=transformed;
+}
@@ -0,0 +1,103 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <kinectWrapper/kinectFrameStats.h>
+
+using namespace yarp::os;
+using namespace kinectWrapper;
+
+namespace
+{
+
+/************************************************************************/
+void addPair(Bottle &b, const char *key, const unsigned int value)
+{
+    Bottle &pair=b.addList();
+    pair.addString(key);
+    pair.addInt((int)value);
+}
+
+} //end unnamed namespace
+
+/************************************************************************/
+FrameStats::FrameStats()
+{
+    clear();
+}
+
+/************************************************************************/
+void FrameStats::clear()
+{
+    lastId=-1;
+    acquired=published=unpublished=unread=0;
+    bytes=0.0;
+    received=skipped=duplicated=withheld=0;
+}
+
+/************************************************************************/
+int FrameStats::acquire()
+{
+    return lastId=(int)(acquired++);
+}
+
+/************************************************************************/
+void FrameStats::receive(const int id)
+{
+    received++;
+    if (lastId>=0)
+    {
+        if (id==lastId)
+            duplicated++;
+        else if (id>lastId)
+            skipped+=id-lastId-1;
+    }
+    //lower ids come from a restarted server, which numbers from scratch
+    lastId=id;
+}
+
+/************************************************************************/
+void FrameStats::reject()
+{
+    if (received>0)
+    {
+        received--;
+        skipped++;
+    }
+}
+
+/************************************************************************/
+void FrameStats::serverToBottle(Bottle &b) const
+{
+    addPair(b,"acquired",acquired);
+    addPair(b,"published",published);
+    addPair(b,"unpublished",unpublished);
+    addPair(b,"unread",unread);
+    Bottle &pair=b.addList();
+    pair.addString("bytes");
+    pair.addDouble(bytes);
+}
+
+/************************************************************************/
+void FrameStats::clientToBottle(Bottle &b) const
+{
+    //withheld frames are accounted by the server once the next frame is
+    //sent, possibly before the client has received it
+    addPair(b,"received",received);
+    addPair(b,"skipped",(skipped>withheld)?skipped-withheld:0);
+    addPair(b,"duplicated",duplicated);
+    addPair(b,"withheld",withheld);
+}
+
@@ -0,0 +1,61 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <kinectWrapper/kinectKernels.h>
+
+/************************************************************************/
+void kinectWrapper::packDepthPlayers(const unsigned short *depth, const unsigned short *labels,
+                                     unsigned short *packed, const int n)
+{
+    for (int i=0; i<n; i++)
+        packed[i]=(unsigned short)(((depth[i]<<3)&0xFFF8)|(labels[i]&0x0007));
+}
+
+/************************************************************************/
+void kinectWrapper::unpackDepth(const unsigned short *packed, unsigned short *depth, const int n)
+{
+    for (int i=0; i<n; i++)
+        depth[i]=(packed[i]&0xFFF8)>>3;
+}
+
+/************************************************************************/
+void kinectWrapper::unpackDepthScaled(const unsigned short *packed, float *depth, const int n)
+{
+    // a single precision division gives the same values as the former
+    // double precision code, unlike the multiplication by the reciprocal
+    for (int i=0; i<n; i++)
+        depth[i]=(packed[i]&0xFFF8)/(float)0xFFF8;
+}
+
+/************************************************************************/
+void kinectWrapper::unpackPlayers(const unsigned short *packed, double *players, const int n)
+{
+    for (int i=0; i<n; i++)
+        players[i]=packed[i]&0x0007;
+}
+
+/************************************************************************/
+void kinectWrapper::decimateDepth(const IplImage *src, IplImage *dst)
+{
+    for (int v=0; v<dst->height; v++)
+    {
+        const unsigned short *in=(const unsigned short*)(src->imageData+(2*v+1)*src->widthStep);
+        unsigned short *out=(unsigned short*)(dst->imageData+v*dst->widthStep);
+        for (int u=0; u<dst->width; u++)
+            out[u]=in[2*u+1];
+    }
+}
+
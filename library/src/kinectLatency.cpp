@@ -0,0 +1,144 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include <kinectWrapper/kinectLatency.h>
+
+using namespace yarp::os;
+using namespace kinectWrapper;
+
+namespace
+{
+
+/************************************************************************/
+void addPair(Bottle &b, const char *key, const double value)
+{
+    Bottle &pair=b.addList();
+    pair.addString(key);
+    pair.addDouble(value);
+}
+
+} //end unnamed namespace
+
+/************************************************************************/
+LatencyHistogram::LatencyHistogram()
+{
+    clear();
+}
+
+/************************************************************************/
+int LatencyHistogram::getBucket(const double us)
+{
+    //the first magnitude is linear from 0 to 16 [us]
+    if (us<LATENCY_SUB_BUCKETS)
+        return (us>0.0)?(int)us:0;
+
+    int exponent;
+    double mantissa=frexp(us,&exponent);   // us=mantissa*2^exponent, mantissa in [0.5,1)
+    int magnitude=exponent-4;               // 16 [us] has exponent 5
+    if (magnitude>=LATENCY_MAGNITUDES)
+        return LATENCY_MAGNITUDES*LATENCY_SUB_BUCKETS-1;
+
+    int sub=(int)((2.0*mantissa-1.0)*LATENCY_SUB_BUCKETS);
+    return magnitude*LATENCY_SUB_BUCKETS+sub;
+}
+
+/************************************************************************/
+double LatencyHistogram::getBucketValue(const int bucket)
+{
+    int magnitude=bucket/LATENCY_SUB_BUCKETS;
+    int sub=bucket%LATENCY_SUB_BUCKETS;
+    if (magnitude==0)
+        return sub+0.5;
+
+    //the middle of the bucket
+    double base=ldexp(1.0,magnitude+3);
+    return base*(1.0+(sub+0.5)/LATENCY_SUB_BUCKETS);
+}
+
+/************************************************************************/
+void LatencyHistogram::clear()
+{
+    memset(counts,0,sizeof(counts));
+    count=0;
+    sum=max=0.0;
+}
+
+/************************************************************************/
+void LatencyHistogram::add(const double seconds)
+{
+    double s=(seconds>0.0)?seconds:0.0;
+    counts[getBucket(1e6*s)]++;
+    count++;
+    sum+=s;
+    if (s>max)
+        max=s;
+}
+
+/************************************************************************/
+unsigned int LatencyHistogram::getCount() const
+{
+    return count;
+}
+
+/************************************************************************/
+double LatencyHistogram::getMean() const
+{
+    return (count>0)?sum/count:0.0;
+}
+
+/************************************************************************/
+double LatencyHistogram::getMax() const
+{
+    return max;
+}
+
+/************************************************************************/
+double LatencyHistogram::getPercentile(const double p) const
+{
+    if (count==0)
+        return 0.0;
+
+    double target=0.01*p*count;
+    unsigned int cumulated=0;
+    for (int i=0; i<LATENCY_MAGNITUDES*LATENCY_SUB_BUCKETS; i++)
+    {
+        cumulated+=counts[i];
+        if ((cumulated>0) && (cumulated>=target))
+        {
+            double value=1e-6*getBucketValue(i);
+            return (value<max)?value:max;
+        }
+    }
+
+    return max;
+}
+
+/************************************************************************/
+void LatencyHistogram::toBottle(Bottle &b) const
+{
+    Bottle &pair=b.addList();
+    pair.addString("count");
+    pair.addInt((int)count);
+    addPair(b,"mean",1e3*getMean());
+    addPair(b,"p50",1e3*getPercentile(50.0));
+    addPair(b,"p90",1e3*getPercentile(90.0));
+    addPair(b,"p99",1e3*getPercentile(99.0));
+    addPair(b,"max",1e3*getMax());
+}
+
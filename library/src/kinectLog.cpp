@@ -0,0 +1,307 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <yarp/os/RateThread.h>
+#include <yarp/os/Semaphore.h>
+
+#include <kinectWrapper/kinectClock.h>
+#include <kinectWrapper/kinectLog.h>
+
+#define LOG_RING_SIZE       128     // messages per thread, a power of two
+#define LOG_MESSAGE_SIZE    256
+#define LOG_SITES           64      // rate limited sites per thread, a power of two
+#define LOG_SITE_RATE       10      // messages per second per site
+#define LOG_FLUSH_PERIOD    20      // [ms]
+
+#ifdef _WIN32
+    #define LOG_THREAD_LOCAL    __declspec(thread)
+    #define LOG_BARRIER()       MemoryBarrier()
+#else
+    #define LOG_THREAD_LOCAL    __thread
+    #define LOG_BARRIER()       __sync_synchronize()
+#endif
+
+using namespace std;
+using namespace yarp::os;
+using namespace kinectWrapper;
+
+namespace
+{
+
+struct Message
+{
+    double time;
+    char text[LOG_MESSAGE_SIZE];
+};
+
+struct Site
+{
+    const char *format;
+    double windowStart;
+    int count;
+    int suppressed;
+};
+
+struct Ring
+{
+    volatile unsigned int head;     // written by the owner thread only
+    volatile unsigned int tail;     // written by the flusher only
+    unsigned int dropped;           // written by the owner thread only
+    unsigned int reported;          // written by the flusher only
+    Message messages[LOG_RING_SIZE];
+    Site sites[LOG_SITES];          // accessed by the owner thread only
+};
+
+/************************************************************************/
+bool olderThan(const Message *a, const Message *b)
+{
+    return (a->time<b->time);
+}
+
+/************************************************************************/
+class Flusher : public RateThread
+{
+protected:
+    vector<Ring*> rings;                // guarded by mutex
+    vector<Ring*> snapshot;             // this and below guarded by drainMutex
+    vector<unsigned int> heads;
+    vector<const Message*> pending;
+    Semaphore mutex;
+    Semaphore drainMutex;
+    Semaphore threadMutex;
+    volatile bool active;               // written under threadMutex
+
+    /********************************************************************/
+    void run()
+    {
+        drain();
+    }
+
+public:
+    /********************************************************************/
+    Flusher() : RateThread(LOG_FLUSH_PERIOD), mutex(1), drainMutex(1), threadMutex(1)
+    {
+        active=false;
+        pending.reserve(16*LOG_RING_SIZE);
+    }
+
+    /********************************************************************/
+    void add(Ring *ring)
+    {
+        mutex.wait();
+        rings.push_back(ring);
+        mutex.post();
+    }
+
+    /********************************************************************/
+    void wake()
+    {
+        //the lock is taken only when the thread is not running
+        if (!active)
+        {
+            threadMutex.wait();
+            if (!active)
+                active=start();
+            threadMutex.post();
+        }
+    }
+
+    /********************************************************************/
+    void shutdown()
+    {
+        threadMutex.wait();
+        if (active)
+        {
+            stop();
+            active=false;
+        }
+        threadMutex.post();
+        drain();
+    }
+
+    /********************************************************************/
+    void drain()
+    {
+        //the list of rings is only copied under the lock taken by new
+        //threads, so that they never wait for the console
+        drainMutex.wait();
+        mutex.wait();
+        snapshot=rings;
+        mutex.post();
+
+        heads.resize(snapshot.size());
+        pending.clear();
+        for (size_t i=0; i<snapshot.size(); i++)
+        {
+            Ring *ring=snapshot[i];
+            heads[i]=ring->head;
+            LOG_BARRIER();
+            for (unsigned int j=ring->tail; j!=heads[i]; j++)
+                pending.push_back(&ring->messages[j&(LOG_RING_SIZE-1)]);
+
+            unsigned int dropped=ring->dropped;
+            if (dropped!=ring->reported)
+            {
+                fprintf(stdout,"*** %u messages dropped\n",dropped-ring->reported);
+                ring->reported=dropped;
+            }
+        }
+
+        //messages of different threads are written in the order they were issued
+        stable_sort(pending.begin(),pending.end(),olderThan);
+        for (size_t i=0; i<pending.size(); i++)
+            fputs(pending[i]->text,stdout);
+        if (!pending.empty())
+            fflush(stdout);
+
+        //the slots can be reused only once they have been written out
+        LOG_BARRIER();
+        for (size_t i=0; i<snapshot.size(); i++)
+            snapshot[i]->tail=heads[i];
+        drainMutex.post();
+    }
+};
+
+//never destroyed: the thread is stopped by Logger::shutdown(), which
+//must run before YARP is torn down, not by a static destructor
+Flusher &flusher=*new Flusher;
+LOG_THREAD_LOCAL Ring *threadRing=NULL;
+
+/************************************************************************/
+Ring *getRing()
+{
+    if (threadRing==NULL)
+    {
+        //rings are never released, so that messages survive their threads
+        Ring *ring=new Ring;
+        ring->head=ring->tail=0;
+        ring->dropped=ring->reported=0;
+        for (int i=0; i<LOG_SITES; i++)
+            ring->sites[i].format=NULL;
+
+        flusher.add(ring);
+        threadRing=ring;
+    }
+
+    return threadRing;
+}
+
+/************************************************************************/
+bool admit(Ring *ring, const char *format, const double now, int &suppressed)
+{
+    //sites are hashed on the address of their format string
+    size_t hash=((size_t)format>>3)&(LOG_SITES-1);
+    Site &site=ring->sites[hash];
+    suppressed=0;
+
+    if ((site.format!=format) || (now-site.windowStart>=1.0))
+    {
+        if (site.format==format)
+            suppressed=site.suppressed;
+        site.format=format;
+        site.windowStart=now;
+        site.count=0;
+        site.suppressed=0;
+    }
+
+    if (site.count>=LOG_SITE_RATE)
+    {
+        site.suppressed++;
+        return false;
+    }
+
+    site.count++;
+    return true;
+}
+
+} //end unnamed namespace
+
+/************************************************************************/
+int Logger::vprint(const char *prefix, const char *format, va_list ap)
+{
+    Ring *ring=getRing();
+    double now=monotonicTime();
+
+    int suppressed;
+    if (!admit(ring,format,now,suppressed))
+        return -1;
+
+    unsigned int head=ring->head;
+    if (head-ring->tail>=LOG_RING_SIZE)
+    {
+        ring->dropped++;
+        return -1;
+    }
+
+    Message &message=ring->messages[head&(LOG_RING_SIZE-1)];
+    message.time=now;
+
+    int len=0;
+    if (suppressed>0)
+        len+=snprintf(message.text,LOG_MESSAGE_SIZE,"*** (%d similar messages suppressed)\n",suppressed);
+    if ((prefix!=NULL) && (len<LOG_MESSAGE_SIZE))
+        len+=snprintf(message.text+len,LOG_MESSAGE_SIZE-len,"%s",prefix);
+
+    int ret=-1;
+    if (len<LOG_MESSAGE_SIZE)
+    {
+        ret=vsnprintf(message.text+len,LOG_MESSAGE_SIZE-len,format,ap);
+        //truncated messages keep their line break
+        if (ret>=LOG_MESSAGE_SIZE-len)
+            message.text[LOG_MESSAGE_SIZE-2]='\n';
+    }
+    else
+        message.text[LOG_MESSAGE_SIZE-2]='\n';
+    message.text[LOG_MESSAGE_SIZE-1]='\0';
+
+    //the message must be complete before the flusher can see it
+    LOG_BARRIER();
+    ring->head=head+1;
+    flusher.wake();
+
+    return ret;
+}
+
+/************************************************************************/
+int Logger::print(const char *format, ...)
+{
+    va_list ap;
+    va_start(ap,format);
+    int ret=vprint(NULL,format,ap);
+    va_end(ap);
+    return ret;
+}
+
+/************************************************************************/
+void Logger::flush()
+{
+    flusher.drain();
+}
+
+/************************************************************************/
+void Logger::shutdown()
+{
+    flusher.shutdown();
+}
+
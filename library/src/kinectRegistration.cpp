@@ -0,0 +1,144 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <cstring>
+#include <kinectWrapper/kinectRegistration.h>
+
+using namespace std;
+using namespace yarp::sig;
+using namespace kinectWrapper;
+
+/************************************************************************/
+DepthRegistration::DepthRegistration()
+{
+    depthWidth=depthHeight=0;
+    rgbWidth=rgbHeight=0;
+    fx=fy=cx=cy=0.0f;
+    t[0]=t[1]=t[2]=0.0f;
+}
+
+/************************************************************************/
+bool DepthRegistration::setup(int depthWidth, int depthHeight, const double *depthIntrinsics,
+                              int rgbWidth, int rgbHeight, const double *rgbIntrinsics,
+                              const double *rotation, const double *translation)
+{
+    if ((depthWidth<=0) || (depthHeight<=0) || (rgbWidth<=0) || (rgbHeight<=0) ||
+        (depthIntrinsics[0]==0.0) || (depthIntrinsics[1]==0.0))
+        return false;
+
+    this->depthWidth=depthWidth;
+    this->depthHeight=depthHeight;
+    this->rgbWidth=rgbWidth;
+    this->rgbHeight=rgbHeight;
+
+    fx=(float)rgbIntrinsics[0];
+    fy=(float)rgbIntrinsics[1];
+    cx=(float)rgbIntrinsics[2];
+    cy=(float)rgbIntrinsics[3];
+
+    //depth comes in mm
+    for (int i=0; i<3; i++)
+        t[i]=(float)(1000.0*translation[i]);
+
+    rays.resize(3*depthWidth*depthHeight);
+    for (int v=0; v<depthHeight; v++)
+    {
+        for (int u=0; u<depthWidth; u++)
+        {
+            double x=(u-depthIntrinsics[2])/depthIntrinsics[0];
+            double y=(v-depthIntrinsics[3])/depthIntrinsics[1];
+            float *r=&rays[3*(v*depthWidth+u)];
+            for (int i=0; i<3; i++)
+                r[i]=(float)(rotation[3*i]*x+rotation[3*i+1]*y+rotation[3*i+2]);
+        }
+    }
+
+    return true;
+}
+
+/************************************************************************/
+bool DepthRegistration::isReady() const
+{
+    return !rays.empty();
+}
+
+/************************************************************************/
+void DepthRegistration::getRgbIntrinsics(double *intrinsics) const
+{
+    intrinsics[0]=fx;
+    intrinsics[1]=fy;
+    intrinsics[2]=cx;
+    intrinsics[3]=cy;
+}
+
+/************************************************************************/
+void DepthRegistration::apply(const unsigned short *depth, unsigned short *registered) const
+{
+    memset(registered,0,rgbWidth*rgbHeight*sizeof(unsigned short));
+
+    for (int i=0; i<depthWidth*depthHeight; i++)
+    {
+        unsigned short d=depth[i]>>3;
+        if (d==0)
+            continue;
+
+        const float *r=&rays[3*i];
+        float z=r[2]*d+t[2];
+        if (z<=0.0f)
+            continue;
+
+        float iz=1.0f/z;
+        int u=(int)(fx*(r[0]*d+t[0])*iz+cx+0.5f);
+        int v=(int)(fy*(r[1]*d+t[1])*iz+cy+0.5f);
+        if ((u<0) || (u>=rgbWidth) || (v<0) || (v>=rgbHeight))
+            continue;
+
+        unsigned int zmm=(unsigned int)(z+0.5f);
+        if (zmm>0x1FFF)
+            continue;
+
+        //z-buffer: keep the closest point, along with its player
+        unsigned short &out=registered[v*rgbWidth+u];
+        if ((out==0) || (zmm<(unsigned int)(out>>3)))
+            out=(unsigned short)((zmm<<3)|(depth[i]&0x0007));
+    }
+}
+
+/************************************************************************/
+bool DepthRegistration::apply(const ImageOf<PixelMono16> &depth, ImageOf<PixelMono16> &registered) const
+{
+    if ((depth.width()!=depthWidth) || (depth.height()!=depthHeight))
+        return false;
+
+    registered.resize(rgbWidth,rgbHeight);
+    if ((depth.getRowSize()==depthWidth*(int)sizeof(unsigned short)) &&
+        (registered.getRowSize()==rgbWidth*(int)sizeof(unsigned short)))
+    {
+        apply((const unsigned short*)depth.getRawImage(),(unsigned short*)registered.getRawImage());
+        return true;
+    }
+
+    //fall back on contiguous buffers
+    vector<unsigned short> in(depthWidth*depthHeight);
+    vector<unsigned short> out(rgbWidth*rgbHeight);
+    for (int v=0; v<depthHeight; v++)
+        memcpy(&in[v*depthWidth],depth.getRow(v),depthWidth*sizeof(unsigned short));
+    apply(&in[0],&out[0]);
+    for (int v=0; v<rgbHeight; v++)
+        memcpy(registered.getRow(v),&out[v*rgbWidth],rgbWidth*sizeof(unsigned short));
+
+    return true;
+}
@@ -0,0 +1,139 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <yarp/os/Bottle.h>
+#include <kinectWrapper/kinectRgbd.h>
+
+using namespace yarp::os;
+using namespace yarp::sig;
+using namespace kinectWrapper;
+
+/************************************************************************/
+RgbdFrame::RgbdFrame()
+{
+    timestampDepth=timestampRgb=0.0;
+    registered=false;
+}
+
+/************************************************************************/
+void RgbdFrame::unpackDepth(ImageOf<PixelMono16> &depthMM) const
+{
+    depthMM.resize(depth.width(),depth.height());
+    for (int v=0; v<depth.height(); v++)
+    {
+        const unsigned short *in=(const unsigned short*)depth.getRow(v);
+        unsigned short *out=(unsigned short*)depthMM.getRow(v);
+        for (int u=0; u<depth.width(); u++)
+            out[u]=(in[u]&0xFFF8)>>3;
+    }
+}
+
+/************************************************************************/
+static bool readImage(ConnectionReader &connection, Image &img)
+{
+    if ((connection.expectInt()!=BOTTLE_TAG_LIST) || (connection.expectInt()!=3))
+        return false;
+
+    if (connection.expectInt()!=BOTTLE_TAG_INT)
+        return false;
+    int width=connection.expectInt();
+
+    if (connection.expectInt()!=BOTTLE_TAG_INT)
+        return false;
+    int height=connection.expectInt();
+
+    if ((width<0) || (height<0) || (connection.expectInt()!=BOTTLE_TAG_BLOB))
+        return false;
+
+    img.resize(width,height);
+    int rowSize=width*img.getPixelSize();
+    if (connection.expectInt()!=rowSize*height)
+        return false;
+
+    //rows may be padded in memory, never on the wire
+    if (img.getRowSize()==rowSize)
+        return connection.expectBlock((const char*)img.getRawImage(),rowSize*height);
+
+    for (int v=0; v<height; v++)
+        if (!connection.expectBlock((const char*)img.getRow(v),rowSize))
+            return false;
+
+    return true;
+}
+
+/************************************************************************/
+static void writeImage(ConnectionWriter &connection, const Image &img)
+{
+    int rowSize=img.width()*img.getPixelSize();
+
+    connection.appendInt(BOTTLE_TAG_LIST);
+    connection.appendInt(3);
+    connection.appendInt(BOTTLE_TAG_INT);
+    connection.appendInt(img.width());
+    connection.appendInt(BOTTLE_TAG_INT);
+    connection.appendInt(img.height());
+    connection.appendInt(BOTTLE_TAG_BLOB);
+    connection.appendInt(rowSize*img.height());
+
+    //the pixels are not copied, the image outlives the write
+    if (img.getRowSize()==rowSize)
+        connection.appendExternalBlock((const char*)img.getRawImage(),rowSize*img.height());
+    else
+        for (int v=0; v<img.height(); v++)
+            connection.appendExternalBlock((const char*)img.getRow(v),rowSize);
+}
+
+/************************************************************************/
+bool RgbdFrame::read(ConnectionReader &connection)
+{
+    connection.convertTextMode();
+    if ((connection.expectInt()!=BOTTLE_TAG_LIST) || (connection.expectInt()!=5))
+        return false;
+
+    if (connection.expectInt()!=BOTTLE_TAG_DOUBLE)
+        return false;
+    timestampDepth=connection.expectDouble();
+
+    if (connection.expectInt()!=BOTTLE_TAG_DOUBLE)
+        return false;
+    timestampRgb=connection.expectDouble();
+
+    if (connection.expectInt()!=BOTTLE_TAG_INT)
+        return false;
+    registered=(connection.expectInt()!=0);
+
+    if (!readImage(connection,depth) || !readImage(connection,rgb))
+        return false;
+
+    return !connection.isError();
+}
+
+/************************************************************************/
+bool RgbdFrame::write(ConnectionWriter &connection)
+{
+    connection.appendInt(BOTTLE_TAG_LIST);
+    connection.appendInt(5);
+    connection.appendInt(BOTTLE_TAG_DOUBLE);
+    connection.appendDouble(timestampDepth);
+    connection.appendInt(BOTTLE_TAG_DOUBLE);
+    connection.appendDouble(timestampRgb);
+    connection.appendInt(BOTTLE_TAG_INT);
+    connection.appendInt(registered?1:0);
+    writeImage(connection,depth);
+    writeImage(connection,rgb);
+
+    return !connection.isError();
+}
@@ -0,0 +1,323 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <kinectWrapper/kinectSharedMemory.h>
+
+#define SHARED_MEMORY_MAGIC         0x4b575348      // "KWSH"
+#define SHARED_MEMORY_ALIGN         64
+#define SHARED_MEMORY_HEADER        128
+#define SHARED_MEMORY_SLOT_HEADER   64
+
+using namespace std;
+using namespace yarp::sig;
+using namespace kinectWrapper;
+
+namespace
+{
+
+struct SegmentHeader
+{
+    unsigned int magic;
+    unsigned int slots;
+    unsigned int slotBytes;
+    volatile unsigned int written;
+    char host[64];
+};
+
+struct SlotHeader
+{
+    volatile unsigned int seq;
+    unsigned int frame;
+    int width;
+    int height;
+    int pixelCode;
+    int rowBytes;
+    int id;
+    double timestamp;
+};
+
+/************************************************************************/
+inline void barrier()
+{
+#ifndef _WIN32
+    __sync_synchronize();
+#endif
+}
+
+/************************************************************************/
+inline size_t getSlotStride(const unsigned int slotBytes)
+{
+    return SHARED_MEMORY_SLOT_HEADER+
+           ((slotBytes+SHARED_MEMORY_ALIGN-1)/SHARED_MEMORY_ALIGN)*SHARED_MEMORY_ALIGN;
+}
+
+/************************************************************************/
+void getHostName(char *host, const size_t len)
+{
+    memset(host,0,len);
+#ifndef _WIN32
+    gethostname(host,len-1);
+#endif
+}
+
+} //end unnamed namespace
+
+/************************************************************************/
+SharedFrameRing::SharedFrameRing()
+{
+    writer=false;
+    fd=-1;
+    base=NULL;
+    size=0;
+    count=viewSeq=0;
+    viewSlot=NULL;
+}
+
+/************************************************************************/
+SharedFrameRing::~SharedFrameRing()
+{
+    close();
+}
+
+/************************************************************************/
+string SharedFrameRing::getSegmentName(const string &stem, const string &stream)
+{
+    string segment="/kinectWrapper";
+    for (size_t i=0; i<stem.length(); i++)
+        segment+=(stem[i]=='/')?'_':stem[i];
+    return segment+"_"+stream;
+}
+
+/************************************************************************/
+bool SharedFrameRing::map(const bool readOnly)
+{
+#ifndef _WIN32
+    void *ptr=mmap(NULL,size,readOnly?PROT_READ:(PROT_READ|PROT_WRITE),MAP_SHARED,fd,0);
+    if (ptr==MAP_FAILED)
+        return false;
+    base=(unsigned char*)ptr;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/************************************************************************/
+unsigned char *SharedFrameRing::getSlot(const unsigned int frame) const
+{
+    const SegmentHeader *header=(const SegmentHeader*)base;
+    return base+SHARED_MEMORY_HEADER+(frame%header->slots)*getSlotStride(header->slotBytes);
+}
+
+/************************************************************************/
+bool SharedFrameRing::create(const string &name, const int slots, const int slotBytes)
+{
+#ifndef _WIN32
+    close();
+    if ((slots<2) || (slotBytes<=0))
+        return false;
+
+    //a segment left over by a crashed server is replaced
+    shm_unlink(name.c_str());
+    fd=shm_open(name.c_str(),O_CREAT|O_EXCL|O_RDWR,0644);
+    if (fd<0)
+        return false;
+
+    size=SHARED_MEMORY_HEADER+slots*getSlotStride(slotBytes);
+    if ((ftruncate(fd,size)!=0) || !map(false))
+    {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        fd=-1;
+        return false;
+    }
+
+    memset(base,0,size);
+    SegmentHeader *header=(SegmentHeader*)base;
+    header->slots=slots;
+    header->slotBytes=slotBytes;
+    header->written=0;
+    getHostName(header->host,sizeof(header->host));
+    barrier();
+    header->magic=SHARED_MEMORY_MAGIC;
+
+    this->name=name;
+    writer=true;
+    count=0;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/************************************************************************/
+bool SharedFrameRing::attach(const string &name)
+{
+#ifndef _WIN32
+    close();
+    fd=shm_open(name.c_str(),O_RDONLY,0);
+    if (fd<0)
+        return false;
+
+    struct stat st;
+    if ((fstat(fd,&st)!=0) || (st.st_size<SHARED_MEMORY_HEADER))
+    {
+        close();
+        return false;
+    }
+
+    size=st.st_size;
+    if (!map(true))
+    {
+        close();
+        return false;
+    }
+
+    //the same name may be in use on another host sharing the yarp network
+    const SegmentHeader *header=(const SegmentHeader*)base;
+    char host[64];
+    getHostName(host,sizeof(host));
+    if ((header->magic!=SHARED_MEMORY_MAGIC) || (strncmp(header->host,host,sizeof(host))!=0) ||
+        (size<SHARED_MEMORY_HEADER+header->slots*getSlotStride(header->slotBytes)))
+    {
+        close();
+        return false;
+    }
+
+    this->name=name;
+    writer=false;
+    count=0;
+    viewSlot=NULL;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/************************************************************************/
+void SharedFrameRing::close()
+{
+#ifndef _WIN32
+    if (base!=NULL)
+        munmap(base,size);
+    if (fd>=0)
+        ::close(fd);
+    if (writer)
+        shm_unlink(name.c_str());
+#endif
+    base=NULL;
+    fd=-1;
+    writer=false;
+    viewSlot=NULL;
+}
+
+/************************************************************************/
+bool SharedFrameRing::isOpen() const
+{
+    return (base!=NULL);
+}
+
+/************************************************************************/
+bool SharedFrameRing::write(const Image &img, const double timestamp, const int id)
+{
+    if (!writer || (base==NULL))
+        return false;
+
+    SegmentHeader *header=(SegmentHeader*)base;
+    int rowBytes=img.width()*img.getPixelSize();
+    if ((rowBytes<=0) || (rowBytes*img.height()>(int)header->slotBytes))
+        return false;
+
+    unsigned char *slot=getSlot(count);
+    SlotHeader *slotHeader=(SlotHeader*)slot;
+    unsigned char *data=slot+SHARED_MEMORY_SLOT_HEADER;
+
+    slotHeader->seq++;
+    barrier();
+
+    slotHeader->frame=count;
+    slotHeader->width=img.width();
+    slotHeader->height=img.height();
+    slotHeader->pixelCode=img.getPixelCode();
+    slotHeader->rowBytes=rowBytes;
+    slotHeader->id=id;
+    slotHeader->timestamp=timestamp;
+    //rows are packed, without the padding of the yarp image
+    for (int y=0; y<img.height(); y++)
+        memcpy(data+y*rowBytes,img.getRow(y),rowBytes);
+
+    barrier();
+    slotHeader->seq++;
+    header->written=++count;
+    barrier();
+
+    return true;
+}
+
+/************************************************************************/
+bool SharedFrameRing::read(Image &view, double &timestamp, int &id)
+{
+    if (writer || (base==NULL))
+        return false;
+
+    const SegmentHeader *header=(const SegmentHeader*)base;
+    unsigned int written=header->written;
+    barrier();
+    if ((written==0) || (written==count))
+        return false;
+
+    unsigned char *slot=getSlot(written-1);
+    const SlotHeader *slotHeader=(const SlotHeader*)slot;
+    unsigned int seq=slotHeader->seq;
+    barrier();
+    if ((seq&1) || (slotHeader->frame!=written-1) || (slotHeader->pixelCode!=view.getPixelCode()))
+        return false;
+
+    int width=slotHeader->width;
+    int height=slotHeader->height;
+    timestamp=slotHeader->timestamp;
+    id=slotHeader->id;
+    view.setExternal(slot+SHARED_MEMORY_SLOT_HEADER,width,height);
+
+    barrier();
+    if (slotHeader->seq!=seq)
+        return false;
+
+    count=written;
+    viewSeq=seq;
+    viewSlot=slot;
+    return true;
+}
+
+/************************************************************************/
+bool SharedFrameRing::isValid() const
+{
+    if (viewSlot==NULL)
+        return false;
+
+    barrier();
+    return (((const SlotHeader*)viewSlot)->seq==viewSeq);
+}
+
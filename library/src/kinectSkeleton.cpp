@@ -0,0 +1,92 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <kinectWrapper/kinectSkeleton.h>
+
+using namespace std;
+using namespace yarp::os;
+using namespace kinectWrapper;
+
+/************************************************************************/
+bool kinectWrapper::parsePlayer(const Bottle &player, Player &p)
+{
+    if (player.size()<1)
+        return false;
+
+    p.ID=player.get(0).asInt();
+    p.skeleton.clear();
+    for (int j=1; j<player.size(); j++)
+    {
+        Bottle *joints=player.get(j).asList();
+        if ((joints==NULL) || (joints->size()<2))
+            return false;
+
+        Bottle *jointsPosition=joints->get(1).asList();
+        if ((jointsPosition==NULL) || (jointsPosition->size()<5))
+            return false;
+
+        Joint joint;
+        joint.u=jointsPosition->get(0).asInt();
+        joint.v=jointsPosition->get(1).asInt();
+        joint.x=jointsPosition->get(2).asDouble();
+        joint.y=jointsPosition->get(3).asDouble();
+        joint.z=jointsPosition->get(4).asDouble();
+        joint.confidence=(jointsPosition->size()>5)?jointsPosition->get(5).asDouble():1.0;
+        p.skeleton[joints->get(0).asString().c_str()]=joint;
+    }
+
+    return true;
+}
+
+/************************************************************************/
+void kinectWrapper::parseSkeleton(const Bottle &skeleton, deque<Player> &players)
+{
+    players.clear();
+    for (int i=0; i<skeleton.size(); i++)
+    {
+        Bottle *player=skeleton.get(i).asList();
+        if (player==NULL)
+            continue;
+
+        //built in place, a Player is not cheap to copy
+        players.push_back(Player());
+        if (!parsePlayer(*player,players.back()))
+            players.pop_back();
+    }
+}
+
+/************************************************************************/
+void kinectWrapper::writeSkeleton(const deque<Player> &players, Bottle &skeleton)
+{
+    skeleton.clear();
+    for (size_t i=0; i<players.size(); i++)
+    {
+        Bottle &player=skeleton.addList();
+        player.addInt(players[i].ID);
+        for (Skeleton::const_iterator it=players[i].skeleton.begin(); it!=players[i].skeleton.end(); it++)
+        {
+            Bottle &joints=player.addList();
+            joints.addString(it->first.c_str());
+            Bottle &limb=joints.addList();
+            limb.addInt(it->second.u);
+            limb.addInt(it->second.v);
+            limb.addDouble(it->second.x);
+            limb.addDouble(it->second.y);
+            limb.addDouble(it->second.z);
+            limb.addDouble(it->second.confidence);
+        }
+    }
+}
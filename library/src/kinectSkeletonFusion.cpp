@@ -0,0 +1,301 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+
+#include <cmath>
+#include <map>
+#include <algorithm>
+#include <kinectWrapper/kinectSkeletonFusion.h>
+
+using namespace std;
+using namespace kinectWrapper;
+
+namespace
+{
+
+/************************************************************************/
+int findRoot(vector<int> &parent, int i)
+{
+    while (parent[i]!=i)
+        i=parent[i]=parent[parent[i]];
+    return i;
+}
+
+} //end unnamed namespace
+
+/************************************************************************/
+SkeletonFusion::SkeletonFusion()
+{
+    nSensors=0;
+    gate=0.5;
+    minRange=0.5;
+    timeout=1.0;
+    nextID=1;
+}
+
+/************************************************************************/
+bool SkeletonFusion::configure(const int nSensors, const double gate, const double minRange,
+                               const double timeout)
+{
+    if ((nSensors<=0) || (nSensors>32) || (gate<=0.0) || (minRange<=0.0) || (timeout<0.0))
+        return false;
+
+    this->nSensors=nSensors;
+    this->gate=gate;
+    this->minRange=minRange;
+    this->timeout=timeout;
+    origins.assign(3*nSensors,0.0);
+    tracks.clear();
+    nextID=1;
+    return true;
+}
+
+/************************************************************************/
+void SkeletonFusion::setSensorOrigin(const int sensor, const double *origin)
+{
+    if ((sensor>=0) && (sensor<nSensors))
+        for (int i=0; i<3; i++)
+            origins[3*sensor+i]=origin[i];
+}
+
+/************************************************************************/
+bool SkeletonFusion::getCenter(const Player &player, double *center)
+{
+    Skeleton::const_iterator com=player.skeleton.find(KINECT_TAGS_BODYPART_COM);
+    if (com!=player.skeleton.end())
+    {
+        center[0]=com->second.x;
+        center[1]=com->second.y;
+        center[2]=com->second.z;
+        return true;
+    }
+
+    if (player.skeleton.empty())
+        return false;
+
+    center[0]=center[1]=center[2]=0.0;
+    for (Skeleton::const_iterator it=player.skeleton.begin(); it!=player.skeleton.end(); it++)
+    {
+        center[0]+=it->second.x;
+        center[1]+=it->second.y;
+        center[2]+=it->second.z;
+    }
+    for (int i=0; i<3; i++)
+        center[i]/=player.skeleton.size();
+    return true;
+}
+
+/************************************************************************/
+double SkeletonFusion::distance(const double *a, const double *b)
+{
+    double dx=a[0]-b[0];
+    double dy=a[1]-b[1];
+    double dz=a[2]-b[2];
+    return sqrt(dx*dx+dy*dy+dz*dz);
+}
+
+/************************************************************************/
+int SkeletonFusion::getJointIndex(const string &name)
+{
+    map<string,int>::iterator it=jointIndex.find(name);
+    if (it!=jointIndex.end())
+        return it->second;
+
+    int index=(int)jointNames.size();
+    jointIndex[name]=index;
+    jointNames.push_back(name);
+    return index;
+}
+
+/************************************************************************/
+void SkeletonFusion::fuse(const vector<deque<Player> > &players, deque<Player> &fused,
+                          const double timestamp)
+{
+    fused.clear();
+
+    obs.clear();
+    for (int s=0; (s<nSensors) && (s<(int)players.size()); s++)
+    {
+        for (size_t k=0; k<players[s].size(); k++)
+        {
+            Observation o;
+            o.sensor=s;
+            o.player=&players[s][k];
+            if (!getCenter(*o.player,o.center))
+                continue;
+            double range=std::max(distance(o.center,&origins[3*s]),minRange);
+            o.weight=1.0/(range*range);
+            obs.push_back(o);
+        }
+    }
+
+    //greedy association: closest pairs first, one player per sensor
+    pairs.clear();
+    for (size_t i=0; i<obs.size(); i++)
+    {
+        for (size_t j=i+1; j<obs.size(); j++)
+        {
+            if (obs[i].sensor==obs[j].sensor)
+                continue;
+            Pair p;
+            p.distance=distance(obs[i].center,obs[j].center);
+            p.i=(int)i;
+            p.j=(int)j;
+            if (p.distance<gate)
+                pairs.push_back(p);
+        }
+    }
+    sort(pairs.begin(),pairs.end());
+
+    parent.resize(obs.size());
+    sensors.resize(obs.size());
+    for (size_t i=0; i<obs.size(); i++)
+    {
+        parent[i]=(int)i;
+        sensors[i]=1u<<obs[i].sensor;
+    }
+
+    for (size_t k=0; k<pairs.size(); k++)
+    {
+        int ri=findRoot(parent,pairs[k].i);
+        int rj=findRoot(parent,pairs[k].j);
+        if ((ri!=rj) && ((sensors[ri]&sensors[rj])==0))
+        {
+            parent[rj]=ri;
+            sensors[ri]|=sensors[rj];
+        }
+    }
+
+    //number the clusters by their root
+    int nClusters=0;
+    clusters.assign(obs.size(),-1);
+    for (size_t i=0; i<obs.size(); i++)
+    {
+        int root=findRoot(parent,(int)i);
+        if (clusters[root]<0)
+            clusters[root]=nClusters++;
+    }
+
+    //weighted fusion of the joints of each cluster, the accumulators
+    //are laid out by joint with one entry per possible cluster
+    size_t stride=obs.size();
+    accumulators.assign(jointNames.size()*stride,Accumulator());
+    for (size_t i=0; i<obs.size(); i++)
+    {
+        int c=clusters[findRoot(parent,(int)i)];
+        const Skeleton &skeleton=obs[i].player->skeleton;
+        for (Skeleton::const_iterator it=skeleton.begin(); it!=skeleton.end(); it++)
+        {
+            size_t k=getJointIndex(it->first);
+            if (accumulators.size()<(k+1)*stride)
+                accumulators.resize((k+1)*stride);
+
+            const Joint &joint=it->second;
+            double w=joint.confidence*obs[i].weight;
+            Accumulator &acc=accumulators[k*stride+c];
+            acc.x+=w*joint.x;
+            acc.y+=w*joint.y;
+            acc.z+=w*joint.z;
+            acc.weight+=w;
+            acc.confidence=std::max(acc.confidence,joint.confidence);
+            //the image coordinates are taken from the most reliable view
+            if (w>acc.bestWeight)
+            {
+                acc.bestWeight=w;
+                acc.u=joint.u;
+                acc.v=joint.v;
+            }
+        }
+    }
+
+    centers.clear();
+    for (int c=0; c<nClusters; c++)
+    {
+        //built in place, a Player is not cheap to copy
+        fused.push_back(Player());
+        Player &p=fused.back();
+        for (size_t k=0; k<jointNames.size(); k++)
+        {
+            const Accumulator &acc=accumulators[k*stride+c];
+            if (acc.weight<=0.0)
+                continue;
+            Joint joint;
+            joint.u=acc.u;
+            joint.v=acc.v;
+            joint.x=acc.x/acc.weight;
+            joint.y=acc.y/acc.weight;
+            joint.z=acc.z/acc.weight;
+            joint.confidence=acc.confidence;
+            p.skeleton[jointNames[k]]=joint;
+        }
+
+        Track t;
+        if (!getCenter(p,t.center))
+        {
+            fused.pop_back();
+            continue;
+        }
+        centers.push_back(t);
+    }
+
+    assignIDs(fused,timestamp);
+}
+
+/************************************************************************/
+void SkeletonFusion::assignIDs(deque<Player> &fused, const double timestamp)
+{
+    pairs.clear();
+    for (size_t i=0; i<centers.size(); i++)
+    {
+        for (size_t j=0; j<tracks.size(); j++)
+        {
+            Pair p;
+            p.distance=distance(centers[i].center,tracks[j].center);
+            p.i=(int)i;
+            p.j=(int)j;
+            if (p.distance<gate)
+                pairs.push_back(p);
+        }
+    }
+    sort(pairs.begin(),pairs.end());
+
+    vector<bool> assigned(centers.size(),false);
+    vector<bool> taken(tracks.size(),false);
+    for (size_t k=0; k<pairs.size(); k++)
+    {
+        if (!assigned[pairs[k].i] && !taken[pairs[k].j])
+        {
+            centers[pairs[k].i].ID=tracks[pairs[k].j].ID;
+            assigned[pairs[k].i]=taken[pairs[k].j]=true;
+        }
+    }
+
+    for (size_t i=0; i<centers.size(); i++)
+    {
+        if (!assigned[i])
+            centers[i].ID=nextID++;
+        centers[i].lastSeen=timestamp;
+        fused[i].ID=centers[i].ID;
+    }
+
+    //tracks missed in this frame stay where they were last seen until
+    //the timeout expires, so that a missed detection keeps the ID
+    for (size_t j=0; j<tracks.size(); j++)
+        if (!taken[j] && (timestamp-tracks[j].lastSeen<=timeout))
+            centers.push_back(tracks[j]);
+
+    tracks.swap(centers);
+}
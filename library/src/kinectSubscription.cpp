@@ -0,0 +1,203 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <yarp/os/Time.h>
+#include <kinectWrapper/kinectSubscription.h>
+
+#define SUBSCRIPTION_WINDOW         30      // frames
+#define SUBSCRIPTION_RECOVERY       2.0     // [s]
+
+using namespace std;
+using namespace yarp::os;
+using namespace yarp::sig;
+using namespace kinectWrapper;
+
+namespace
+{
+
+//(decimation, scale) of each level, from the full stream downwards
+const int levels[][2]={{1,1}, {2,1}, {2,2}, {4,2}, {8,4}};
+const int nLevels=sizeof(levels)/sizeof(levels[0]);
+
+} //end unnamed namespace
+
+/************************************************************************/
+Subscription::Subscription()
+{
+    rgb=adaptive=connected=false;
+    decimation=1;
+    level=counter=window=drops=0;
+    pending=withheld=0;
+    minPeriod=lastSent=lastChange=0.0;
+}
+
+/************************************************************************/
+bool Subscription::open(const string &prefix, const bool rgb, const bool adaptive,
+                        const int decimation, const double maxRate)
+{
+    this->rgb=rgb;
+    this->adaptive=adaptive;
+    this->decimation=(decimation>1)?decimation:1;
+    minPeriod=(maxRate>0.0)?1.0/maxRate:0.0;
+    name=prefix;
+
+    if (!depthPort.open((prefix+"/depth:o").c_str()))
+        return false;
+
+    if (rgb && !imagePort.open((prefix+"/image:o").c_str()))
+    {
+        depthPort.close();
+        return false;
+    }
+
+    lastChange=Time::now();
+    return true;
+}
+
+/************************************************************************/
+void Subscription::close()
+{
+    depthPort.interrupt();
+    depthPort.close();
+
+    if (rgb)
+    {
+        imagePort.interrupt();
+        imagePort.close();
+    }
+}
+
+/************************************************************************/
+bool Subscription::isGone()
+{
+    return connected && (depthPort.getOutputCount()==0);
+}
+
+/************************************************************************/
+void Subscription::adapt(const bool dropped)
+{
+    window++;
+    if (dropped)
+        drops++;
+
+    if (window<SUBSCRIPTION_WINDOW)
+        return;
+
+    double t=Time::now();
+    //more than 20% of the frames did not make it in time
+    if ((5*drops>window) && (level<nLevels-1))
+    {
+        level++;
+        lastChange=t;
+    }
+    else if ((drops==0) && (level>0) && (t-lastChange>SUBSCRIPTION_RECOVERY))
+    {
+        level--;
+        lastChange=t;
+    }
+
+    window=drops=0;
+}
+
+/************************************************************************/
+void Subscription::write(const ImageOf<PixelMono16> &depth, const Stamp &stampD,
+                         const ImageOf<PixelRgb> *image, const Stamp &stampI)
+{
+    if (depthPort.getOutputCount()==0)
+        return;
+    connected=true;
+
+    if ((counter++)%getDecimation()!=0)
+    {
+        pending++;
+        return;
+    }
+
+    //the rate is checked against the host clock with some slack for jitter
+    double t=Time::now();
+    if ((minPeriod>0.0) && (t-lastSent<0.9*minPeriod))
+    {
+        pending++;
+        return;
+    }
+
+    //a write still in progress means the connection is lagging behind
+    bool busy=depthPort.isWriting() || (rgb && imagePort.isWriting());
+    if (adaptive)
+        adapt(busy);
+    if (busy)
+        return;
+
+    int scale=getScale();
+
+    ImageOf<PixelMono16> &d=depthPort.prepare();
+    if (scale>1)
+        d.copy(depth,depth.width()/scale,depth.height()/scale);
+    else
+        d=depth;
+    tsD=stampD;
+    depthPort.setEnvelope(tsD);
+    depthPort.write();
+
+    //frames withheld before the first one sent do not leave gaps
+    if (lastSent>0.0)
+        withheld+=pending;
+    pending=0;
+    lastSent=t;
+
+    if (rgb && (image!=NULL) && (imagePort.getOutputCount()>0))
+    {
+        ImageOf<PixelRgb> &i=imagePort.prepare();
+        if (scale>1)
+            i.copy(*image,image->width()/scale,image->height()/scale);
+        else
+            i=*image;
+        tsI=stampI;
+        imagePort.setEnvelope(tsI);
+        imagePort.write();
+    }
+}
+
+/************************************************************************/
+int Subscription::getLevel() const
+{
+    return level;
+}
+
+/************************************************************************/
+int Subscription::getDecimation() const
+{
+    return decimation*levels[level][0];
+}
+
+/************************************************************************/
+int Subscription::getScale() const
+{
+    return levels[level][1];
+}
+
+/************************************************************************/
+void Subscription::getPortNames(string &depthName, string &imageName)
+{
+    depthName=name+"/depth:o";
+    imageName=rgb?name+"/image:o":"";
+}
+
+/************************************************************************/
+unsigned int Subscription::getWithheld() const
+{
+    return withheld;
+}
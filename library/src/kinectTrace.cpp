@@ -0,0 +1,210 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <stdio.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <yarp/os/Semaphore.h>
+
+#include <kinectWrapper/kinectClock.h>
+#include <kinectWrapper/kinectTrace.h>
+
+#define TRACE_RING_SIZE     8192    // spans per thread, a power of two
+
+using namespace std;
+using namespace yarp::os;
+using namespace kinectWrapper;
+
+#ifdef __KINECT_TRACING__
+namespace
+{
+
+struct Span
+{
+    const char *name;
+    int id;
+    double begin;
+    double end;
+};
+
+struct Ring
+{
+    int tid;
+    volatile unsigned int head;     // written by the owner thread only
+    volatile unsigned int tail;     // written by dump() only
+    unsigned int dropped;           // written by the owner thread only
+    unsigned int reported;          // written by dump() only
+    Span spans[TRACE_RING_SIZE];
+};
+
+#ifdef _WIN32
+    #define TRACE_THREAD_LOCAL  __declspec(thread)
+    #define TRACE_BARRIER()     MemoryBarrier()
+#else
+    #define TRACE_THREAD_LOCAL  __thread
+    #define TRACE_BARRIER()     __sync_synchronize()
+#endif
+
+TRACE_THREAD_LOCAL Ring *threadRing=NULL;
+
+//rings are registered once per thread and never released,
+//so that spans survive the threads that recorded them
+vector<Ring*> rings;
+Semaphore mutexRings;
+
+/************************************************************************/
+Ring *getRing()
+{
+    if (threadRing==NULL)
+    {
+        Ring *ring=new Ring;
+        ring->head=ring->tail=0;
+        ring->dropped=ring->reported=0;
+
+        mutexRings.wait();
+        ring->tid=(int)rings.size()+1;
+        rings.push_back(ring);
+        mutexRings.post();
+
+        threadRing=ring;
+    }
+
+    return threadRing;
+}
+
+/************************************************************************/
+int getProcessId()
+{
+#ifdef _WIN32
+    return (int)GetCurrentProcessId();
+#else
+    return (int)getpid();
+#endif
+}
+
+} //end unnamed namespace
+#endif
+
+/************************************************************************/
+bool Tracer::isEnabled()
+{
+#ifdef __KINECT_TRACING__
+    return true;
+#else
+    return false;
+#endif
+}
+
+/************************************************************************/
+void Tracer::record(const char *name, const int id, const double begin, const double end)
+{
+#ifdef __KINECT_TRACING__
+    Ring *ring=getRing();
+    unsigned int head=ring->head;
+    if (head-ring->tail>=TRACE_RING_SIZE)
+    {
+        ring->dropped++;
+        return;
+    }
+
+    Span &span=ring->spans[head&(TRACE_RING_SIZE-1)];
+    span.name=name;
+    span.id=id;
+    span.begin=begin;
+    span.end=end;
+
+    //the span must be complete before dump() can see it
+    TRACE_BARRIER();
+    ring->head=head+1;
+#endif
+}
+
+/************************************************************************/
+bool Tracer::dump(const string &fileName)
+{
+#ifdef __KINECT_TRACING__
+    FILE *file=fopen(fileName.c_str(),"w");
+    if (file==NULL)
+        return false;
+
+    int pid=getProcessId();
+    fprintf(file,"{\"traceEvents\":[\n");
+    bool first=true;
+
+    mutexRings.wait();
+    for (size_t i=0; i<rings.size(); i++)
+    {
+        Ring *ring=rings[i];
+        unsigned int head=ring->head;
+        TRACE_BARRIER();
+        for (unsigned int j=ring->tail; j!=head; j++)
+        {
+            const Span &span=ring->spans[j&(TRACE_RING_SIZE-1)];
+            fprintf(file,"%s{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%d}}",first?"":",\n",span.name,
+                    pid,ring->tid,1e6*span.begin,1e6*(span.end-span.begin),span.id);
+            first=false;
+        }
+
+        //the slots can be reused only once they have been written out
+        TRACE_BARRIER();
+        ring->tail=head;
+
+        unsigned int dropped=ring->dropped;
+        if (dropped!=ring->reported)
+        {
+            fprintf(file,"%s{\"name\":\"dropped\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,"
+                    "\"ts\":%.3f,\"args\":{\"spans\":%u}}",first?"":",\n",pid,ring->tid,
+                    1e6*monotonicTime(),dropped-ring->reported);
+            ring->reported=dropped;
+            first=false;
+        }
+    }
+    mutexRings.post();
+
+    fprintf(file,"\n]}\n");
+    fclose(file);
+    return true;
+#else
+    return false;
+#endif
+}
+
+/************************************************************************/
+TraceScope::TraceScope(const char *name) : name(name), id(-1)
+{
+    begin=monotonicTime();
+}
+
+/************************************************************************/
+TraceScope::~TraceScope()
+{
+    if (id>=0)
+        Tracer::record(name,id,begin,monotonicTime());
+}
+
+/************************************************************************/
+void TraceScope::setId(const int id)
+{
+    this->id=id;
+}
+
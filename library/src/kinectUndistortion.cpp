@@ -0,0 +1,202 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <kinectWrapper/kinectUndistortion.h>
+
+#define UNDISTORTION_FRAC_BITS      5
+#define UNDISTORTION_FRAC_ONE       (1<<UNDISTORTION_FRAC_BITS)
+#define UNDISTORTION_WEIGHT_BITS    (2*UNDISTORTION_FRAC_BITS)
+
+using namespace std;
+using namespace yarp::sig;
+using namespace kinectWrapper;
+
+/************************************************************************/
+Undistortion::Undistortion()
+{
+    width=height=0;
+    bilinear=false;
+}
+
+/************************************************************************/
+bool Undistortion::setup(int width, int height, const double *intrinsics,
+                         const double *distortion, bool bilinear)
+{
+    if ((width<2) || (height<2) || (intrinsics[0]==0.0) || (intrinsics[1]==0.0))
+        return false;
+
+    this->width=width;
+    this->height=height;
+    this->bilinear=bilinear;
+
+    double fx=intrinsics[0];
+    double fy=intrinsics[1];
+    double cx=intrinsics[2];
+    double cy=intrinsics[3];
+    double k1=distortion[0];
+    double k2=distortion[1];
+    double p1=distortion[2];
+    double p2=distortion[3];
+    double k3=distortion[4];
+
+    nearest.clear();
+    taps.clear();
+    if (bilinear)
+        taps.resize(width*height);
+    else
+        nearest.resize(width*height);
+
+    for (int v=0; v<height; v++)
+    {
+        for (int u=0; u<width; u++)
+        {
+            //where the undistorted pixel (u,v) lies in the distorted image
+            double x=(u-cx)/fx;
+            double y=(v-cy)/fy;
+            double r2=x*x+y*y;
+            double radial=1.0+r2*(k1+r2*(k2+r2*k3));
+            double xd=x*radial+2.0*p1*x*y+p2*(r2+2.0*x*x);
+            double yd=y*radial+p1*(r2+2.0*y*y)+2.0*p2*x*y;
+            double su=fx*xd+cx;
+            double sv=fy*yd+cy;
+
+            int i=v*width+u;
+            if (!bilinear)
+            {
+                int nu=(int)floor(su+0.5);
+                int nv=(int)floor(sv+0.5);
+                bool inside=(nu>=0) && (nu<width) && (nv>=0) && (nv<height);
+                nearest[i]=inside?nv*width+nu:-1;
+                continue;
+            }
+
+            Tap &tap=taps[i];
+            if ((su<0.0) || (su>width-1) || (sv<0.0) || (sv>height-1))
+            {
+                tap.offset=-1;
+                continue;
+            }
+
+            //keep the 2x2 neighbourhood inside the image; on the last
+            //row/column the whole weight goes to the far samples
+            int u0=std::min((int)su,width-2);
+            int v0=std::min((int)sv,height-2);
+            int au=(int)floor((su-u0)*UNDISTORTION_FRAC_ONE+0.5);
+            int av=(int)floor((sv-v0)*UNDISTORTION_FRAC_ONE+0.5);
+
+            tap.offset=v0*width+u0;
+            tap.weights[0]=(unsigned short)((UNDISTORTION_FRAC_ONE-au)*(UNDISTORTION_FRAC_ONE-av));
+            tap.weights[1]=(unsigned short)(au*(UNDISTORTION_FRAC_ONE-av));
+            tap.weights[2]=(unsigned short)((UNDISTORTION_FRAC_ONE-au)*av);
+            tap.weights[3]=(unsigned short)(au*av);
+        }
+    }
+
+    return true;
+}
+
+/************************************************************************/
+bool Undistortion::isReady() const
+{
+    return (!nearest.empty() || !taps.empty());
+}
+
+/************************************************************************/
+void Undistortion::apply(const unsigned short *depth, unsigned short *undistorted) const
+{
+    const int *table=&nearest[0];
+    for (int i=0; i<width*height; i++)
+        undistorted[i]=(table[i]>=0)?depth[table[i]]:0;
+}
+
+/************************************************************************/
+void Undistortion::apply(const unsigned char *rgb, unsigned char *undistorted) const
+{
+    const int stride=3*width;
+    const unsigned int half=1<<(UNDISTORTION_WEIGHT_BITS-1);
+    for (int i=0; i<width*height; i++, undistorted+=3)
+    {
+        const Tap &tap=taps[i];
+        if (tap.offset<0)
+        {
+            undistorted[0]=undistorted[1]=undistorted[2]=0;
+            continue;
+        }
+
+        const unsigned char *p=rgb+3*tap.offset;
+        for (int c=0; c<3; c++)
+        {
+            unsigned int sum=tap.weights[0]*p[c]+tap.weights[1]*p[c+3]+
+                             tap.weights[2]*p[c+stride]+tap.weights[3]*p[c+stride+3];
+            undistorted[c]=(unsigned char)((sum+half)>>UNDISTORTION_WEIGHT_BITS);
+        }
+    }
+}
+
+/************************************************************************/
+bool Undistortion::apply(const ImageOf<PixelMono16> &depth, ImageOf<PixelMono16> &undistorted) const
+{
+    if (bilinear || (depth.width()!=width) || (depth.height()!=height))
+        return false;
+
+    undistorted.resize(width,height);
+    const int rowSize=width*sizeof(unsigned short);
+    if ((depth.getRowSize()==rowSize) && (undistorted.getRowSize()==rowSize))
+    {
+        apply((const unsigned short*)depth.getRawImage(),(unsigned short*)undistorted.getRawImage());
+        return true;
+    }
+
+    //fall back on contiguous buffers
+    vector<unsigned short> in(width*height);
+    vector<unsigned short> out(width*height);
+    for (int v=0; v<height; v++)
+        memcpy(&in[v*width],depth.getRow(v),rowSize);
+    apply(&in[0],&out[0]);
+    for (int v=0; v<height; v++)
+        memcpy(undistorted.getRow(v),&out[v*width],rowSize);
+
+    return true;
+}
+
+/************************************************************************/
+bool Undistortion::apply(const ImageOf<PixelRgb> &rgb, ImageOf<PixelRgb> &undistorted) const
+{
+    if (!bilinear || (rgb.width()!=width) || (rgb.height()!=height))
+        return false;
+
+    undistorted.resize(width,height);
+    const int rowSize=3*width;
+    if ((rgb.getRowSize()==rowSize) && (undistorted.getRowSize()==rowSize))
+    {
+        apply((const unsigned char*)rgb.getRawImage(),(unsigned char*)undistorted.getRawImage());
+        return true;
+    }
+
+    //fall back on contiguous buffers
+    vector<unsigned char> in(rowSize*height);
+    vector<unsigned char> out(rowSize*height);
+    for (int v=0; v<height; v++)
+        memcpy(&in[v*rowSize],rgb.getRow(v),rowSize);
+    apply(&in[0],&out[0]);
+    for (int v=0; v<height; v++)
+        memcpy(undistorted.getRow(v),&out[v*rowSize],rowSize);
+
+    return true;
+}
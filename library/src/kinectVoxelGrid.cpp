@@ -0,0 +1,239 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <kinectWrapper/kinectVoxelGrid.h>
+
+//upper bound on the number of voxels of the dense grid (256 MB of slots)
+#define KINECT_VOXEL_GRID_MAX_SIZE          (1<<26)
+
+using namespace std;
+using namespace yarp::sig;
+using namespace kinectWrapper;
+
+/************************************************************************/
+VoxelGrid::VoxelGrid()
+{
+    nx=ny=nz=0;
+    width=height=0;
+    voxelSize=0.0;
+    depthData=NULL;
+    projector=NULL;
+}
+
+/************************************************************************/
+bool VoxelGrid::configure(const double *box, double voxelSize, int nBands)
+{
+    if ((voxelSize<=0.0) || (box[1]<=box[0]) || (box[3]<=box[2]) || (box[5]<=box[4]))
+        return false;
+
+    double size=1.0;
+    int n[3];
+    for (int i=0; i<3; i++)
+    {
+        n[i]=(int)((box[2*i+1]-box[2*i])/voxelSize)+1;
+        size*=n[i];
+    }
+
+    if (size>KINECT_VOXEL_GRID_MAX_SIZE)
+        return false;
+
+    for (int i=0; i<6; i++)
+        this->box[i]=box[i];
+    this->voxelSize=voxelSize;
+    nx=n[0];
+    ny=n[1];
+    nz=n[2];
+
+    grid.assign(nx*ny*nz,-1);
+    occupied.clear();
+    pool.open(nBands<1?1:nBands);
+
+    return true;
+}
+
+/************************************************************************/
+bool VoxelGrid::isReady() const
+{
+    return !grid.empty();
+}
+
+/************************************************************************/
+int VoxelGrid::Band::lookup(const int key)
+{
+    //Fibonacci hashing, the table has 2^(32-shift) entries
+    unsigned int mask=(unsigned int)table.size()-1;
+    unsigned int h=((unsigned int)key*2654435761U)>>shift;
+    while (table[h]>=0)
+    {
+        if (keys[table[h]]==key)
+            return table[h];
+        h=(h+1)&mask;
+    }
+
+    table[h]=(int)keys.size();
+    keys.push_back(key);
+    entries.push_back((int)h);
+    sums.resize(sums.size()+4,0.0f);
+    return table[h];
+}
+
+/************************************************************************/
+int VoxelGrid::getSlot(const int key)
+{
+    int slot=grid[key];
+    if (slot<0)
+    {
+        slot=grid[key]=(int)occupied.size();
+        occupied.push_back(key);
+        sums.resize(sums.size()+4,0.0f);
+    }
+    return slot;
+}
+
+/************************************************************************/
+void VoxelGrid::process(int band, int rowBegin, int rowEnd)
+{
+    if (rowEnd<=rowBegin)
+        return;
+
+    projector->project(depthData,&cloud[0],rowBegin,rowEnd);
+
+    //a single band owns the grid and needs no table of its own
+    Band &b=bands[band];
+    bool direct=(bands.size()==1);
+    vector<float> &acc=direct?sums:b.sums;
+
+    //the table is kept at most half full
+    size_t needed=2*(size_t)(rowEnd-rowBegin)*width;
+    if (!direct && (b.table.size()<needed))
+    {
+        b.shift=32;
+        while (((size_t)1<<(32-b.shift))<needed)
+            b.shift--;
+        b.table.assign((size_t)1<<(32-b.shift),-1);
+    }
+
+    float xmin=(float)box[0], xmax=(float)box[1];
+    float ymin=(float)box[2], ymax=(float)box[3];
+    float zmin=(float)box[4], zmax=(float)box[5];
+    float scale=(float)(1.0/voxelSize);
+    int lastKey=-1,slot=-1;
+
+    for (int i=rowBegin*width; i<rowEnd*width; i++)
+    {
+        const float *p=&cloud[3*i];
+
+        //NaN points fail all the comparisons and are discarded as well
+        if ((p[0]>=xmin) && (p[0]<=xmax) && (p[1]>=ymin) && (p[1]<=ymax) &&
+            (p[2]>=zmin) && (p[2]<=zmax))
+        {
+            int ix=(int)((p[0]-xmin)*scale);
+            int iy=(int)((p[1]-ymin)*scale);
+            int iz=(int)((p[2]-zmin)*scale);
+
+            //neighbouring points often fall in the same voxel
+            int key=(iz*ny+iy)*nx+ix;
+            if (key!=lastKey)
+            {
+                slot=direct?getSlot(key):b.lookup(key);
+                lastKey=key;
+            }
+
+            float *s=&acc[4*slot];
+            s[0]+=p[0];
+            s[1]+=p[1];
+            s[2]+=p[2];
+            s[3]+=1.0f;
+        }
+    }
+}
+
+/************************************************************************/
+void VoxelGrid::merge(Band &band)
+{
+    for (size_t i=0; i<band.keys.size(); i++)
+    {
+        float *s=&sums[4*getSlot(band.keys[i])];
+        const float *p=&band.sums[4*i];
+        s[0]+=p[0];
+        s[1]+=p[1];
+        s[2]+=p[2];
+        s[3]+=p[3];
+
+        //get the band ready for the next frame
+        band.table[band.entries[i]]=-1;
+    }
+
+    band.keys.clear();
+    band.entries.clear();
+    band.sums.clear();
+}
+
+/************************************************************************/
+int VoxelGrid::compute(const ImageOf<PixelMono16> &depth, CloudProjector &projector,
+                       ImageOf<PixelRgbFloat> &centroids)
+{
+    if (!isReady() || !projector.isReady())
+        return -1;
+
+    //the bands are projected with the size of the table
+    if ((depth.width()!=projector.getWidth()) || (depth.height()!=projector.getHeight()))
+        return -1;
+
+    width=depth.width();
+    height=depth.height();
+    cloud.resize(3*width*height);
+    bands.resize(pool.getBands());
+
+    //the bands need the depth rows to be contiguous
+    if (depth.getRowSize()==width*(int)sizeof(unsigned short))
+        depthData=(const unsigned short*)depth.getRawImage();
+    else
+    {
+        depthBuf.resize(width*height);
+        for (int v=0; v<height; v++)
+            memcpy(&depthBuf[v*width],depth.getRow(v),width*sizeof(unsigned short));
+        depthData=&depthBuf[0];
+    }
+
+    this->projector=&projector;
+    sums.clear();
+    pool.process(*this,height);
+
+    //merge the voxels occupied by each band
+    if (bands.size()>1)
+        for (size_t i=0; i<bands.size(); i++)
+            merge(bands[i]);
+
+    int n=(int)occupied.size();
+    centroids.resize(n,1);
+    PixelRgbFloat *out=(PixelRgbFloat*)centroids.getRawImage();
+    for (int i=0; i<n; i++)
+    {
+        const float *s=&sums[4*i];
+        out[i].r=s[0]/s[3];
+        out[i].g=s[1]/s[3];
+        out[i].b=s[2]/s[3];
+
+        //get the grid ready for the next frame
+        grid[occupied[i]]=-1;
+    }
+    occupied.clear();
+
+    return n;
+}
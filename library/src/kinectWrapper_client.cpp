@@ -18,6 +18,7 @@
 #include <stdarg.h>
 #include <iterator>
 #include <yarp/os/Network.h>
+#include <kinectWrapper/kinectSkeleton.h>
 #include <kinectWrapper/kinectWrapper_client.h>
 
 using namespace std;
@@ -31,6 +32,10 @@ KinectWrapperClient::KinectWrapperClient()
     opening=false;
     verbosity=0;
     init=true;
+    useCloud=false;
+    useRgbd=false;
+    subscribed=false;
+    server_depth_width=server_depth_height=0;
     remote="";
     local="";
 }
@@ -48,11 +53,13 @@ int KinectWrapperClient::printMessage(const int level, const char *format, ...)
 {
     if (verbosity>=level)
     {
-        fprintf(stdout,"*** %s: ",local.c_str());
+        //the console is written by the logger thread, not by the caller
+        char prefix[128];
+        snprintf(prefix,sizeof(prefix),"*** %s: ",local.c_str());
 
         va_list ap;
         va_start(ap,format);
-        int ret=vfprintf(stdout,format,ap);
+        int ret=Logger::vprint(prefix,format,ap);
         va_end(ap);
 
         return ret;
@@ -62,6 +69,233 @@ int KinectWrapperClient::printMessage(const int level, const char *format, ...)
 }
 
 
+/************************************************************************/
+void KinectWrapperClient::allocateBuffers()
+{
+    depthCV=cvCreateImageHeader(cvSize(depth_width,depth_height),IPL_DEPTH_16U,1);
+    depthCVPl=cvCreateImageHeader(cvSize(depth_width,depth_height),IPL_DEPTH_16U,1);
+    depthFCV=cvCreateImageHeader(cvSize(depth_width,depth_height),IPL_DEPTH_32F,1);
+    depthFCVPl=cvCreateImageHeader(cvSize(depth_width,depth_height),IPL_DEPTH_32F,1);
+    playersImage=cvCreateImage(cvSize(depth_width,depth_height),IPL_DEPTH_8U,3);
+    skeletonImage=cvCreateImage(cvSize(depth_width,depth_height),IPL_DEPTH_8U,3);
+    depthToShow=cvCreateImage(cvSize(depth_width,depth_height),IPL_DEPTH_32F,1);
+
+    buf=new unsigned short[depth_width*depth_height];
+    bufPl=new unsigned short[depth_width*depth_height];
+    bufF=new float[depth_width*depth_height];
+    bufFPl=new float[depth_width*depth_height];
+}
+
+/************************************************************************/
+void KinectWrapperClient::releaseBuffers()
+{
+    delete[] buf;
+    delete[] bufPl;
+    delete[] bufF;
+    delete[] bufFPl;
+
+    cvReleaseImageHeader(&depthCV);
+    cvReleaseImageHeader(&depthCVPl);
+    cvReleaseImageHeader(&depthFCV);
+    cvReleaseImageHeader(&depthFCVPl);
+    cvReleaseImage(&playersImage);
+    cvReleaseImage(&skeletonImage);
+    cvReleaseImage(&depthToShow);
+}
+
+/************************************************************************/
+void KinectWrapperClient::checkDepthSize(const int width, const int height)
+{
+    //the server may have been reconfigured, follow the incoming frames
+    if ((width!=depth_width) || (height!=depth_height))
+    {
+        printMessage(1,"depth resolution changed to %dx%d\n",width,height);
+        releaseBuffers();
+        depth_width=width;
+        depth_height=height;
+        allocateBuffers();
+    }
+}
+
+/************************************************************************/
+void KinectWrapperClient::toServerPixel(int &u, int &v) const
+{
+    //a downscaled subscription receives smaller frames than the server's
+    if ((server_depth_width>0) && (depth_width>0) && (server_depth_width!=depth_width))
+    {
+        u=(u*server_depth_width)/depth_width;
+        v=(v*server_depth_height)/depth_height;
+    }
+}
+
+/************************************************************************/
+void KinectWrapperClient::parseInfo(const Bottle &b, const int offset)
+{
+    info=b.get(offset).asString().c_str();
+    img_width=b.get(offset+1).asInt();
+    img_height=b.get(offset+2).asInt();
+    seatedMode=(b.get(offset+3).asString()==KINECT_TAGS_SEATED_MODE);
+    drawAll=(b.get(offset+4).asString()=="drawAll");
+}
+
+/************************************************************************/
+void KinectWrapperClient::updateInfo()
+{
+    //keep only the latest notification
+    Bottle *b=NULL;
+    while (Bottle *tmp=infoPort.read(false))
+        b=tmp;
+
+    if ((b!=NULL) && (b->size()>=7))
+    {
+        parseInfo(*b,0);
+        server_depth_width=b->get(5).asInt();
+        server_depth_height=b->get(6).asInt();
+        //depth buffers follow the frames, which may still be in flight
+        printMessage(1,"server reconfigured: info %s, rgb %dx%d, depth %dx%d\n",info.c_str(),
+                     img_width,img_height,b->get(5).asInt(),b->get(6).asInt());
+    }
+}
+
+/************************************************************************/
+bool KinectWrapperClient::subscribe(const Bottle &options, string &depthSource, string &imageSource)
+{
+    Bottle cmd,reply;
+    cmd.addString(KINECT_TAGS_CMD_SUBSCRIBE);
+    cmd.addString(local.c_str());
+    cmd.append(options);
+
+    if (rpc.write(cmd,reply))
+    {
+        if ((reply.size()>2) && (reply.get(0).asString()==KINECT_TAGS_CMD_ACK))
+        {
+            depthSource=reply.get(1).asString().c_str();
+            if (reply.get(2).asString()!="null")
+                imageSource=reply.get(2).asString().c_str();
+            return subscribed=true;
+        }
+    }
+
+    return false;
+}
+
+/************************************************************************/
+void KinectWrapperClient::attachSharedMemory()
+{
+    Bottle cmd,reply;
+    cmd.addString(KINECT_TAGS_CMD_GETSHAREDMEMORY);
+
+    //attaching fails when the server runs on another host
+    if (rpc.write(cmd,reply) && (reply.size()>2) && (reply.get(0).asString()==KINECT_TAGS_CMD_ACK))
+    {
+        if (depthRing.attach(reply.get(1).asString().c_str()))
+        {
+            printMessage(1,"depth is read from the shared memory\n");
+            if ((reply.get(2).asString()!="null") && rgbRing.attach(reply.get(2).asString().c_str()))
+                printMessage(1,"rgb is read from the shared memory\n");
+            return;
+        }
+    }
+
+    printMessage(1,"shared memory not available, frames go through the ports\n");
+}
+
+/************************************************************************/
+ImageOf<PixelMono16>* KinectWrapperClient::readDepthFrame(double &timestamp)
+{
+    KINECT_TRACE_SCOPE(receive,"receive_depth");
+    if (depthRing.isOpen())
+    {
+        int id;
+        if (!depthRing.read(depthView,timestamp,id))
+            return NULL;
+        statsD.receive(id);
+        KINECT_TRACE_ID(receive,id);
+        return &depthView;
+    }
+
+    ImageOf<PixelMono16>* img=depthPort.read(false);
+    if (img!=NULL)
+    {
+        Bottle ts;
+        depthPort.getEnvelope(ts);
+        timestamp=ts.get(1).asDouble();
+        statsD.receive(ts.get(0).asInt());
+        KINECT_TRACE_ID(receive,statsD.lastId);
+    }
+    return img;
+}
+
+/************************************************************************/
+ImageOf<PixelRgb>* KinectWrapperClient::readRgbFrame(double &timestamp)
+{
+    KINECT_TRACE_SCOPE(receive,"receive_rgb");
+    if (rgbRing.isOpen())
+    {
+        int id;
+        if (!rgbRing.read(rgbView,timestamp,id))
+            return NULL;
+        statsI.receive(id);
+        KINECT_TRACE_ID(receive,id);
+        return &rgbView;
+    }
+
+    ImageOf<PixelRgb>* img=imagePort.read(false);
+    if (img!=NULL)
+    {
+        Bottle ts;
+        imagePort.getEnvelope(ts);
+        timestamp=ts.get(1).asDouble();
+        statsI.receive(ts.get(0).asInt());
+        KINECT_TRACE_ID(receive,statsI.lastId);
+    }
+    return img;
+}
+
+/************************************************************************/
+bool KinectWrapperClient::validateDepthFrame()
+{
+    //frames of the shared memory are used in place, hence they are
+    //checked once used: the server may have wrapped around the ring
+    if (depthRing.isOpen() && !depthRing.isValid())
+    {
+        statsD.reject();
+        printMessage(2,"depth frame overwritten while reading it, dropped\n");
+        return false;
+    }
+    return true;
+}
+
+/************************************************************************/
+bool KinectWrapperClient::validateRgbFrame()
+{
+    if (rgbRing.isOpen() && !rgbRing.isValid())
+    {
+        statsI.reject();
+        printMessage(2,"rgb frame overwritten while reading it, dropped\n");
+        return false;
+    }
+    return true;
+}
+
+/************************************************************************/
+bool KinectWrapperClient::connectStream(const string &source, const string &destination,
+                                        const string &through)
+{
+    string carrier=through.empty()?this->carrier:through;
+    if (Network::connect(source.c_str(),destination.c_str(),carrier.c_str()))
+        return true;
+
+    //multicast may not be routed on the interface in use
+    if (carrier=="mcast")
+    {
+        printMessage(1,"unable to join the multicast group of %s, falling back to udp\n",source.c_str());
+        return Network::connect(source.c_str(),destination.c_str(),"udp");
+    }
+
+    return false;
+}
+
 /************************************************************************/
 bool KinectWrapperClient::open(const Property &options)
 {
@@ -70,6 +304,13 @@ bool KinectWrapperClient::open(const Property &options)
     carrier=opt.check("carrier",Value("udp")).asString().c_str();
     verbosity=opt.check("verbosity",Value(0)).asInt();
     noRpc = opt.check("noRPC");
+    useCloud=opt.check("cloud");
+    useRgbd=opt.check("rgbd");
+    adaptive=opt.check("adaptive");
+    statsD.clear();
+    statsI.clear();
+    statsS.clear();
+    traceFile=opt.check("trace",Value("")).asString().c_str();
 
     if (opt.check("remote"))
         remote=opt.find("remote").asString().c_str();
@@ -119,19 +360,14 @@ bool KinectWrapperClient::open(const Property &options)
                     {
                         printMessage(1, "successfully connected with the server %s!\n", remote.c_str());
 
-                        info = reply.get(1).asString().c_str();
-                        img_width = reply.get(2).asInt();
-                        img_height = reply.get(3).asInt();
-                        if (reply.get(4).asString() == KINECT_TAGS_SEATED_MODE)
-                            seatedMode = true;
-                        else
-                            seatedMode = false;
-                        if (reply.get(5).asString() == "drawAll")
-                            drawAll = true;
-                        else
-                            drawAll = false;
+                        parseInfo(reply, 1);
                         depth_width = reply.get(6).asInt();
                         depth_height = reply.get(7).asInt();
+                        server_depth_width = depth_width;
+                        server_depth_height = depth_height;
+                        //the server may suggest a carrier, e.g. mcast
+                        if (!opt.check("carrier") && (reply.size() > 9) && (reply.get(9).asString() != "null"))
+                            carrier = reply.get(9).asString().c_str();
                     }
                 }
             }
@@ -152,31 +388,76 @@ bool KinectWrapperClient::open(const Property &options)
         }
     }
 
-    depthCV=cvCreateImageHeader(cvSize(depth_width,depth_height),IPL_DEPTH_16U,1);
-    depthCVPl=cvCreateImageHeader(cvSize(depth_width,depth_height),IPL_DEPTH_16U,1);
-    depthFCV=cvCreateImageHeader(cvSize(depth_width,depth_height),IPL_DEPTH_32F,1);
-    depthFCVPl=cvCreateImageHeader(cvSize(depth_width,depth_height),IPL_DEPTH_32F,1);
-    playersImage=cvCreateImage(cvSize(depth_width,depth_height),IPL_DEPTH_8U,3);
-    skeletonImage=cvCreateImage(cvSize(depth_width,depth_height),IPL_DEPTH_8U,3);
+    allocateBuffers();
     depthTmp=cvCreateImage(cvSize(depth_width,depth_height),IPL_DEPTH_16U,1);
-    depthToShow=cvCreateImage(cvSize(depth_width,depth_height),IPL_DEPTH_32F,1);
+    openInfo=info;
 
-    buf=new unsigned short[depth_width*depth_height];
-    bufPl=new unsigned short[depth_width*depth_height];
-    bufF=new float[depth_width*depth_height];
-    bufFPl=new float[depth_width*depth_height];
+    //servers that can be reconfigured at run-time notify the changes here
+    if (!noRpc && Network::exists(("/"+remote+"/info:o").c_str()))
+    {
+        infoPort.open(("/"+local+"/info:i").c_str());
+        Network::connect(("/"+remote+"/info:o").c_str(),infoPort.getName().c_str());
+    }
+
+    string depthSource="/"+remote+"/depth:o";
+    string imageSource="/"+remote+"/image:o";
+    if ((adaptive || opt.check("decimation") || opt.check("max_rate")) && !noRpc)
+    {
+        Bottle options;
+        if (adaptive)
+            options.addList().addString("adaptive");
+        if (opt.check("decimation"))
+        {
+            Bottle &b=options.addList();
+            b.addString("decimation");
+            b.addInt(opt.find("decimation").asInt());
+        }
+        if (opt.check("max_rate"))
+        {
+            Bottle &b=options.addList();
+            b.addString("max_rate");
+            b.addDouble(opt.find("max_rate").asDouble());
+        }
+        if (!subscribe(options,depthSource,imageSource))
+            printMessage(1,"the server %s does not accept subscriptions, the shared ports are used\n",remote.c_str());
+    }
+
+    if (opt.check("shmem") && !noRpc)
+        attachSharedMemory();
+
+    //the adaptive level follows the writes still pending on the server,
+    //which never pile up on connections that do not block the writer
+    string streamCarrier=carrier;
+    if (adaptive && subscribed && ((carrier=="udp") || (carrier=="mcast")))
+    {
+        printMessage(1,"adaptive streams need tcp to sense the backpressure, %s is not used for depth and rgb\n",
+                     carrier.c_str());
+        streamCarrier="tcp";
+    }
 
     ok = true;
-    ok&=Network::connect(("/"+remote+"/depth:o").c_str(),depthPort.getName().c_str(),carrier.c_str());
+    if (!depthRing.isOpen())
+        ok&=connectStream(depthSource,depthPort.getName().c_str(),streamCarrier);
     if (info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_RGB || info==KINECT_TAGS_DEPTH_RGB_PLAYERS)
     {
         imagePort.open(("/"+local+"/image:i").c_str());
-        ok&=Network::connect(("/"+remote+"/image:o").c_str(),imagePort.getName().c_str(),carrier.c_str());
+        if (!rgbRing.isOpen())
+            ok&=connectStream(imageSource,imagePort.getName().c_str(),streamCarrier);
     }
     if (info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_JOINTS)
     {
         jointsPort.open(("/"+local+"/joints:i").c_str());
-        ok&=Network::connect(("/"+remote+"/joints:o").c_str(),jointsPort.getName().c_str(),carrier.c_str());
+        ok&=connectStream("/"+remote+"/joints:o",jointsPort.getName().c_str());
+    }
+    if (useCloud)
+    {
+        cloudPort.open(("/"+local+"/cloud:i").c_str());
+        ok&=connectStream("/"+remote+"/cloud:o",cloudPort.getName().c_str());
+    }
+    if (useRgbd)
+    {
+        rgbdPort.open(("/"+local+"/rgbd:i").c_str());
+        ok&=connectStream("/"+remote+"/rgbd:o",rgbdPort.getName().c_str());
     }
 
     if (ok)
@@ -190,6 +471,18 @@ void KinectWrapperClient::close()
 {
     if (opening)
     {
+        if (!traceFile.empty() && !Tracer::dump(traceFile))
+            printMessage(1,"unable to write the trace %s (is tracing compiled in?)\n",traceFile.c_str());
+
+        if (subscribed)
+        {
+            Bottle cmd,reply;
+            cmd.addString(KINECT_TAGS_CMD_UNSUBSCRIBE);
+            cmd.addString(local.c_str());
+            rpc.write(cmd,reply);
+            subscribed=false;
+        }
+
         depthPort.interrupt();
         if (!noRpc)
             rpc.interrupt();
@@ -198,30 +491,36 @@ void KinectWrapperClient::close()
         if (!noRpc)
             rpc.close();
 
-        if (info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_JOINTS)
+        if (openInfo==KINECT_TAGS_ALL_INFO || openInfo==KINECT_TAGS_DEPTH_JOINTS)
         {
             jointsPort.interrupt();
             jointsPort.close();
         }
 
-        if (info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_RGB || info==KINECT_TAGS_DEPTH_RGB_PLAYERS)
+        if (openInfo==KINECT_TAGS_ALL_INFO || openInfo==KINECT_TAGS_DEPTH_RGB || openInfo==KINECT_TAGS_DEPTH_RGB_PLAYERS)
         {
             imagePort.interrupt();
             imagePort.close();
         }
 
-        delete[] buf;
-        delete[] bufPl;
-        delete[] bufF;
-        delete[] bufFPl;
+        infoPort.interrupt();
+        infoPort.close();
 
-        cvReleaseImageHeader(&depthCV);
-        cvReleaseImageHeader(&depthCVPl);
-        cvReleaseImageHeader(&depthFCV);
-        cvReleaseImageHeader(&depthFCVPl);
-        cvReleaseImage(&playersImage);
-        cvReleaseImage(&skeletonImage);
-        cvReleaseImage(&depthToShow);
+        if (useCloud)
+        {
+            cloudPort.interrupt();
+            cloudPort.close();
+        }
+
+        if (useRgbd)
+        {
+            rgbdPort.interrupt();
+            rgbdPort.close();
+        }
+
+        releaseBuffers();
+        depthRing.close();
+        rgbRing.close();
 
         opening=false;
 
@@ -229,6 +528,8 @@ void KinectWrapperClient::close()
     }
     else
         printMessage(3,"client is already closed\n");
+
+    Logger::shutdown();
 }
 
 /************************************************************************/
@@ -238,22 +539,21 @@ bool KinectWrapperClient::getDepth(ImageOf<PixelMono16> &depthIm, double *timest
     if (opening)
     {
         ImageOf<PixelMono16>* img;
-        if ((img=(ImageOf<PixelMono16>*)depthPort.read(false)))
+        double timestampD;
+        if ((img=readDepthFrame(timestampD)))
         {
-            Bottle ts;
-            depthPort.getEnvelope(ts);
-            double timestampD=ts.get(0).asDouble();
+            KINECT_TRACE_SCOPE(unpack,"unpack_depth");
+            KINECT_TRACE_ID(unpack,statsD.lastId);
+            checkDepthSize(img->width(),img->height());
             unsigned short* pBuff=(unsigned short*)img->getRawImage();
-            for (int i=0; i<img->width()*img->height(); i++)
-            {
-                //We take only the first 13 bits, that contain the depth value in mm
-                unsigned short realDepth = (pBuff[i]&0xFFF8)>>3;
-                buf[i]=realDepth;
-            }
+            //We take only the first 13 bits, that contain the depth value in mm
+            unpackDepth(pBuff,buf,img->width()*img->height());
+            if (!validateDepthFrame())
+                return false;
             cvSetData(depthCV,buf,depth_width*2);
             depthIm.wrapIplImage(depthCV);
             if (timestamp!=NULL)
-                timestamp=&timestampD;
+                *timestamp=timestampD;
             return true;
         }
         else
@@ -273,23 +573,21 @@ bool KinectWrapperClient::getDepth(ImageOf<PixelFloat> &depthIm, double *timesta
     if (opening)
     {
         ImageOf<PixelMono16>* img;
-        if ((img=(ImageOf<PixelMono16>*)depthPort.read(false)))
+        double timestampD;
+        if ((img=readDepthFrame(timestampD)))
         {
-            Bottle ts;
-            depthPort.getEnvelope(ts);
-            double timestampD=ts.get(0).asDouble();
+            KINECT_TRACE_SCOPE(unpack,"unpack_depth");
+            KINECT_TRACE_ID(unpack,statsD.lastId);
+            checkDepthSize(img->width(),img->height());
             unsigned short* pBuff=(unsigned short*)img->getRawImage();
-            for (int i=0; i<img->width()*img->height(); i++)
-            {
-                //We take only the first 13 bits, that contain the depth value in mm
-                unsigned short realDepth = (pBuff[i]&0xFFF8);
-                float scale=(float)((1.0*realDepth/0xFFF8));
-                bufF[i]=scale;
-            }
+            //We take only the first 13 bits, that contain the depth value in mm
+            unpackDepthScaled(pBuff,bufF,img->width()*img->height());
+            if (!validateDepthFrame())
+                return false;
             cvSetData(depthFCV,bufF,depth_width*4);
             depthIm.wrapIplImage(depthFCV);
             if (timestamp!=NULL)
-                timestamp=&timestampD;
+                *timestamp=timestampD;
             return true;
         }
         else
@@ -310,14 +608,16 @@ bool KinectWrapperClient::getRgb(ImageOf<PixelRgb> &rgbIm, double *timestamp)
         if (info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_RGB || info==KINECT_TAGS_DEPTH_RGB_PLAYERS)
         {
             ImageOf<PixelRgb> *tmp;
-            if ((tmp=imagePort.read(false)))
+            double timestampI;
+            if ((tmp=readRgbFrame(timestampI)))
             {
+                KINECT_TRACE_SCOPE(unpack,"unpack_rgb");
+                KINECT_TRACE_ID(unpack,statsI.lastId);
                 rgbIm=*tmp;
-                Bottle ts;
-                imagePort.getEnvelope(ts);
-                double timestampI=ts.get(0).asDouble();
+                if (!validateRgbFrame())
+                    return false;
                 if (timestamp!=NULL)
-                    timestamp=&timestampI;
+                    *timestamp=timestampI;
                 return true;
             }
             else
@@ -336,6 +636,75 @@ bool KinectWrapperClient::getRgb(ImageOf<PixelRgb> &rgbIm, double *timestamp)
     }
 }
 
+/************************************************************************/
+bool KinectWrapperClient::getRgbd(ImageOf<PixelMono16> &depthIm, ImageOf<PixelRgb> &rgbIm,
+                                  double *timestampDepth, double *timestampRgb)
+{
+    if (opening)
+    {
+        if (useRgbd)
+        {
+            RgbdFrame *frame;
+            if ((frame=rgbdPort.read(false)))
+            {
+                frame->unpackDepth(depthIm);
+                rgbIm=frame->rgb;
+                if (timestampDepth!=NULL)
+                    *timestampDepth=frame->timestampDepth;
+                if (timestampRgb!=NULL)
+                    *timestampRgb=frame->timestampRgb;
+                return true;
+            }
+            else
+                return false;
+        }
+        else
+        {
+            printMessage(0,"Client has not been opened with the rgbd option\n");
+            return false;
+        }
+    }
+    else
+    {
+        printMessage(1,"client is not open\n");
+        return false;
+    }
+}
+
+/************************************************************************/
+bool KinectWrapperClient::getCloud(ImageOf<PixelRgbFloat> &cloud, double *timestamp)
+{
+    if (opening)
+    {
+        if (useCloud)
+        {
+            ImageOf<PixelRgbFloat> *tmp;
+            if ((tmp=cloudPort.read(false)))
+            {
+                cloud=*tmp;
+                Bottle ts;
+                cloudPort.getEnvelope(ts);
+                double timestampC=ts.get(1).asDouble();
+                if (timestamp!=NULL)
+                    *timestamp=timestampC;
+                return true;
+            }
+            else
+                return false;
+        }
+        else
+        {
+            printMessage(0,"Client has not been opened with the cloud option\n");
+            return false;
+        }
+    }
+    else
+    {
+        printMessage(1,"client is not open\n");
+        return false;
+    }
+}
+
 /************************************************************************/
 bool KinectWrapperClient::getPlayers(Matrix &players, double *timestamp)
 {
@@ -343,29 +712,20 @@ bool KinectWrapperClient::getPlayers(Matrix &players, double *timestamp)
     {
         if (info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_RGB_PLAYERS || info==KINECT_TAGS_DEPTH_PLAYERS)
         {
-            players.resize(depth_height,depth_width);
             ImageOf<PixelMono16>* img;
-            if ((img=(ImageOf<PixelMono16>*)depthPort.read(false)))
+            double timestampD;
+            if ((img=readDepthFrame(timestampD)))
             {
-                Bottle ts;
-                depthPort.getEnvelope(ts);
-                double timestampD=ts.get(0).asDouble();
+                KINECT_TRACE_SCOPE(unpack,"unpack_depth");
+                KINECT_TRACE_ID(unpack,statsD.lastId);
+                checkDepthSize(img->width(),img->height());
+                players.resize(depth_height,depth_width);
                 unsigned short* pBuff=(unsigned short*)img->getRawImage();
-                int m=0;
-                int n=0;
-                for (int i=0; i<img->width()*img->height(); i++)
-                {
-                    int p=(pBuff[i]&0x0007);
-                    if (n==img->width())
-                    {
-                        n=0;
-                        m++;
-                    }
-                    players(m,n)=p;
-                    n++;
-                }
+                unpackPlayers(pBuff,players.data(),img->width()*img->height());
+                if (!validateDepthFrame())
+                    return false;
                 if (timestamp!=NULL)
-                    timestamp=&timestampD;
+                    *timestamp=timestampD;
                 return true;
             }
             else
@@ -391,33 +751,23 @@ bool KinectWrapperClient::getDepthAndPlayers(ImageOf<PixelMono16> &depthIm, Matr
     {
         if (info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_RGB_PLAYERS || info==KINECT_TAGS_DEPTH_PLAYERS)
         {
-            players.resize(depth_height,depth_width);
             ImageOf<PixelMono16>* img;
-            if ((img=(ImageOf<PixelMono16>*)depthPort.read(false)))
+            double timestampD;
+            if ((img=readDepthFrame(timestampD)))
             {
-                Bottle ts;
-                depthPort.getEnvelope(ts);
-                double timestampD=ts.get(0).asDouble();
+                KINECT_TRACE_SCOPE(unpack,"unpack_depth");
+                KINECT_TRACE_ID(unpack,statsD.lastId);
+                checkDepthSize(img->width(),img->height());
+                players.resize(depth_height,depth_width);
                 unsigned short* pBuff=(unsigned short*)img->getRawImage();
-                int m=0;
-                int n=0;
-                for (int i=0; i<img->width()*img->height(); i++)
-                {
-                    unsigned short realDepth = (pBuff[i]&0xFFF8)>>3;
-                    bufPl[i]=realDepth;
-                    int p=(pBuff[i]&0x0007);
-                    if (n==img->width())
-                    {
-                        n=0;
-                        m++;
-                    }
-                    players(m,n)=p;
-                    n++;
-                }
+                unpackDepth(pBuff,bufPl,img->width()*img->height());
+                unpackPlayers(pBuff,players.data(),img->width()*img->height());
+                if (!validateDepthFrame())
+                    return false;
                 cvSetData(depthCVPl,bufPl,depth_width*2);
                 depthIm.wrapIplImage(depthCVPl);
                 if (timestamp!=NULL)
-                    timestamp=&timestampD;
+                    *timestamp=timestampD;
                 return true;
             }
             else
@@ -443,34 +793,23 @@ bool KinectWrapperClient::getDepthAndPlayers(ImageOf<PixelFloat> &depthIm, Matri
     {
         if (info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_RGB_PLAYERS || info==KINECT_TAGS_DEPTH_PLAYERS)
         {
-            players.resize(depth_height,depth_width);
             ImageOf<PixelMono16>* img;
-            if ((img=(ImageOf<PixelMono16>*)depthPort.read(false)))
+            double timestampD;
+            if ((img=readDepthFrame(timestampD)))
             {
-                Bottle ts;
-                depthPort.getEnvelope(ts);
-                double timestampD=ts.get(0).asDouble();
+                KINECT_TRACE_SCOPE(unpack,"unpack_depth");
+                KINECT_TRACE_ID(unpack,statsD.lastId);
+                checkDepthSize(img->width(),img->height());
+                players.resize(depth_height,depth_width);
                 unsigned short* pBuff=(unsigned short*)img->getRawImage();
-                int m=0;
-                int n=0;
-                for (int i=0; i<img->width()*img->height(); i++)
-                {
-                    unsigned short realDepth = (pBuff[i]&0xFFF8);
-                    float scale=(float)((1.0*realDepth/0xFFF8));
-                    bufFPl[i]=scale;
-                    int p=(pBuff[i]&0x0007);
-                    if (n==img->width())
-                    {
-                        n=0;
-                        m++;
-                    }
-                    players(m,n)=p;
-                    n++;
-                }
+                unpackDepthScaled(pBuff,bufFPl,img->width()*img->height());
+                unpackPlayers(pBuff,players.data(),img->width()*img->height());
+                if (!validateDepthFrame())
+                    return false;
                 cvSetData(depthFCVPl,bufFPl,depth_width*4);
                 depthIm.wrapIplImage(depthFCVPl);
                 if (timestamp!=NULL)
-                    timestamp=&timestampD;
+                    *timestamp=timestampD;
                 return true;
             }
             else
@@ -503,9 +842,12 @@ bool KinectWrapperClient::getJoints(deque<Player> &joints, double *timestamp)
                     return false;
                 Bottle ts;
                 jointsPort.getEnvelope(ts);
-                double timestampS=ts.get(0).asDouble();
+                double timestampS=ts.get(1).asDouble();
+                statsS.receive(ts.get(0).asInt());
+                KINECT_TRACE_SCOPE(unpack,"unpack_joints");
+                KINECT_TRACE_ID(unpack,statsS.lastId);
                 if (timestamp!=NULL)
-                    timestamp=&timestampS;
+                    *timestamp=timestampS;
                 joints=getJoints(skeleton);
                 if (joints.size()>0)
                     return true;
@@ -542,9 +884,12 @@ bool KinectWrapperClient::getJoints(Player &joints, int player, double *timestam
                     return false;
                 Bottle ts;
                 jointsPort.getEnvelope(ts);
-                double timestampS=ts.get(0).asDouble();
+                double timestampS=ts.get(1).asDouble();
+                statsS.receive(ts.get(0).asInt());
+                KINECT_TRACE_SCOPE(unpack,"unpack_joints");
+                KINECT_TRACE_ID(unpack,statsS.lastId);
                 if (timestamp!=NULL)
-                    timestamp=&timestampS;
+                    *timestamp=timestampS;
                 joints=getJoints(skeleton,player);
                 if (joints.ID==-1)
                     return false;
@@ -572,12 +917,27 @@ bool KinectWrapperClient::getInfo(Property &opt)
 {
     if (opening)
     {
+        updateInfo();
         opt.put("info",info.c_str());
         opt.put("img_width",img_width);
         opt.put("img_height",img_height);
         opt.put("depth_width",depth_width);
         opt.put("depth_height",depth_height);
         opt.put("seated_mode",(seatedMode?"on":"off"));
+
+        if (subscribed)
+        {
+            Bottle cmd,reply;
+            cmd.addString(KINECT_TAGS_CMD_GETSUBSCRIPTION);
+            cmd.addString(local.c_str());
+            if (rpc.write(cmd,reply) && (reply.size()>3) && (reply.get(0).asString()==KINECT_TAGS_CMD_ACK))
+            {
+                opt.put("stream_level",reply.get(1).asInt());
+                opt.put("stream_decimation",reply.get(2).asInt());
+                opt.put("stream_scale",reply.get(3).asInt());
+                opt.put("stream_withheld",reply.get(4).asInt());
+            }
+        }
         return true;
     }
     return false;
@@ -587,27 +947,7 @@ bool KinectWrapperClient::getInfo(Property &opt)
 std::deque<Player> KinectWrapperClient::getJoints(Bottle* skeleton)
 {
     deque<Player> players;
-    for (int i=0; i<skeleton->size(); i++)
-    {
-        Skeleton limbs;
-        Bottle* player=skeleton->get(i).asList();
-        Player pi;
-        pi.ID=player->get(0).asInt();
-        for (int j=1; j<player->size(); j++)
-        {
-            Bottle* joints=player->get(j).asList();
-            Bottle* jointsPosition=joints->get(1).asList();
-            Joint joint;
-            joint.u=jointsPosition->get(0).asInt();
-            joint.v=jointsPosition->get(1).asInt();
-            joint.x=jointsPosition->get(2).asDouble();
-            joint.y=jointsPosition->get(3).asDouble();
-            joint.z=jointsPosition->get(4).asDouble();
-            limbs[joints->get(0).asString().c_str()]=joint;
-        }
-        pi.skeleton=limbs;
-        players.push_back(pi);
-    }
+    parseSkeleton(*skeleton,players);
     return players;
 }
 
@@ -623,22 +963,10 @@ Player KinectWrapperClient::getJoints(Bottle* skeleton, int playerId)
         for (int i=0; i<skeleton->size(); i++)
         {
             Bottle* player=skeleton->get(i).asList();
-            if(player->get(0).asInt()==playerId)
+            if ((player!=NULL) && (player->get(0).asInt()==playerId))
             {
-                found=true;
-                p.ID=playerId;
-                for (int j=1; j<player->size(); j++)
-                {
-                    Bottle* joints=player->get(j).asList();
-                    Bottle* jointsPosition=joints->get(1).asList();
-                    Joint joint;
-                    joint.u=jointsPosition->get(0).asInt();
-                    joint.v=jointsPosition->get(1).asInt();
-                    joint.x=jointsPosition->get(2).asDouble();
-                    joint.y=jointsPosition->get(3).asDouble();
-                    joint.z=jointsPosition->get(4).asDouble();
-                    p.skeleton[joints->get(0).asString().c_str()]=joint;
-                }
+                found=parsePlayer(*player,p);
+                break;
             }
         }
         if (!found)
@@ -853,6 +1181,7 @@ bool KinectWrapperClient::get3DPoint(int u, int v, yarp::sig::Vector &point3D)
     if (opening)
     {
         Bottle cmd,reply;
+        toServerPixel(u,v);
         cmd.addString(KINECT_TAGS_CMD_GET3DPOINT);
         cmd.addInt(u);
         cmd.addInt(v);
@@ -883,6 +1212,191 @@ bool KinectWrapperClient::get3DPoint(int u, int v, yarp::sig::Vector &point3D)
         return false;
 }
 
+/************************************************************************/
+bool KinectWrapperClient::get3DPoints(const vector<pair<int,int> > &pixels, vector<yarp::sig::Vector> &points3D)
+{
+    if (opening)
+    {
+        Bottle cmd,reply;
+        cmd.addString(KINECT_TAGS_CMD_GET3DPOINTS);
+        Bottle &list=cmd.addList();
+        for (size_t i=0; i<pixels.size(); i++)
+        {
+            int u=pixels[i].first;
+            int v=pixels[i].second;
+            toServerPixel(u,v);
+            list.addInt(u);
+            list.addInt(v);
+        }
+
+        if (rpc.write(cmd,reply))
+        {
+            if (reply.size()>1)
+            {
+                if (reply.get(0).asString()==KINECT_TAGS_CMD_ACK)
+                {
+                    Bottle *points=reply.get(1).asList();
+                    if ((points!=NULL) && (points->size()==3*(int)pixels.size()))
+                    {
+                        points3D.resize(pixels.size());
+                        for (size_t i=0; i<pixels.size(); i++)
+                        {
+                            points3D[i].resize(3,0.0);
+                            points3D[i][0]=points->get(3*i).asDouble();
+                            points3D[i][1]=points->get(3*i+1).asDouble();
+                            points3D[i][2]=points->get(3*i+2).asDouble();
+                        }
+
+                        return true;
+                    }
+                }
+            }
+        }
+        printMessage(1,"unable to get correct reply from the server %s!\n",remote.c_str());
+
+        return false;
+    }
+    else
+        return false;
+}
+
+/************************************************************************/
+bool KinectWrapperClient::setExtrinsics(const Matrix &H)
+{
+    if (opening && (H.rows()==4) && (H.cols()==4))
+    {
+        Bottle cmd,reply;
+        cmd.addString(KINECT_TAGS_CMD_SETEXTRINSICS);
+        Bottle &list=cmd.addList();
+        for (int r=0; r<4; r++)
+            for (int c=0; c<4; c++)
+                list.addDouble(H(r,c));
+
+        if (rpc.write(cmd,reply))
+        {
+            if (reply.size()>0)
+            {
+                if (reply.get(0).asString()==KINECT_TAGS_CMD_ACK)
+                    return true;
+            }
+        }
+        printMessage(1,"unable to get correct reply from the server %s!\n",remote.c_str());
+
+        return false;
+    }
+    else
+        return false;
+}
+
+/************************************************************************/
+bool KinectWrapperClient::getExtrinsics(Matrix &H)
+{
+    if (opening)
+    {
+        Bottle cmd,reply;
+        cmd.addString(KINECT_TAGS_CMD_GETEXTRINSICS);
+
+        if (rpc.write(cmd,reply))
+        {
+            if (reply.size()>1)
+            {
+                if (reply.get(0).asString()==KINECT_TAGS_CMD_ACK)
+                {
+                    Bottle *list=reply.get(1).asList();
+                    if ((list!=NULL) && (list->size()==16))
+                    {
+                        H.resize(4,4);
+                        for (int r=0; r<4; r++)
+                            for (int c=0; c<4; c++)
+                                H(r,c)=list->get(4*r+c).asDouble();
+
+                        return true;
+                    }
+                }
+            }
+        }
+        printMessage(1,"unable to get correct reply from the server %s!\n",remote.c_str());
+
+        return false;
+    }
+    else
+        return false;
+}
+
+/************************************************************************/
+bool KinectWrapperClient::reconfigure(const Property &options)
+{
+    if (opening && !noRpc)
+    {
+        Property &opt=const_cast<Property&>(options);
+        Bottle cmd,reply;
+        cmd.addString(KINECT_TAGS_CMD_RECONFIGURE);
+        cmd.append(Bottle(opt.toString().c_str()));
+
+        if (rpc.write(cmd,reply))
+        {
+            if (reply.size()>0)
+            {
+                if (reply.get(0).asString()==KINECT_TAGS_CMD_ACK)
+                    return true;
+            }
+        }
+        printMessage(1,"the server %s refused the new configuration\n",remote.c_str());
+
+        return false;
+    }
+    else
+        return false;
+}
+
+/************************************************************************/
+bool KinectWrapperClient::getFrameStats(Property &stats)
+{
+    if (opening)
+    {
+        Property server;
+        if (!noRpc)
+        {
+            Bottle cmd,reply;
+            cmd.addString(KINECT_TAGS_CMD_GETFRAMESTATS);
+
+            if (rpc.write(cmd,reply) && (reply.size()>0) &&
+                (reply.get(0).asString()==KINECT_TAGS_CMD_ACK))
+                server.fromString(reply.tail().toString());
+            else
+                printMessage(1,"the server %s does not provide frame statistics\n",remote.c_str());
+
+            //frames not sent on purpose to this subscriber are not skipped
+            if (subscribed)
+            {
+                cmd.clear();
+                reply.clear();
+                cmd.addString(KINECT_TAGS_CMD_GETSUBSCRIPTION);
+                cmd.addString(local.c_str());
+                if (rpc.write(cmd,reply) && (reply.size()>4) && (reply.get(0).asString()==KINECT_TAGS_CMD_ACK))
+                    statsD.withheld=statsI.withheld=(unsigned int)reply.get(4).asInt();
+            }
+        }
+
+        const char *names[]={"depth","rgb","joints"};
+        const FrameStats *streams[]={&statsD,&statsI,&statsS};
+
+        stats.clear();
+        for (int i=0; i<3; i++)
+        {
+            Bottle &group=stats.addGroup(names[i]);
+            Bottle &serverGroup=server.findGroup(names[i]);
+            if (!serverGroup.isNull())
+                group.append(serverGroup.tail());
+            streams[i]->clientToBottle(group);
+        }
+
+        return true;
+    }
+    else
+        return false;
+}
+
 /************************************************************************/
 bool KinectWrapperClient::getFocalLength(double &focallength)
 {
@@ -0,0 +1,328 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <cmath>
+#include <algorithm>
+
+#include <kinectWrapper/kinectClock.h>
+#include <kinectWrapper/kinectLog.h>
+#include <kinectWrapper/kinectSkeleton.h>
+#include <kinectWrapper/kinectWrapper_multiClient.h>
+
+using namespace std;
+using namespace yarp::os;
+using namespace yarp::sig;
+using namespace kinectWrapper;
+
+namespace
+{
+
+/************************************************************************/
+double getTimestamp(Stamp &ts)
+{
+    return (ts.isValid()?ts.getTime():monotonicTime());
+}
+
+/************************************************************************/
+template <class T>
+const T *findClosest(const deque<T> &samples, const double timestamp, const double tolerance)
+{
+    const T *closest=NULL;
+    double best=tolerance;
+    for (size_t i=0; i<samples.size(); i++)
+    {
+        double dt=fabs(samples[i].timestamp-timestamp);
+        if (dt<=best)
+        {
+            best=dt;
+            closest=&samples[i];
+        }
+    }
+    return closest;
+}
+
+} //end unnamed namespace
+
+/************************************************************************/
+void KinectWrapperMultiClient::DepthReader::onRead(ImageOf<PixelMono16> &img)
+{
+    DepthSample sample;
+    Stamp ts;
+    getEnvelope(ts);
+    sample.timestamp=getTimestamp(ts);
+    sample.depth.resize(img.width(),img.height());
+    sample.players.resize(img.height(),img.width());
+    for (int v=0; v<img.height(); v++)
+    {
+        const unsigned short *in=(const unsigned short*)img.getRow(v);
+        unsigned short *out=(unsigned short*)sample.depth.getRow(v);
+        double *players=sample.players[v];
+        for (int u=0; u<img.width(); u++)
+        {
+            //depth in the 13 most significant bits, player in the others
+            out[u]=in[u]>>3;
+            players[u]=in[u]&0x0007;
+        }
+    }
+
+    remote.mutex.wait();
+    remote.depth.push_back(sample);
+    if (remote.depth.size()>remote.history)
+        remote.depth.pop_front();
+    remote.mutex.post();
+}
+
+/************************************************************************/
+void KinectWrapperMultiClient::RgbReader::onRead(ImageOf<PixelRgb> &img)
+{
+    RgbSample sample;
+    Stamp ts;
+    getEnvelope(ts);
+    sample.timestamp=getTimestamp(ts);
+    sample.rgb=img;
+
+    remote.mutex.wait();
+    remote.rgb.push_back(sample);
+    if (remote.rgb.size()>remote.history)
+        remote.rgb.pop_front();
+    remote.mutex.post();
+}
+
+/************************************************************************/
+void KinectWrapperMultiClient::JointsReader::onRead(Bottle &skeleton)
+{
+    JointsSample sample;
+    Stamp ts;
+    getEnvelope(ts);
+    sample.timestamp=getTimestamp(ts);
+    parseSkeleton(skeleton,sample.joints);
+
+    remote.mutex.wait();
+    remote.joints.push_back(sample);
+    if (remote.joints.size()>remote.history)
+        remote.joints.pop_front();
+    remote.mutex.post();
+}
+
+/************************************************************************/
+KinectWrapperMultiClient::KinectWrapperMultiClient()
+{
+    opening=false;
+    verbosity=0;
+    tolerance=0.02;
+    lastReference=-1.0;
+}
+
+/************************************************************************/
+KinectWrapperMultiClient::~KinectWrapperMultiClient()
+{
+    if (opening)
+        close();
+}
+
+/************************************************************************/
+int KinectWrapperMultiClient::printMessage(const int level, const char *format, ...) const
+{
+    if (verbosity>=level)
+    {
+        //the console is written by the logger thread, not by the caller
+        char prefix[128];
+        snprintf(prefix,sizeof(prefix),"*** %s: ",local.c_str());
+
+        va_list ap;
+        va_start(ap,format);
+        int ret=Logger::vprint(prefix,format,ap);
+        va_end(ap);
+
+        return ret;
+    }
+    else
+        return -1;
+}
+
+/************************************************************************/
+bool KinectWrapperMultiClient::open(const Property &options)
+{
+    Property &opt=const_cast<Property&>(options);
+
+    verbosity=opt.check("verbosity",Value(0)).asInt();
+    local=opt.check("local",Value("kinectMultiClient")).asString().c_str();
+    carrier=opt.check("carrier",Value("udp")).asString().c_str();
+    tolerance=opt.check("tolerance",Value(0.02)).asDouble();
+    int history=std::max(opt.check("history",Value(5)).asInt(),1);
+    lastReference=-1.0;
+
+    Bottle *names=opt.find("remotes").asList();
+    if ((names==NULL) || (names->size()==0))
+    {
+        printMessage(1,"no remotes given\n");
+        return false;
+    }
+
+    bool ok=true;
+    for (int i=0; i<names->size(); i++)
+    {
+        Remote *remote=new Remote;
+        remote->name=names->get(i).asString().c_str();
+        remote->history=history;
+        remotes.push_back(remote);
+
+        char stem[256];
+        sprintf(stem,"/%s/%d",local.c_str(),i);
+        string prefix=stem;
+        string server="/"+remote->name;
+
+        remote->depthPort.useCallback();
+        remote->depthPort.open((prefix+"/depth:i").c_str());
+        if (!Network::connect((server+"/depth:o").c_str(),remote->depthPort.getName().c_str(),carrier.c_str()))
+        {
+            printMessage(1,"unable to connect to the server %s!\n",remote->name.c_str());
+            ok=false;
+        }
+
+        remote->useRgb=Network::exists((server+"/image:o").c_str());
+        if (remote->useRgb)
+        {
+            remote->imagePort.useCallback();
+            remote->imagePort.open((prefix+"/image:i").c_str());
+            Network::connect((server+"/image:o").c_str(),remote->imagePort.getName().c_str(),carrier.c_str());
+        }
+
+        remote->useJoints=Network::exists((server+"/joints:o").c_str());
+        if (remote->useJoints)
+        {
+            remote->jointsPort.useCallback();
+            remote->jointsPort.open((prefix+"/joints:i").c_str());
+            Network::connect((server+"/joints:o").c_str(),remote->jointsPort.getName().c_str(),carrier.c_str());
+        }
+    }
+
+    opening=true;
+    if (!ok)
+    {
+        close();
+        return false;
+    }
+
+    printMessage(1,"connected to %d servers\n",(int)remotes.size());
+    return true;
+}
+
+/************************************************************************/
+bool KinectWrapperMultiClient::isOpen()
+{
+    return opening;
+}
+
+/************************************************************************/
+void KinectWrapperMultiClient::close()
+{
+    if (opening)
+    {
+        for (size_t i=0; i<remotes.size(); i++)
+        {
+            Remote *remote=remotes[i];
+            remote->depthPort.interrupt();
+            remote->depthPort.close();
+            if (remote->useRgb)
+            {
+                remote->imagePort.interrupt();
+                remote->imagePort.close();
+            }
+            if (remote->useJoints)
+            {
+                remote->jointsPort.interrupt();
+                remote->jointsPort.close();
+            }
+            delete remote;
+        }
+        remotes.clear();
+
+        opening=false;
+        printMessage(1,"client closed\n");
+    }
+    else
+        printMessage(3,"client is already closed\n");
+
+    Logger::shutdown();
+}
+
+/************************************************************************/
+bool KinectWrapperMultiClient::getFrames(vector<KinectFrame> &frames)
+{
+    if (!opening)
+    {
+        printMessage(1,"client is not open\n");
+        return false;
+    }
+
+    for (size_t i=0; i<remotes.size(); i++)
+        remotes[i]->mutex.wait();
+
+    //the reference is the most recent time reached by all the servers
+    bool ok=true;
+    double reference=0.0;
+    for (size_t i=0; ok && (i<remotes.size()); i++)
+    {
+        if (remotes[i]->depth.empty())
+            ok=false;
+        else if ((i==0) || (remotes[i]->depth.back().timestamp<reference))
+            reference=remotes[i]->depth.back().timestamp;
+    }
+    ok=ok && (reference>lastReference);
+
+    vector<const DepthSample*> depth(remotes.size(),(const DepthSample*)NULL);
+    for (size_t i=0; ok && (i<remotes.size()); i++)
+        ok=((depth[i]=findClosest(remotes[i]->depth,reference,tolerance))!=NULL);
+
+    if (ok)
+    {
+        frames.resize(remotes.size());
+        for (size_t i=0; i<remotes.size(); i++)
+        {
+            KinectFrame &frame=frames[i];
+            frame.remote=remotes[i]->name;
+            frame.timestamp=depth[i]->timestamp;
+            frame.depth=depth[i]->depth;
+            frame.players=depth[i]->players;
+
+            const RgbSample *rgb=findClosest(remotes[i]->rgb,frame.timestamp,tolerance);
+            frame.hasRgb=(rgb!=NULL);
+            if (frame.hasRgb)
+            {
+                frame.rgbTimestamp=rgb->timestamp;
+                frame.rgb=rgb->rgb;
+            }
+
+            const JointsSample *joints=findClosest(remotes[i]->joints,frame.timestamp,tolerance);
+            frame.hasJoints=(joints!=NULL);
+            if (frame.hasJoints)
+            {
+                frame.jointsTimestamp=joints->timestamp;
+                frame.joints=joints->joints;
+            }
+        }
+        lastReference=reference;
+    }
+
+    for (size_t i=0; i<remotes.size(); i++)
+        remotes[i]->mutex.post();
+
+    return ok;
+}
@@ -16,10 +16,12 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <math.h>
 #include <algorithm>
 
 #include <yarp/os/Time.h>
 #include <yarp/math/Math.h>
+#include <kinectWrapper/kinectSkeleton.h>
 #include <kinectWrapper/kinectWrapper_server.h>
 
 using namespace std;
@@ -27,8 +29,58 @@ using namespace yarp::os;
 using namespace yarp::sig;
 using namespace kinectWrapper;
 
+namespace
+{
+
+/************************************************************************/
+bool readValues(const Bottle &group, const string &key, double *values, const int n)
+{
+    Bottle *list=group.find(key.c_str()).asList();
+    if (list==NULL)
+        return false;
+    if (list->size()!=n)
+        return false;
+    for (int i=0; i<n; i++)
+        values[i]=list->get(i).asDouble();
+    return true;
+}
+
 /************************************************************************/
-KinectWrapperServer::KinectWrapperServer() : RateThread(30)
+int streamsMask(const string &info)
+{
+    //depth=1, players=2, rgb=4, joints=8
+    if (info==KINECT_TAGS_ALL_INFO)
+        return 15;
+    else if (info==KINECT_TAGS_DEPTH)
+        return 1;
+    else if (info==KINECT_TAGS_DEPTH_PLAYERS)
+        return 3;
+    else if (info==KINECT_TAGS_DEPTH_RGB)
+        return 5;
+    else if (info==KINECT_TAGS_DEPTH_RGB_PLAYERS)
+        return 7;
+    else if (info==KINECT_TAGS_DEPTH_JOINTS)
+        return 9;
+    else
+        return -1;
+}
+
+} //end unnamed namespace
+
+/************************************************************************/
+TelemetryThread::TelemetryThread(KinectWrapperServer *server) :
+                                 RateThread(1000), server(server)
+{
+}
+
+/************************************************************************/
+void TelemetryThread::run()
+{
+    server->writeTelemetry();
+}
+
+/************************************************************************/
+KinectWrapperServer::KinectWrapperServer() : RateThread(30), telemetry(this)
 {
     opening=false;
     name="";
@@ -48,20 +100,21 @@ bool KinectWrapperServer::read(ConnectionReader &connection)
     Bottle cmd, reply;
     cmd.read(connection);
 
+    //yarp serves every rpc connection with its own thread
+    mutexStats.wait();
+    rpcThreads.insert(currentThreadId());
+    mutexStats.post();
+
     if (cmd.size()==0)
         reply.addString(KINECT_TAGS_CMD_NACK);
     else
     {
         if (cmd.get(0).asString()==KINECT_TAGS_CMD_PING)
         {
+            mutexConfig.wait();
             reply.addString(KINECT_TAGS_CMD_ACK);
-            reply.addString(info.c_str());
-            reply.addInt(img_width);
-            reply.addInt(img_height);
-            reply.addString(seatedMode?KINECT_TAGS_SEATED_MODE:"null");
-            reply.addString(useSDK?"drawAll":"null");
-            reply.addInt(depth_width);
-            reply.addInt(depth_height);
+            fillInfo(reply);
+            mutexConfig.post();
         }
         else if (cmd.get(0).asString()==KINECT_TAGS_CMD_GET3DPOINT)
         {
@@ -78,6 +131,119 @@ bool KinectWrapperServer::read(ConnectionReader &connection)
             else
                 reply.addString(KINECT_TAGS_CMD_NACK);
         }
+        else if (cmd.get(0).asString()==KINECT_TAGS_CMD_GET3DPOINTS)
+        {
+            vector<pair<int,int> > pixels;
+            if (Bottle *list=cmd.get(1).asList())
+                for (int i=0; i+1<list->size(); i+=2)
+                    pixels.push_back(make_pair(list->get(i).asInt(),list->get(i+1).asInt()));
+
+            vector<yarp::sig::Vector> points3D;
+            if (get3DPoints(pixels,points3D))
+            {
+                reply.addString(KINECT_TAGS_CMD_ACK);
+                Bottle &points=reply.addList();
+                for (size_t i=0; i<points3D.size(); i++)
+                {
+                    points.addDouble(points3D[i][0]);
+                    points.addDouble(points3D[i][1]);
+                    points.addDouble(points3D[i][2]);
+                }
+            }
+            else
+                reply.addString(KINECT_TAGS_CMD_NACK);
+        }
+        else if (cmd.get(0).asString()==KINECT_TAGS_CMD_SETEXTRINSICS)
+        {
+            double H[16];
+            Bottle *list=cmd.get(1).asList();
+            bool ok=((list!=NULL) && (list->size()==16));
+            for (int i=0; ok && (i<16); i++)
+                H[i]=list->get(i).asDouble();
+
+            mutexExtrinsics.wait();
+            ok=ok && extrinsics.set(H);
+            mutexExtrinsics.post();
+            reply.addString(ok?KINECT_TAGS_CMD_ACK:KINECT_TAGS_CMD_NACK);
+        }
+        else if (cmd.get(0).asString()==KINECT_TAGS_CMD_GETEXTRINSICS)
+        {
+            double H[16];
+            getExtrinsicTransform().get(H);
+            reply.addString(KINECT_TAGS_CMD_ACK);
+            Bottle &list=reply.addList();
+            for (int i=0; i<16; i++)
+                list.addDouble(H[i]);
+        }
+        else if (cmd.get(0).asString()==KINECT_TAGS_CMD_RECONFIGURE)
+        {
+            Property options(cmd.tail().toString().c_str());
+            reply.addString(reconfigure(options)?KINECT_TAGS_CMD_ACK:KINECT_TAGS_CMD_NACK);
+        }
+        else if ((cmd.get(0).asString()==KINECT_TAGS_CMD_SUBSCRIBE) && (cmd.size()>1))
+        {
+            Property options(cmd.tail().tail().toString().c_str());
+            Bottle ports;
+            if (subscribe(cmd.get(1).asString().c_str(),options,ports))
+            {
+                reply.addString(KINECT_TAGS_CMD_ACK);
+                reply.append(ports);
+            }
+            else
+                reply.addString(KINECT_TAGS_CMD_NACK);
+        }
+        else if ((cmd.get(0).asString()==KINECT_TAGS_CMD_UNSUBSCRIBE) && (cmd.size()>1))
+        {
+            unsubscribe(cmd.get(1).asString().c_str());
+            reply.addString(KINECT_TAGS_CMD_ACK);
+        }
+        else if ((cmd.get(0).asString()==KINECT_TAGS_CMD_GETSUBSCRIPTION) && (cmd.size()>1))
+        {
+            mutexSubscriptions.wait();
+            map<string,Subscription*>::iterator it=subscriptions.find(cmd.get(1).asString().c_str());
+            if (it!=subscriptions.end())
+            {
+                reply.addString(KINECT_TAGS_CMD_ACK);
+                reply.addInt(it->second->getLevel());
+                reply.addInt(it->second->getDecimation());
+                reply.addInt(it->second->getScale());
+                reply.addInt((int)it->second->getWithheld());
+            }
+            else
+                reply.addString(KINECT_TAGS_CMD_NACK);
+            mutexSubscriptions.post();
+        }
+        else if (cmd.get(0).asString()==KINECT_TAGS_CMD_GETSHAREDMEMORY)
+        {
+            if (depthRing.isOpen())
+            {
+                reply.addString(KINECT_TAGS_CMD_ACK);
+                reply.addString(SharedFrameRing::getSegmentName(name,"depth").c_str());
+                reply.addString(rgbRing.isOpen()?SharedFrameRing::getSegmentName(name,"rgb").c_str():"null");
+            }
+            else
+                reply.addString(KINECT_TAGS_CMD_NACK);
+        }
+        else if (cmd.get(0).asString()==KINECT_TAGS_CMD_GETFRAMESTATS)
+        {
+            Property stats;
+            getFrameStats(stats);
+            reply.addString(KINECT_TAGS_CMD_ACK);
+            reply.append(Bottle(stats.toString().c_str()));
+        }
+        else if (cmd.get(0).asString()==KINECT_TAGS_CMD_TRACE)
+        {
+            string fileName=(cmd.size()>1)?cmd.get(1).asString().c_str():traceFile;
+            reply.addString(!fileName.empty() && Tracer::dump(fileName)?
+                            KINECT_TAGS_CMD_ACK:KINECT_TAGS_CMD_NACK);
+        }
+        else if (cmd.get(0).asString()==KINECT_TAGS_CMD_STATS)
+        {
+            reply.addString(KINECT_TAGS_CMD_ACK);
+            getStageStats(reply);
+            if ((cmd.size()>1) && (cmd.get(1).asString()=="reset"))
+                clearStageStats();
+        }
         else if (cmd.get(0).asString()==KINECT_TAGS_CMD_GETFOCALLENGTH) {
             double focal_length;
             if(getFocalLength(focal_length)) {
@@ -101,11 +267,13 @@ int KinectWrapperServer::printMessage(const int level, const char *format, ...)
 {
     if (verbosity>=level)
     {
-        fprintf(stdout,"*** %s: ",name.c_str());
+        //the console is written by the logger thread, not by the caller
+        char prefix[128];
+        snprintf(prefix,sizeof(prefix),"*** %s: ",name.c_str());
 
         va_list ap;
         va_start(ap,format);
-        int ret=vfprintf(stdout,format,ap);
+        int ret=Logger::vprint(prefix,format,ap);
         va_end(ap);
 
         return ret;
@@ -124,38 +292,147 @@ bool KinectWrapperServer::open(const Property &options)
     name=opt.check("name",Value("kinectServer")).asString().c_str();
     period=opt.check("period",Value(30)).asInt();
     info=opt.check("info",Value(KINECT_TAGS_ALL_INFO)).asString().c_str();
+    openInfo=info;
     seatedMode=opt.check("seatedMode");
     img_width=opt.check("img_width",Value(320)).asInt();
     img_height=opt.check("img_height",Value(240)).asInt();
     depth_width=opt.check("depth_width",Value(320)).asInt();
     depth_height=opt.check("depth_height",Value(240)).asInt();
-
-    buf=new unsigned short[depth_width*depth_height];
-    bufPl=new unsigned short[depth_width*depth_height];
-    bufF=new float[depth_width*depth_height];
-    bufFPl=new float[depth_width*depth_height];
-
+    publishCloud=opt.check("cloud");
+    publishVoxels=opt.check("voxels");
+    publishRgbd=opt.check("rgbd");
+    registerDepth=registerRgbd=false;
+    undistortDepth=undistortRgb=false;
+    hostClock=opt.check("host_clock");
+    multicast=opt.check("multicast");
+    traceFile=opt.check("trace",Value("")).asString().c_str();
+    frameTime=0.0;
+    configPending=false;
+    idD=idI=idS=-1;
+    clockD.reset();
+    clockI.reset();
+    clockS.reset();
+    clearStageStats();
+    publishTime=-1.0;
+    acquisitionCpu=0.0;
+    acquisitionThread=0;
+    rpcThreads.clear();
+    sampleD.clear();
+    sampleI.clear();
+    sampleS.clear();
+    publishLatency.clear();
+    telemetryTime=0.0;
+    telemetryCpuThreads.clear();
+    newD=newI=newS=false;
+
+    allocateBuffers();
+
+    driver=NULL;
+    useSDK=false;
+    if (opt.check("synthetic"))
+        driver=new KinectDriverSynthetic();
+    else
+    {
 #ifdef __USE_SDK__
-    driver=new KinectDriverSDK();
+        driver=new KinectDriverSDK();
+        useSDK=true;
 #endif
 
 #ifdef __USE_OPENNI__
-    driver=new KinectDriverOpenNI();
+        driver=new KinectDriverOpenNI();
 #endif
+    }
+
+    if (driver==NULL)
+    {
+        Logger::print("No Kinect library available, only synthetic frames can be served\n");
+        return false;
+    }
 
     if (!driver->initialize(opt))
     {
-        fprintf(stdout, "Kinect failed to initialize\n");
+        Logger::print("Kinect failed to initialize\n");
+        delete driver;
+        driver=NULL;
         return false;
     }
 
-#ifdef __USE_SDK__
-    useSDK=true;
-#endif
+    if (Bottle *b=opt.find("extrinsics").asList())
+    {
+        double H[16];
+        bool ok=(b->size()==16);
+        for (int i=0; ok && (i<16); i++)
+            H[i]=b->get(i).asDouble();
+        if (!ok || !extrinsics.set(H))
+            printMessage(1,"wrong extrinsics, 3D outputs will be given in the camera frame\n");
+    }
 
-#ifdef __USE_OPENNI__
-    useSDK=false;
-#endif
+    Bottle &depthUndistortionGroup=opt.findGroup("depth_undistortion");
+    if (!depthUndistortionGroup.isNull())
+    {
+        undistortDepth=configureUndistortion(depthUndistortionGroup,depthUndistortion,
+                                             depth_width,depth_height,false);
+        if (!undistortDepth)
+            printMessage(1,"wrong depth undistortion configuration, depth will not be undistorted\n");
+    }
+
+    Bottle &rgbUndistortionGroup=opt.findGroup("rgb_undistortion");
+    if (!rgbUndistortionGroup.isNull())
+    {
+        undistortRgb=configureUndistortion(rgbUndistortionGroup,rgbUndistortion,
+                                           img_width,img_height,true);
+        if (!undistortRgb)
+            printMessage(1,"wrong rgb undistortion configuration, rgb will not be undistorted\n");
+    }
+
+    Bottle &registrationGroup=opt.findGroup("registration");
+    if (!registrationGroup.isNull())
+    {
+        if (driver->isDepthRegistered())
+            printMessage(1,"depth is already aligned with rgb by the driver\n");
+        else if (!configureRegistration(registrationGroup))
+            printMessage(1,"wrong registration configuration, depth will not be aligned with rgb\n");
+    }
+
+    //once depth is remapped, the projector also serves the 3D point requests
+    if ((publishCloud || publishVoxels || registerDepth || undistortDepth) && !setupProjector())
+    {
+        printMessage(1,"unable to retrieve the projection factors, no cloud will be streamed\n");
+        publishCloud=publishVoxels=false;
+    }
+
+    if (publishCloud)
+        cloudPort.open(("/"+name+"/cloud:o").c_str());
+
+    if (publishRgbd)
+    {
+        if ((streamsMask(info)&4)!=0)
+            rgbdPort.open(("/"+name+"/rgbd:o").c_str());
+        else
+        {
+            printMessage(1,"rgb is not acquired with info %s, no rgbd pairs will be streamed\n",info.c_str());
+            publishRgbd=false;
+        }
+    }
+
+    if (publishVoxels)
+    {
+        double box[6]={-1.0, 1.0, -1.0, 1.0, 0.0, 3.0};
+        if (Bottle *b=opt.find("voxel_box").asList())
+            if (b->size()==6)
+                for (int i=0; i<6; i++)
+                    box[i]=b->get(i).asDouble();
+        double voxelSize=opt.check("voxel_size",Value(0.02)).asDouble();
+        int voxelBands=opt.check("voxel_bands",Value(1)).asInt();
+
+        if (voxelGrid.configure(box,voxelSize,voxelBands))
+            voxelsPort.open(("/"+name+"/voxels:o").c_str());
+        else
+        {
+            printMessage(1,"wrong voxel grid configuration, no voxels will be streamed\n");
+            publishVoxels=false;
+        }
+    }
 
     if (info==KINECT_TAGS_ALL_INFO)
     {
@@ -170,208 +447,956 @@ bool KinectWrapperServer::open(const Property &options)
     rpc.open(("/"+name+"/rpc").c_str());
     rpc.setReader(*this);
     depthPort.open(("/"+name+"/depth:o").c_str());
+    infoPort.open(("/"+name+"/info:o").c_str());
+    statsPort.open(("/"+name+"/stats:o").c_str());
 
-    depthCV=cvCreateImageHeader(cvSize(depth_width,depth_height),IPL_DEPTH_16U,1);
-    depthCVPl=cvCreateImageHeader(cvSize(depth_width,depth_height),IPL_DEPTH_16U,1);
-    depthFCV=cvCreateImageHeader(cvSize(depth_width,depth_height),IPL_DEPTH_32F,1);
-    depthFCVPl=cvCreateImageHeader(cvSize(depth_width,depth_height),IPL_DEPTH_32F,1);
-    playersImage=cvCreateImage(cvSize(depth_width,depth_height),IPL_DEPTH_8U,3);
-    skeletonImage=cvCreateImage(cvSize(depth_width,depth_height),IPL_DEPTH_8U,3);
     depthTmp=cvCreateImage(cvSize(depth_width,depth_height),IPL_DEPTH_16U,1);
-    depthToShow=cvCreateImage(cvSize(depth_width,depth_height),IPL_DEPTH_32F,1);
+
+    if (opt.check("shmem"))
+        openSharedMemory(opt.check("shmem_slots",Value(4)).asInt());
 
     depth.resize(depth_width, depth_height);
     image.resize(img_width, img_height);
+    imageRaw.resize(img_width, img_height);
 
     setRate(period);
     start();
+    telemetry.start();
 
     printMessage(1,"server successfully open\n");
 
     return opening=true;
 }
 
+/************************************************************************/
+void KinectWrapperServer::allocateBuffers()
+{
+    buf=new unsigned short[depth_width*depth_height];
+    bufPl=new unsigned short[depth_width*depth_height];
+    bufF=new float[depth_width*depth_height];
+    bufFPl=new float[depth_width*depth_height];
+
+    depthCV=cvCreateImageHeader(cvSize(depth_width,depth_height),IPL_DEPTH_16U,1);
+    depthCVPl=cvCreateImageHeader(cvSize(depth_width,depth_height),IPL_DEPTH_16U,1);
+    depthFCV=cvCreateImageHeader(cvSize(depth_width,depth_height),IPL_DEPTH_32F,1);
+    depthFCVPl=cvCreateImageHeader(cvSize(depth_width,depth_height),IPL_DEPTH_32F,1);
+    playersImage=cvCreateImage(cvSize(depth_width,depth_height),IPL_DEPTH_8U,3);
+    skeletonImage=cvCreateImage(cvSize(depth_width,depth_height),IPL_DEPTH_8U,3);
+    depthToShow=cvCreateImage(cvSize(depth_width,depth_height),IPL_DEPTH_32F,1);
+}
+
+/************************************************************************/
+void KinectWrapperServer::releaseBuffers()
+{
+    cvReleaseImageHeader(&depthCV);
+    cvReleaseImageHeader(&depthCVPl);
+    cvReleaseImageHeader(&depthFCV);
+    cvReleaseImageHeader(&depthFCVPl);
+    cvReleaseImage(&playersImage);
+    cvReleaseImage(&skeletonImage);
+    cvReleaseImage(&depthToShow);
+
+    delete[] buf;
+    delete[] bufPl;
+    delete[] bufF;
+    delete[] bufFPl;
+}
+
+/************************************************************************/
+bool KinectWrapperServer::setupProjector()
+{
+    //once registered, depth pixels live in the rgb camera
+    if (registerDepth)
+    {
+        double intrinsics[4];
+        registration.getRgbIntrinsics(intrinsics);
+        projector.setupPinhole(depth_width,depth_height,intrinsics);
+        return true;
+    }
+
+    double xzFactor,yzFactor;
+    if (!driver->getProjectionFactors(xzFactor,yzFactor))
+        return false;
+
+    projector.setup(depth_width,depth_height,xzFactor,yzFactor);
+    return true;
+}
+
+/************************************************************************/
+void KinectWrapperServer::fillInfo(Bottle &b)
+{
+    b.addString(info.c_str());
+    b.addInt(img_width);
+    b.addInt(img_height);
+    b.addString(seatedMode?KINECT_TAGS_SEATED_MODE:"null");
+    b.addString(useSDK?"drawAll":"null");
+    b.addInt(depth_width);
+    b.addInt(depth_height);
+    b.addInt(period);
+    b.addString(multicast?"mcast":"null");
+}
+
+/************************************************************************/
+bool KinectWrapperServer::reconfigure(const Property &options)
+{
+    Property &opt=const_cast<Property&>(options);
+
+    if (!opening)
+        return false;
+
+    if (opt.check("info"))
+    {
+        int mask=streamsMask(opt.find("info").asString().c_str());
+        if ((mask<0) || ((mask&~streamsMask(openInfo))!=0))
+        {
+            printMessage(1,"info %s is not available, the server was opened with %s\n",
+                         opt.find("info").asString().c_str(),openInfo.c_str());
+            return false;
+        }
+    }
+
+    const char *keys[]={"img_width", "img_height", "depth_width", "depth_height", "period"};
+    for (int i=0; i<5; i++)
+    {
+        if (opt.check(keys[i]) && (opt.find(keys[i]).asInt()<=0))
+        {
+            printMessage(1,"wrong %s\n",keys[i]);
+            return false;
+        }
+    }
+
+    //the remap and registration tables are built for the resolution given at start-up
+    bool depthResized=(opt.check("depth_width",Value(depth_width)).asInt()!=depth_width) ||
+                      (opt.check("depth_height",Value(depth_height)).asInt()!=depth_height);
+    bool rgbResized=(opt.check("img_width",Value(img_width)).asInt()!=img_width) ||
+                    (opt.check("img_height",Value(img_height)).asInt()!=img_height);
+    if ((depthResized && (registerDepth || registerRgbd || undistortDepth)) || (rgbResized && undistortRgb))
+    {
+        printMessage(1,"the resolution cannot be changed while registration or undistortion is active\n");
+        return false;
+    }
+
+    mutexConfig.wait();
+    pendingConfig.fromString(opt.toString(),false);
+    configPending=true;
+    mutexConfig.post();
+
+    return true;
+}
+
+/************************************************************************/
+void KinectWrapperServer::applyConfiguration()
+{
+    mutexConfig.wait();
+    if (!configPending)
+    {
+        mutexConfig.post();
+        return;
+    }
+
+    int newImgWidth=pendingConfig.check("img_width",Value(img_width)).asInt();
+    int newImgHeight=pendingConfig.check("img_height",Value(img_height)).asInt();
+    int newDepthWidth=pendingConfig.check("depth_width",Value(depth_width)).asInt();
+    int newDepthHeight=pendingConfig.check("depth_height",Value(depth_height)).asInt();
+
+    //no frame is being read here, getters are kept out until buffers are swapped
+    mutexDepth.wait();
+    mutexRgb.wait();
+    mutexSkeleton.wait();
+
+    if ((newImgWidth!=img_width) || (newImgHeight!=img_height) ||
+        (newDepthWidth!=depth_width) || (newDepthHeight!=depth_height))
+    {
+        if (driver->setResolution(newImgWidth,newImgHeight,newDepthWidth,newDepthHeight))
+        {
+            img_width=newImgWidth;
+            img_height=newImgHeight;
+            image.resize(img_width,img_height);
+            imageRaw.resize(img_width,img_height);
+
+            if ((newDepthWidth!=depth_width) || (newDepthHeight!=depth_height))
+            {
+                releaseBuffers();
+                depth_width=newDepthWidth;
+                depth_height=newDepthHeight;
+                allocateBuffers();
+                depth.resize(depth_width,depth_height);
+
+                if (publishCloud || publishVoxels)
+                    setupProjector();
+            }
+
+            printMessage(1,"resolution set to rgb %dx%d, depth %dx%d\n",
+                         img_width,img_height,depth_width,depth_height);
+        }
+        else
+            printMessage(1,"resolution rgb %dx%d, depth %dx%d not supported by the driver\n",
+                         newImgWidth,newImgHeight,newDepthWidth,newDepthHeight);
+    }
+
+    if (pendingConfig.check("info"))
+    {
+        info=pendingConfig.find("info").asString().c_str();
+        skeleton.clear();
+        printMessage(1,"info set to %s\n",info.c_str());
+    }
+
+    mutexSkeleton.post();
+    mutexRgb.post();
+    mutexDepth.post();
+
+    if (pendingConfig.check("period"))
+    {
+        period=pendingConfig.find("period").asInt();
+        setRate(period);
+        printMessage(1,"period set to %d [ms]\n",period);
+    }
+
+    pendingConfig.clear();
+    configPending=false;
+
+    if (infoPort.getOutputCount()>0)
+    {
+        Bottle &b=infoPort.prepare();
+        b.clear();
+        fillInfo(b);
+        infoPort.write();
+    }
+
+    mutexConfig.post();
+}
+
+/************************************************************************/
+bool KinectWrapperServer::configureRegistration(const Bottle &group)
+{
+    double depthIntrinsics[4],rgbIntrinsics[4];
+    if (!readValues(group,"depth_intrinsics",depthIntrinsics,4) ||
+        !readValues(group,"rgb_intrinsics",rgbIntrinsics,4))
+        return false;
+
+    double rotation[9]={1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0};
+    double translation[3]={0.0, 0.0, 0.0};
+    readValues(group,"rotation",rotation,9);
+    readValues(group,"translation",translation,3);
+
+    //rgb intrinsics refer to the rgb image, but the registered
+    //depth keeps the size of the depth image
+    double sx=(double)depth_width/img_width;
+    double sy=(double)depth_height/img_height;
+    rgbIntrinsics[0]*=sx;
+    rgbIntrinsics[1]*=sy;
+    rgbIntrinsics[2]*=sx;
+    rgbIntrinsics[3]*=sy;
+
+    if (!registration.setup(depth_width,depth_height,depthIntrinsics,
+                            depth_width,depth_height,rgbIntrinsics,
+                            rotation,translation))
+        return false;
+
+    if (group.check("rgbd_only"))
+    {
+        registerRgbd=true;
+        printMessage(1,"depth will be aligned with rgb in software within the rgbd pairs\n");
+    }
+    else
+    {
+        registerDepth=true;
+        printMessage(1,"depth will be aligned with rgb in software\n");
+    }
+
+    return true;
+}
+
+/************************************************************************/
+bool KinectWrapperServer::configureUndistortion(const Bottle &group, Undistortion &undistortion,
+                                                const int width, const int height, const bool bilinear)
+{
+    double intrinsics[4];
+    double distortion[5]={0.0, 0.0, 0.0, 0.0, 0.0};
+    if (!readValues(group,"intrinsics",intrinsics,4))
+        return false;
+
+    //k3 is often omitted
+    if (!readValues(group,"distortion",distortion,5) &&
+        !readValues(group,"distortion",distortion,4))
+        return false;
+
+    return undistortion.setup(width,height,intrinsics,distortion,bilinear);
+}
+
+/************************************************************************/
+bool KinectWrapperServer::readDepth()
+{
+    bool processed=(undistortDepth || registerDepth);
+    if (!driver->readDepth(processed?depthRaw:depth,timestampD))
+        return false;
+    timestampD=hostClock?frameTime:clockD.map(timestampD,frameTime);
+    idD=statsD.acquire();
+    newD=true;
+
+    if (!processed)
+        return true;
+    else if (!registerDepth)
+        return depthUndistortion.apply(depthRaw,depth);
+    else if (!undistortDepth)
+        return registration.apply(depthRaw,depth);
+
+    //registration assumes a pinhole depth camera
+    if (!depthUndistortion.apply(depthRaw,depthUndistorted))
+        return false;
+
+    return registration.apply(depthUndistorted,depth);
+}
+
+/************************************************************************/
+bool KinectWrapperServer::readRgb()
+{
+    if (!driver->readRgb(undistortRgb?imageRaw:image,timestampI))
+        return false;
+    timestampI=hostClock?frameTime:clockI.map(timestampI,frameTime);
+    idI=statsI.acquire();
+    newI=true;
+
+    return (!undistortRgb || rgbUndistortion.apply(imageRaw,image));
+}
+
+/************************************************************************/
+bool KinectWrapperServer::readSkeleton()
+{
+    skeleton.clear();
+    if (!driver->readSkeleton(&skeleton,timestampS))
+        return false;
+    timestampS=hostClock?frameTime:clockS.map(timestampS,frameTime);
+    idS=statsS.acquire();
+    newS=true;
+
+    getExtrinsicTransform().apply(skeleton);
+    return true;
+}
+
+/************************************************************************/
+ExtrinsicTransform KinectWrapperServer::getExtrinsicTransform()
+{
+    mutexExtrinsics.wait();
+    ExtrinsicTransform H=extrinsics;
+    mutexExtrinsics.post();
+    return H;
+}
+
+/************************************************************************/
+bool KinectWrapperServer::threadInit()
+{
+    mutexStats.wait();
+    acquisitionThread=currentThreadId();
+    mutexStats.post();
+    return true;
+}
+
 /************************************************************************/
 void KinectWrapperServer::threadRelease()
 {
-    if (info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_RGB || info==KINECT_TAGS_DEPTH_RGB_PLAYERS)
+    if (openInfo==KINECT_TAGS_ALL_INFO || openInfo==KINECT_TAGS_DEPTH_RGB || openInfo==KINECT_TAGS_DEPTH_RGB_PLAYERS)
     {
         imagePort.interrupt();
         imagePort.close();
     }
 
-    if (info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_JOINTS)
+    if (openInfo==KINECT_TAGS_ALL_INFO || openInfo==KINECT_TAGS_DEPTH_JOINTS)
     {
         jointsPort.interrupt();
         jointsPort.close();
     }
 
+    if (publishCloud)
+    {
+        cloudPort.interrupt();
+        cloudPort.close();
+    }
+
+    if (publishVoxels)
+    {
+        voxelsPort.interrupt();
+        voxelsPort.close();
+    }
+
+    if (publishRgbd)
+    {
+        rgbdPort.interrupt();
+        rgbdPort.close();
+    }
+
     depthPort.interrupt();
     depthPort.close();
 
+    infoPort.interrupt();
+    infoPort.close();
+
+    statsPort.interrupt();
+    statsPort.close();
+
     rpc.interrupt();
     rpc.close();
 
-    cvReleaseImageHeader(&depthCV);
-    cvReleaseImageHeader(&depthCVPl);
-    cvReleaseImageHeader(&depthFCV);
-    cvReleaseImageHeader(&depthFCVPl);
-    cvReleaseImage(&playersImage);
-    cvReleaseImage(&skeletonImage);
+    for (map<string,Subscription*>::iterator it=subscriptions.begin(); it!=subscriptions.end(); it++)
+    {
+        it->second->close();
+        delete it->second;
+    }
+    subscriptions.clear();
+
+    depthRing.close();
+    rgbRing.close();
+
+    releaseBuffers();
     cvReleaseImage(&depthTmp);
-    cvReleaseImage(&depthToShow);
 
     if (opening)
     {
         driver->close();
         delete driver;
     }
+}
+
+/************************************************************************/
+void KinectWrapperServer::close()
+{
+    if (opening)
+    {
+        //stats:o is closed by the acquisition thread
+        if (telemetry.isRunning())
+            telemetry.stop();
+        if (isRunning())
+            stop();
+
+        if (!traceFile.empty() && !Tracer::dump(traceFile))
+            printMessage(1,"unable to write the trace %s (is tracing compiled in?)\n",traceFile.c_str());
+
+        opening=false;
+    }
+    else
+        printMessage(3,"server is already closed\n");
+
+    Logger::shutdown();
+}
+
+/************************************************************************/
+void KinectWrapperServer::run()
+{
+    double tickStart=monotonicTime();
+    applyConfiguration();
+
+    //streams of the frame are read all together
+    //and then published once all of them are ready
+    int mask=streamsMask(info);
+    if (mask<0)
+        return;
+
+    double t0=monotonicTime();
+    driver->update();
+    //all the streams of the frame share the same host time, which is
+    //also common to all the servers running on the same host
+    frameTime=monotonicTime();
+    stageTime[STAGE_UPDATE]=frameTime-t0;
+    stageTime[STAGE_COPY]=stageTime[STAGE_WRITE]=0.0;
+    publishTime=-1.0;
+
+    mutexDepth.wait();
+    bool ready=readDepth();
+    mutexDepth.post();
+    double t1=monotonicTime();
+    stageTime[STAGE_READ_DEPTH]=t1-frameTime;
+    KINECT_TRACE_SPAN("update",idD,t0,frameTime);
+    KINECT_TRACE_SPAN("read_depth",idD,frameTime,t1);
+
+    if ((mask&4)!=0)
+    {
+        mutexRgb.wait();
+        ready&=readRgb();
+        mutexRgb.post();
+    }
+    double t2=monotonicTime();
+    stageTime[STAGE_READ_RGB]=((mask&4)!=0)?t2-t1:-1.0;
+    if ((mask&4)!=0)
+        KINECT_TRACE_SPAN("read_rgb",idI,t1,t2);
+
+    if ((mask&8)!=0)
+    {
+        mutexSkeleton.wait();
+        ready&=readSkeleton();
+        mutexSkeleton.post();
+    }
+    double t3=monotonicTime();
+    stageTime[STAGE_READ_SKELETON]=((mask&8)!=0)?t3-t2:-1.0;
+    if ((mask&8)!=0)
+        KINECT_TRACE_SPAN("read_skeleton",idS,t2,t3);
+
+    publishDepth(ready);
+
+    double t4=monotonicTime();
+    if (ready)
+    {
+        writeCloud();
+        writeVoxels();
+        writeRgbd();
+        writeSubscriptions();
+        writeSharedMemory();
+    }
+    double t5=monotonicTime();
+    stageTime[STAGE_PROCESS]=t5-t4;
+    KINECT_TRACE_SPAN("process",idD,t4,t5);
+
+    if ((mask&4)!=0)
+        publishRgb(ready);
 
-    delete[] buf;
-    delete[] bufPl;
-    delete[] bufF;
-    delete[] bufFPl;
+    if ((mask&8)!=0)
+        publishJoints(ready);
+
+    double tickEnd=monotonicTime();
+    updateStageStats(tickStart,tickEnd);
 }
 
 /************************************************************************/
-void KinectWrapperServer::close()
+void KinectWrapperServer::updateStageStats(const double tickStart, const double tickEnd)
 {
-    if (opening)
-    {
-        if (isRunning())
-            stop();
-
-        opening=false;
-    }
-    else
-        printMessage(3,"server is already closed\n");
+    mutexStats.wait();
+    //stages not run in the current configuration are marked as negative
+    for (int i=0; i<STAGE_COUNT; i++)
+        if (stageTime[i]>=0.0)
+            stageLatency[i].add(stageTime[i]);
+    tickLatency.add(tickEnd-tickStart);
+
+    //the jitter is the deviation of the interval between two ticks from the period
+    if (lastTick>0.0)
+        tickJitter.add(fabs(tickStart-lastTick-1e-3*period));
+    lastTick=tickStart;
+
+    ticks++;
+    if (tickEnd-tickStart>1e-3*period)
+        deadlineMisses++;
+
+    //samples for stats:o, which is written by the telemetry thread
+    if (publishTime>=0.0)
+        publishLatency.add(publishTime);
+    sampleD=statsD;
+    sampleI=statsI;
+    sampleS=statsS;
+    acquisitionCpu=threadCpuTime();
+    mutexStats.post();
 }
 
 /************************************************************************/
-void KinectWrapperServer::run()
+void KinectWrapperServer::writeTelemetry()
 {
-    driver->update();
-    if (info==KINECT_TAGS_ALL_INFO)
+    double now=monotonicTime();
+    double cpuProcess=processCpuTime();
+    vector<ThreadCpuTime> threads;
+    threadsCpuTime(threads);
+
+    //the samples are copied as they are and formatted out of the lock
+    mutexStats.wait();
+    FrameStats current[]={sampleD,sampleI,sampleS};
+    LatencyHistogram latency=publishLatency;
+    publishLatency.clear();
+    double cpuAcquisition=acquisitionCpu;
+    int acquisitionId=acquisitionThread;
+    set<int> rpcIds=rpcThreads;
+    mutexStats.post();
+
+    //the first call only takes the reference
+    double dt=now-telemetryTime;
+    if ((telemetryTime>0.0) && (dt>0.0) && (statsPort.getOutputCount()>0))
     {
-        mutexDepth.wait();
-        bool ready=driver->readDepth(depth, timestampD);
-        mutexDepth.post();
+        const char *names[]={"depth","rgb","joints"};
+        const FrameStats *previous[]={&telemetryD,&telemetryI,&telemetryS};
+        int clients[]={depthPort.getOutputCount(),imagePort.getOutputCount(),jointsPort.getOutputCount()};
 
-        mutexRgb.wait();
-        ready&=driver->readRgb(image, timestampI);
-        mutexRgb.post();
+        Bottle &b=statsPort.prepare();
+        b.clear();
+        for (int i=0; i<3; i++)
+        {
+            Bottle &stream=b.addList();
+            stream.addString(names[i]);
+            Bottle &fps=stream.addList();
+            fps.addString("fps");
+            fps.addDouble((current[i].published-previous[i]->published)/dt);
+            Bottle &bytes=stream.addList();
+            bytes.addString("bytes");
+            bytes.addDouble((current[i].bytes-previous[i]->bytes)/dt);
+            Bottle &dropped=stream.addList();
+            dropped.addString("dropped");
+            dropped.addInt((int)(current[i].unpublished-previous[i]->unpublished));
+            Bottle &unread=stream.addList();
+            unread.addString("unread");
+            unread.addInt((int)(current[i].unread-previous[i]->unread));
+            Bottle &readers=stream.addList();
+            readers.addString("clients");
+            readers.addInt(clients[i]);
+        }
 
-        mutexSkeleton.wait();
-        skeleton.clear();
-        ready&=driver->readSkeleton(&skeleton, timestampS);
-        mutexSkeleton.post();
+        Bottle &others=b.addList();
+        others.addString("clients");
+        Bottle &cloud=others.addList();
+        cloud.addString("cloud");
+        cloud.addInt(publishCloud?cloudPort.getOutputCount():0);
+        Bottle &voxels=others.addList();
+        voxels.addString("voxels");
+        voxels.addInt(publishVoxels?voxelsPort.getOutputCount():0);
+        Bottle &rgbd=others.addList();
+        rgbd.addString("rgbd");
+        rgbd.addInt(publishRgbd?rgbdPort.getOutputCount():0);
+        Bottle &subscribers=others.addList();
+        subscribers.addString("subscribers");
+        mutexSubscriptions.wait();
+        subscribers.addInt((int)subscriptions.size());
+        mutexSubscriptions.post();
+
+        Bottle &cpu=b.addList();
+        cpu.addString("cpu");
+        Bottle &acquisition=cpu.addList();
+        acquisition.addString("acquisition");
+        acquisition.addDouble(100.0*(cpuAcquisition-telemetryCpuAcquisition)/dt);
+        Bottle &process=cpu.addList();
+        process.addString("process");
+        process.addDouble(100.0*(cpuProcess-telemetryCpuProcess)/dt);
+
+        //threads started in the meanwhile are accounted from their start
+        Bottle &perThread=cpu.addList();
+        perThread.addString("threads");
+        int telemetryId=currentThreadId();
+        for (size_t i=0; i<threads.size(); i++)
+        {
+            map<int,double>::iterator it=telemetryCpuThreads.find(threads[i].id);
+            double last=(it!=telemetryCpuThreads.end())?it->second:0.0;
+
+            Bottle &thread=perThread.addList();
+            if (threads[i].id==acquisitionId)
+                thread.addString("acquisition");
+            else if (threads[i].id==telemetryId)
+                thread.addString("telemetry");
+            else if (rpcIds.find(threads[i].id)!=rpcIds.end())
+                thread.addString("rpc");
+            else
+                thread.addString(threads[i].name.c_str());
+            thread.addInt(threads[i].id);
+            thread.addDouble(100.0*(threads[i].time-last)/dt);
+        }
+
+        Bottle &publish=b.addList();
+        publish.addString("latency");
+        latency.toBottle(publish);
+
+        statsPort.write();
+    }
+
+    telemetryD=current[0];
+    telemetryI=current[1];
+    telemetryS=current[2];
+    telemetryTime=now;
+    telemetryCpuAcquisition=cpuAcquisition;
+    telemetryCpuProcess=cpuProcess;
+    telemetryCpuThreads.clear();
+    for (size_t i=0; i<threads.size(); i++)
+        telemetryCpuThreads[threads[i].id]=threads[i].time;
+
+    //forget the threads of the rpc connections already closed
+    if (!threads.empty())
+    {
+        mutexStats.wait();
+        for (set<int>::iterator it=rpcIds.begin(); it!=rpcIds.end(); it++)
+            if (telemetryCpuThreads.find(*it)==telemetryCpuThreads.end())
+                rpcThreads.erase(*it);
+        mutexStats.post();
+    }
+}
 
-        if (depthPort.getOutputCount()>0 && ready)
+/************************************************************************/
+void KinectWrapperServer::publishDepth(const bool ready)
+{
+    mutexDepth.wait();
+    if (newD)
+    {
+        //unread frames may still reach subscribers, shared memory and rgbd:o
+        if (!ready)
+            statsD.unpublished++;
+        else if (depthPort.getOutputCount()==0)
+            statsD.unread++;
+        else
         {
-            mutexDepth.wait();
+            double t0=monotonicTime();
             depthPort.prepare()=depth;
-            tsD.update(timestampD);
+            double t1=monotonicTime();
+            tsD=Stamp(idD,timestampD);
             depthPort.setEnvelope(tsD);
             depthPort.write();
-            mutexDepth.post();
+            double t2=monotonicTime();
+            stageTime[STAGE_COPY]+=t1-t0;
+            stageTime[STAGE_WRITE]+=t2-t1;
+            publishTime=t2-timestampD;
+            KINECT_TRACE_SPAN("publish_depth",idD,t0,t2);
+            statsD.published++;
+            statsD.bytes+=depth.getRawImageSize();
         }
+        newD=false;
+    }
+    mutexDepth.post();
+}
 
-        if (imagePort.getOutputCount()>0 && ready)
+/************************************************************************/
+void KinectWrapperServer::publishRgb(const bool ready)
+{
+    mutexRgb.wait();
+    if (newI)
+    {
+        if (!ready)
+            statsI.unpublished++;
+        else if (imagePort.getOutputCount()==0)
+            statsI.unread++;
+        else
         {
-            mutexRgb.wait();
+            double t0=monotonicTime();
             imagePort.prepare()=image;
-            tsI.update(timestampI);
+            double t1=monotonicTime();
+            tsI=Stamp(idI,timestampI);
             imagePort.setEnvelope(tsI);
             imagePort.write();
-            mutexRgb.post();
+            double t2=monotonicTime();
+            stageTime[STAGE_COPY]+=t1-t0;
+            stageTime[STAGE_WRITE]+=t2-t1;
+            KINECT_TRACE_SPAN("publish_rgb",idI,t0,t2);
+            statsI.published++;
+            statsI.bytes+=image.getRawImageSize();
         }
+        newI=false;
+    }
+    mutexRgb.post();
+}
 
-        if (jointsPort.getOutputCount()>0 && ready)
+/************************************************************************/
+void KinectWrapperServer::publishJoints(const bool ready)
+{
+    mutexSkeleton.wait();
+    if (newS)
+    {
+        if (!ready)
+            statsS.unpublished++;
+        else if (jointsPort.getOutputCount()==0)
+            statsS.unread++;
+        else
         {
-            mutexSkeleton.wait();
+            double t0=monotonicTime();
             jointsPort.prepare()=skeleton;
-            tsS.update(timestampS);
+            double t1=monotonicTime();
+            tsS=Stamp(idS,timestampS);
             jointsPort.setEnvelope(tsS);
             jointsPort.write();
-            mutexSkeleton.post();
+            double t2=monotonicTime();
+            stageTime[STAGE_COPY]+=t1-t0;
+            stageTime[STAGE_WRITE]+=t2-t1;
+            KINECT_TRACE_SPAN("publish_joints",idS,t0,t2);
+            statsS.published++;
         }
+        newS=false;
     }
-    else if (info==KINECT_TAGS_DEPTH_RGB || info==KINECT_TAGS_DEPTH_RGB_PLAYERS)
+    mutexSkeleton.post();
+}
+
+/************************************************************************/
+void KinectWrapperServer::writeCloud()
+{
+    if (publishCloud && cloudPort.getOutputCount()>0)
     {
         mutexDepth.wait();
-        bool ready=driver->readDepth(depth, timestampD);
+        ImageOf<PixelRgbFloat> &cloud=cloudPort.prepare();
+        if (projector.project(depth,cloud))
+        {
+            getExtrinsicTransform().apply(cloud);
+            tsC=Stamp(idD,timestampD);
+            cloudPort.setEnvelope(tsC);
+            cloudPort.write();
+        }
+        else
+            cloudPort.unprepare();
         mutexDepth.post();
+    }
+}
 
-        mutexRgb.wait();
-        ready&=driver->readRgb(image, timestampI);
-        mutexRgb.post();
-
-        if (depthPort.getOutputCount()>0 && ready)
+/************************************************************************/
+void KinectWrapperServer::writeVoxels()
+{
+    if (publishVoxels && voxelsPort.getOutputCount()>0)
+    {
+        mutexDepth.wait();
+        ImageOf<PixelRgbFloat> &centroids=voxelsPort.prepare();
+        if (voxelGrid.compute(depth,projector,centroids)>=0)
         {
-            mutexDepth.wait();
-            depthPort.prepare()=depth;
-            tsD.update(timestampD);
-            depthPort.setEnvelope(tsD);
-            depthPort.write();
-            mutexDepth.post();
+            getExtrinsicTransform().apply(centroids);
+            tsV=Stamp(idD,timestampD);
+            voxelsPort.setEnvelope(tsV);
+            voxelsPort.write();
         }
+        else
+            voxelsPort.unprepare();
+        mutexDepth.post();
+    }
+}
+
+/************************************************************************/
+bool KinectWrapperServer::fillRgbd(RgbdFrame &frame)
+{
+    if ((streamsMask(info)&4)==0)
+        return false;
+
+    bool ok=true;
+    mutexDepth.wait();
+    if (registerRgbd)
+        ok=registration.apply(depth,frame.depth);
+    else
+        frame.depth=depth;
+    frame.timestampDepth=timestampD;
+    mutexDepth.post();
+
+    mutexRgb.wait();
+    frame.rgb=image;
+    frame.timestampRgb=timestampI;
+    mutexRgb.post();
 
-        if (imagePort.getOutputCount()>0 && ready)
+    frame.registered=(registerDepth || registerRgbd || driver->isDepthRegistered());
+    return ok;
+}
+
+/************************************************************************/
+void KinectWrapperServer::writeRgbd()
+{
+    if (publishRgbd && rgbdPort.getOutputCount()>0)
+    {
+        RgbdFrame &frame=rgbdPort.prepare();
+        if (fillRgbd(frame))
         {
-            mutexRgb.wait();
-            imagePort.prepare()=image;
-            tsI.update(timestampI);
-            imagePort.setEnvelope(tsI);
-            imagePort.write();
-            mutexRgb.post();
+            tsR=Stamp(idD,frame.timestampDepth);
+            rgbdPort.setEnvelope(tsR);
+            rgbdPort.write();
         }
+        else
+            rgbdPort.unprepare();
     }
-    else if (info==KINECT_TAGS_DEPTH_JOINTS)
+}
+
+/************************************************************************/
+bool KinectWrapperServer::subscribe(const string &id, const Property &options, Bottle &reply)
+{
+    Property &opt=const_cast<Property&>(options);
+    bool adaptive=opt.check("adaptive");
+    int decimation=opt.check("decimation",Value(1)).asInt();
+    double maxRate=opt.check("max_rate",Value(0.0)).asDouble();
+
+    //a client coming back replaces its previous subscription
+    unsubscribe(id);
+
+    Subscription *subscription=new Subscription;
+    bool rgb=((streamsMask(openInfo)&4)!=0);
+    if (!subscription->open("/"+name+"/"+id,rgb,adaptive,decimation,maxRate))
     {
-        mutexDepth.wait();
-        bool ready=driver->readDepth(depth, timestampD);
-        mutexDepth.post();
+        printMessage(1,"unable to open the ports for the subscriber %s\n",id.c_str());
+        delete subscription;
+        return false;
+    }
 
-        mutexSkeleton.wait();
-        skeleton.clear();
-        ready&=driver->readSkeleton(&skeleton, timestampS);
-        mutexSkeleton.post();
+    string depthName,imageName;
+    subscription->getPortNames(depthName,imageName);
+    reply.addString(depthName.c_str());
+    reply.addString(rgb?imageName.c_str():"null");
 
-        if (depthPort.getOutputCount()>0 && ready)
-        {
-            mutexDepth.wait();
-            depthPort.prepare()=depth;
-            tsD.update(timestampD);
-            depthPort.setEnvelope(tsD);
-            depthPort.write();
-            mutexDepth.post();
-        }
+    mutexSubscriptions.wait();
+    subscriptions[id]=subscription;
+    mutexSubscriptions.post();
+
+    printMessage(1,"new %s subscriber %s (decimation %d, max rate %g [Hz])\n",
+                 adaptive?"adaptive":"fixed",id.c_str(),decimation,maxRate);
+    return true;
+}
 
-        if (jointsPort.getOutputCount()>0 && ready)
+/************************************************************************/
+void KinectWrapperServer::unsubscribe(const string &id)
+{
+    mutexSubscriptions.wait();
+    map<string,Subscription*>::iterator it=subscriptions.find(id);
+    if (it!=subscriptions.end())
+    {
+        it->second->close();
+        delete it->second;
+        subscriptions.erase(it);
+        printMessage(1,"subscriber %s removed\n",id.c_str());
+    }
+    mutexSubscriptions.post();
+}
+
+/************************************************************************/
+void KinectWrapperServer::writeSubscriptions()
+{
+    mutexSubscriptions.wait();
+    if (!subscriptions.empty())
+    {
+        bool rgb=((streamsMask(info)&4)!=0);
+        mutexDepth.wait();
+        mutexRgb.wait();
+        for (map<string,Subscription*>::iterator it=subscriptions.begin(); it!=subscriptions.end();)
         {
-            mutexSkeleton.wait();
-            jointsPort.prepare()=skeleton;
-            tsS.update(timestampS);
-            jointsPort.setEnvelope(tsS);
-            jointsPort.write();
-            mutexSkeleton.post();
+            //subscribers that disappeared without unsubscribing
+            if (it->second->isGone())
+            {
+                printMessage(1,"subscriber %s disconnected\n",it->first.c_str());
+                it->second->close();
+                delete it->second;
+                subscriptions.erase(it++);
+            }
+            else
+            {
+                it->second->write(depth,Stamp(idD,timestampD),rgb?&image:NULL,Stamp(idI,timestampI));
+                it++;
+            }
         }
+        mutexRgb.post();
+        mutexDepth.post();
+    }
+    mutexSubscriptions.post();
+}
+
+/************************************************************************/
+void KinectWrapperServer::openSharedMemory(const int slots)
+{
+    //slots are given room for VGA frames, so that the resolution can be raised at run-time
+    int depthPixels=std::max(depth_width*depth_height,640*480);
+    if (!depthRing.create(SharedFrameRing::getSegmentName(name,"depth"),slots,depthPixels*2))
+    {
+        printMessage(1,"unable to create the shared memory, frames will go through the ports only\n");
+        return;
     }
-    else if (info==KINECT_TAGS_DEPTH || info==KINECT_TAGS_DEPTH_PLAYERS)
+
+    if ((streamsMask(openInfo)&4)!=0)
+    {
+        int rgbPixels=std::max(img_width*img_height,640*480);
+        if (!rgbRing.create(SharedFrameRing::getSegmentName(name,"rgb"),slots,rgbPixels*3))
+            printMessage(1,"unable to create the shared memory for rgb, rgb will go through the ports only\n");
+    }
+}
+
+/************************************************************************/
+void KinectWrapperServer::writeSharedMemory()
+{
+    if (depthRing.isOpen())
     {
         mutexDepth.wait();
-        bool ready=driver->readDepth(depth, timestampD);
+        if (!depthRing.write(depth,timestampD,idD))
+            printMessage(3,"depth frame does not fit in the shared memory\n");
         mutexDepth.post();
+    }
 
-        if (depthPort.getOutputCount()>0 && ready)
-        {
-            mutexDepth.wait();
-            depthPort.prepare()=depth;
-            tsD.update(timestampD);
-            depthPort.setEnvelope(tsD);
-            depthPort.write();
-            mutexDepth.post();
-        }
+    if (rgbRing.isOpen() && ((streamsMask(info)&4)!=0))
+    {
+        mutexRgb.wait();
+        if (!rgbRing.write(image,timestampI,idI))
+            printMessage(3,"rgb frame does not fit in the shared memory\n");
+        mutexRgb.post();
     }
 }
 
@@ -381,13 +1406,9 @@ bool KinectWrapperServer::getDepth(ImageOf<PixelMono16> &depthIm, double *timest
     depthIm.resize(depth_width,depth_height);
     mutexDepth.wait();
     unsigned short* pBuffDepth=(unsigned short*)depth.getRawImage();
-    for (int i=0; i<depth.width()*depth.height(); i++)
-    {
-        unsigned short realDepth = (pBuffDepth[i]&0xFFF8)>>3;
-        buf[i]=realDepth;
-    }
+    unpackDepth(pBuffDepth,buf,depth.width()*depth.height());
     if (timestamp!=NULL)
-        timestamp=&timestampD;
+        *timestamp=timestampD;
     mutexDepth.post();
     cvSetData(depthCV,buf,depth_width*2);
     depthIm.wrapIplImage(depthCV);
@@ -400,14 +1421,9 @@ bool KinectWrapperServer::getDepth(ImageOf<PixelFloat> &depthIm, double *timesta
     depthIm.resize(depth_width,depth_height);
     mutexDepth.wait();
     unsigned short* pBuffDepth=(unsigned short*)depth.getRawImage();
-    for (int i=0; i<depth.width()*depth.height(); i++)
-    {
-        unsigned short realDepth = (pBuffDepth[i]&0xFFF8);
-        float scale=((1.0*realDepth/0xFFF8));
-        bufF[i]=scale;
-    }
+    unpackDepthScaled(pBuffDepth,bufF,depth.width()*depth.height());
     if (timestamp!=NULL)
-        timestamp=&timestampD;
+        *timestamp=timestampD;
     mutexDepth.post();
     cvSetData(depthFCV,bufF,depth_width*4);
     depthIm.wrapIplImage(depthFCV);
@@ -422,21 +1438,9 @@ bool KinectWrapperServer::getPlayers(Matrix &players, double *timestamp)
         players.resize(depth_height,depth_width);
         mutexDepth.wait();
         unsigned short* pBuffPlayers=(unsigned short*)depth.getRawImage();
-        int m=0;
-        int n=0;
-        for (int i=0; i<depth.width()*depth.height(); i++)
-        {
-            int p=(pBuffPlayers[i]&0x0007);
-            if (n==depth.width())
-            {
-                n=0;
-                m++;
-            }
-            players(m,n)=p;
-            n++;
-        }
+        unpackPlayers(pBuffPlayers,players.data(),depth.width()*depth.height());
         if (timestamp!=NULL)
-            timestamp=&timestampD;
+            *timestamp=timestampD;
         mutexDepth.post();
         return true;
     }
@@ -451,23 +1455,10 @@ bool KinectWrapperServer::getDepthAndPlayers(ImageOf<PixelMono16> &depthIm, Matr
         players.resize(depth_height,depth_width);
         mutexDepth.wait();
         unsigned short* pBuff=(unsigned short*)depth.getRawImage();
-        int m=0;
-        int n=0;
-        for (int i=0; i<depth.width()*depth.height(); i++)
-        {
-            unsigned short realDepth = (pBuff[i]&0xFFF8)>>3;
-            bufPl[i]=realDepth;
-            int p=(pBuff[i]&0x0007);
-            if (n==depth.width())
-            {
-                n=0;
-                m++;
-            }
-            players(m,n)=p;
-            n++;
-        }
+        unpackDepth(pBuff,bufPl,depth.width()*depth.height());
+        unpackPlayers(pBuff,players.data(),depth.width()*depth.height());
         if (timestamp!=NULL)
-            timestamp=&timestampD;
+            *timestamp=timestampD;
         mutexDepth.post();
         cvSetData(depthCVPl,bufPl,depth_width*2);
         depthIm.wrapIplImage(depthCVPl);
@@ -484,24 +1475,10 @@ bool KinectWrapperServer::getDepthAndPlayers(ImageOf<PixelFloat> &depthIm, Matri
         players.resize(depth_height,depth_width);
         mutexDepth.wait();
         unsigned short* pBuff=(unsigned short*)depth.getRawImage();
-        int m=0;
-        int n=0;
-        for (int i=0; i<depth.width()*depth.height(); i++)
-        {
-            unsigned short realDepth = (pBuff[i]&0xFFF8);
-            float scale=((1.0*realDepth/0xFFF8));
-            bufFPl[i]=scale;
-            int p=(pBuff[i]&0x0007);
-            if (n==depth.width())
-            {
-                n=0;
-                m++;
-            }
-            players(m,n)=p;
-            n++;
-        }
+        unpackDepthScaled(pBuff,bufFPl,depth.width()*depth.height());
+        unpackPlayers(pBuff,players.data(),depth.width()*depth.height());
         if (timestamp!=NULL)
-            timestamp=&timestampD;
+            *timestamp=timestampD;
         mutexDepth.post();
         cvSetData(depthFCVPl,bufFPl,depth_width*4);
         depthIm.wrapIplImage(depthFCVPl);
@@ -518,13 +1495,116 @@ bool KinectWrapperServer::getRgb(yarp::sig::ImageOf<yarp::sig::PixelRgb> &rgbIm,
         mutexRgb.wait();
         rgbIm=image;
         if (timestamp!=NULL)
-            timestamp=&timestampI;
+            *timestamp=timestampI;
         mutexRgb.post();
         return true;
     }
     return false;
 }
 
+/************************************************************************/
+bool KinectWrapperServer::getRgbd(ImageOf<PixelMono16> &depthIm, ImageOf<PixelRgb> &rgbIm,
+                                  double *timestampDepth, double *timestampRgb)
+{
+    RgbdFrame frame;
+    if (!fillRgbd(frame))
+        return false;
+
+    frame.unpackDepth(depthIm);
+    rgbIm=frame.rgb;
+    if (timestampDepth!=NULL)
+        *timestampDepth=frame.timestampDepth;
+    if (timestampRgb!=NULL)
+        *timestampRgb=frame.timestampRgb;
+    return true;
+}
+
+/************************************************************************/
+bool KinectWrapperServer::getFrameStats(Property &stats)
+{
+    mutexDepth.wait();
+    statsD.serverToBottle(stats.addGroup("depth"));
+    mutexDepth.post();
+
+    mutexRgb.wait();
+    statsI.serverToBottle(stats.addGroup("rgb"));
+    mutexRgb.post();
+
+    mutexSkeleton.wait();
+    statsS.serverToBottle(stats.addGroup("joints"));
+    mutexSkeleton.post();
+
+    return true;
+}
+
+/************************************************************************/
+void KinectWrapperServer::getStageStats(Bottle &stats)
+{
+    const char *names[]={"update", "read_depth", "read_rgb", "read_skeleton",
+                         "process", "copy", "write"};
+
+    mutexStats.wait();
+    for (int i=0; i<STAGE_COUNT; i++)
+    {
+        Bottle &stage=stats.addList();
+        stage.addString(names[i]);
+        stageLatency[i].toBottle(stage);
+    }
+
+    Bottle &tick=stats.addList();
+    tick.addString("tick");
+    tickLatency.toBottle(tick);
+
+    Bottle &jitter=stats.addList();
+    jitter.addString("jitter");
+    tickJitter.toBottle(jitter);
+
+    Bottle &deadline=stats.addList();
+    deadline.addString("deadline");
+    Bottle &periodPair=deadline.addList();
+    periodPair.addString("period");
+    periodPair.addInt(period);
+    Bottle &ticksPair=deadline.addList();
+    ticksPair.addString("ticks");
+    ticksPair.addInt((int)ticks);
+    Bottle &missesPair=deadline.addList();
+    missesPair.addString("misses");
+    missesPair.addInt((int)deadlineMisses);
+    mutexStats.post();
+}
+
+/************************************************************************/
+void KinectWrapperServer::clearStageStats()
+{
+    //stageTime is per-tick scratch of the acquisition thread, written
+    //without the lock and rewritten at every tick, hence it needs no reset
+    mutexStats.wait();
+    for (int i=0; i<STAGE_COUNT; i++)
+        stageLatency[i].clear();
+    tickLatency.clear();
+    tickJitter.clear();
+    ticks=deadlineMisses=0;
+    lastTick=0.0;
+    mutexStats.post();
+}
+
+/************************************************************************/
+bool KinectWrapperServer::getCloud(ImageOf<PixelRgbFloat> &cloud, double *timestamp)
+{
+    if (projector.isReady())
+    {
+        mutexDepth.wait();
+        bool ok=projector.project(depth,cloud);
+        if (ok)
+            getExtrinsicTransform().apply(cloud);
+        if (timestamp!=NULL)
+            *timestamp=timestampD;
+        mutexDepth.post();
+        return ok;
+    }
+    return false;
+}
+
 /************************************************************************/
 bool KinectWrapperServer::getJoints(deque<Player> &joints, double *timestamp)
 {
@@ -533,7 +1613,7 @@ bool KinectWrapperServer::getJoints(deque<Player> &joints, double *timestamp)
         mutexSkeleton.wait();
         joints=getJoints();
         if (timestamp!=NULL)
-            timestamp=&timestampS;
+            *timestamp=timestampS;
         mutexSkeleton.post();
         if (joints.size()>0)
             return true;
@@ -551,7 +1631,7 @@ bool KinectWrapperServer::getJoints(Player &joints, int player, double *timestam
         mutexSkeleton.wait();
         joints=getJoints(player);
         if (timestamp!=NULL)
-            timestamp=&timestampS;
+            *timestamp=timestampS;
         mutexSkeleton.post();
         if (joints.ID==-1)
             return false;
@@ -570,6 +1650,11 @@ bool KinectWrapperServer::getInfo(Property &opt)
     opt.put("depth_width",depth_width);
     opt.put("depth_height",depth_height);
     opt.put("seated_mode",(seatedMode?"on":"off"));
+    opt.put("period",period);
+    mutexDepth.wait();
+    opt.put("clock_offset",clockD.getOffset());
+    opt.put("clock_drift",clockD.getDrift());
+    mutexDepth.post();
     return true;
 }
 
@@ -577,27 +1662,7 @@ bool KinectWrapperServer::getInfo(Property &opt)
 std::deque<Player> KinectWrapperServer::getJoints()
 {
     deque<Player> players;
-    for (int i=0; i<skeleton.size(); i++)
-    {
-        Skeleton limbs;
-        Bottle* player=skeleton.get(i).asList();
-        Player pi;
-        pi.ID=player->get(0).asInt();
-        for (int j=1; j<player->size(); j++)
-        {
-            Bottle* joints=player->get(j).asList();
-            Bottle* jointsPosition=joints->get(1).asList();
-            Joint joint;
-            joint.u=jointsPosition->get(0).asInt();
-            joint.v=jointsPosition->get(1).asInt();
-            joint.x=jointsPosition->get(2).asDouble();
-            joint.y=jointsPosition->get(3).asDouble();
-            joint.z=jointsPosition->get(4).asDouble();
-            limbs[joints->get(0).asString().c_str()]=joint;
-        }
-        pi.skeleton=limbs;
-        players.push_back(pi);
-    }
+    parseSkeleton(skeleton,players);
     return players;
 }
 
@@ -613,22 +1678,10 @@ Player KinectWrapperServer::getJoints(int playerId)
         for (int i=0; i<skeleton.size(); i++)
         {
             Bottle* player=skeleton.get(i).asList();
-            if(player->get(0).asInt()==playerId)
+            if ((player!=NULL) && (player->get(0).asInt()==playerId))
             {
-                found=true;
-                p.ID=playerId;
-                for (int j=1; j<player->size(); j++)
-                {
-                    Bottle* joints=player->get(j).asList();
-                    Bottle* jointsPosition=joints->get(1).asList();
-                    Joint joint;
-                    joint.u=jointsPosition->get(0).asInt();
-                    joint.v=jointsPosition->get(1).asInt();
-                    joint.x=jointsPosition->get(2).asDouble();
-                    joint.y=jointsPosition->get(3).asDouble();
-                    joint.z=jointsPosition->get(4).asDouble();
-                    p.skeleton[joints->get(0).asString().c_str()]=joint;
-                }
+                found=parsePlayer(*player,p);
+                break;
             }
         }
         if (!found)
@@ -840,7 +1893,89 @@ void KinectWrapperServer::getDepthImage(const yarp::sig::ImageOf<yarp::sig::Pixe
 /************************************************************************/
 bool KinectWrapperServer::get3DPoint(int u, int v, yarp::sig::Vector &point3D)
 {
-    driver->get3DPoint(u,v,point3D);
+    //pixels refer to the published depth, which differs from the map of
+    //the driver once remapped; the lock also keeps resolution changes out
+    bool ok;
+    point3D.resize(3,0.0);
+    mutexDepth.wait();
+    if (registerDepth || undistortDepth)
+        ok=projector.projectPixel(depth,u,v,point3D.data());
+    else
+        ok=driver->get3DPoint(u,v,point3D);
+    mutexDepth.post();
+
+    if (ok && (point3D.length()>=3))
+        getExtrinsicTransform().apply(point3D.data(),1);
+    return ok;
+}
+
+/************************************************************************/
+bool KinectWrapperServer::get3DPoints(const vector<pair<int,int> > &pixels, vector<yarp::sig::Vector> &points3D)
+{
+    bool ok=true;
+    mutexDepth.wait();
+    if (registerDepth || undistortDepth)
+    {
+        //pixels out of the image are given all zeros, as the drivers do
+        points3D.resize(pixels.size());
+        for (size_t i=0; ok && (i<pixels.size()); i++)
+        {
+            points3D[i].resize(3,0.0);
+            if (!projector.projectPixel(depth,pixels[i].first,pixels[i].second,points3D[i].data()))
+                ok=projector.isReady();
+        }
+    }
+    else
+        ok=driver->get3DPoints(pixels,points3D);
+    mutexDepth.post();
+
+    if (!ok)
+        return false;
+
+    ExtrinsicTransform H=getExtrinsicTransform();
+    if (!H.isIdentity())
+    {
+        vector<double> xyz(3*points3D.size());
+        for (size_t i=0; i<points3D.size(); i++)
+            for (int j=0; j<3; j++)
+                xyz[3*i+j]=points3D[i][j];
+        if (!xyz.empty())
+            H.apply(&xyz[0],(int)points3D.size());
+        for (size_t i=0; i<points3D.size(); i++)
+            for (int j=0; j<3; j++)
+                points3D[i][j]=xyz[3*i+j];
+    }
+
+    return true;
+}
+
+/************************************************************************/
+bool KinectWrapperServer::setExtrinsics(const Matrix &H)
+{
+    if ((H.rows()!=4) || (H.cols()!=4))
+        return false;
+
+    double h[16];
+    for (int r=0; r<4; r++)
+        for (int c=0; c<4; c++)
+            h[4*r+c]=H(r,c);
+
+    mutexExtrinsics.wait();
+    bool ok=extrinsics.set(h);
+    mutexExtrinsics.post();
+    return ok;
+}
+
+/************************************************************************/
+bool KinectWrapperServer::getExtrinsics(Matrix &H)
+{
+    double h[16];
+    getExtrinsicTransform().get(h);
+
+    H.resize(4,4);
+    for (int r=0; r<4; r++)
+        for (int c=0; c<4; c++)
+            H(r,c)=h[4*r+c];
     return true;
 }
 
@@ -0,0 +1,474 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+\defgroup kinectBench kinectBench
+
+Measures what a \ref kinectServer delivers to a client.
+
+\section intro_sec Description
+This module connects to a \ref kinectServer as any other client, but
+it does nothing with the data: it only measures, so that it can run
+next to production clients to tell whether a stall comes from the
+server, the network or the client itself.
+
+For each stream provided by the server (depth, rgb, joints) it gives:
+- the arrival rate;
+- the jitter, i.e. the standard deviation of the inter-arrival times,
+  and the largest gap between two frames;
+- the latency from the envelope timestamp to the reception, which is
+  meaningful only on the host of the server, since envelopes are
+  stamped with its monotonic clock;
+- the time spent by the client to read and unpack a frame;
+- the frames skipped by the client, according to the frame numbers;
+  frames a subscription does not send on purpose (e.g. decimation) are
+  not counted.
+
+In a separate thread it also times the round trip of the get3D and
+getFL rpc commands. The client is not thread-safe, so the probes and
+the stream reads take turns: an arrival may be delayed by one round
+trip at most, once per probe period.
+
+A summary is printed periodically, and every summary window can also
+be appended to a CSV file. Each window starts from scratch.
+
+It requires the \ref kinectServer running.
+
+\section lib_sec Libraries
+- YARP libraries.
+- \ref kinectWrapper library.
+
+\section parameters_sec Parameters
+--verbosity \e verbosity
+- specify the verbosity level of the client print-outs.
+
+--carrier \e carrier
+- specify the protocol used to connect to the server ports; if not
+  given, the carrier suggested by the server is used, udp otherwise.
+
+--shmem
+- read depth and rgb from the shared memory rings of the server, if
+  available.
+
+--remote \e remote
+- specify the kinectServer name to connect to.
+
+--name \e name
+- specify the stem-name of the module, kinectBench by default.
+
+--period \e period
+- the period in seconds the streams are polled with, by default 0.002;
+  it bounds the resolution of the timings of the arrivals.
+
+--summary \e period
+- the period in seconds of the summaries, by default 5.
+
+--rpc_period \e period
+- the period in seconds of the rpc round-trip probes, by default 1;
+  0 disables them.
+
+--csv \e file
+- append the summaries to \e file.
+
+\section tested_os_sec Tested OS
+Windows, Linux
+*/
+
+#include <stdio.h>
+#include <math.h>
+#include <string>
+#include <deque>
+
+#include <yarp/os/Network.h>
+#include <yarp/os/RFModule.h>
+#include <yarp/os/RateThread.h>
+#include <yarp/os/Semaphore.h>
+
+#include <kinectWrapper/kinectTags.h>
+#include <kinectWrapper/kinectWrapper_client.h>
+#include <kinectWrapper/kinectClock.h>
+#include <kinectWrapper/kinectLatency.h>
+#include <kinectWrapper/kinectLog.h>
+
+using namespace std;
+using namespace yarp::os;
+using namespace yarp::sig;
+using namespace kinectWrapper;
+
+class StreamMeter
+{
+protected:
+    double lastArrival;
+    double sumInterval;
+    double sumInterval2;
+    double maxGap;
+    unsigned int intervals;
+
+public:
+    unsigned int frames;
+    LatencyHistogram latency;
+    LatencyHistogram unpack;
+
+    StreamMeter()
+    {
+        lastArrival=-1.0;
+        clear();
+    }
+
+    void clear()
+    {
+        //the last arrival is kept, so that no interval gets lost between windows
+        frames=0;
+        intervals=0;
+        sumInterval=sumInterval2=0.0;
+        maxGap=0.0;
+        latency.clear();
+        unpack.clear();
+    }
+
+    void arrival(const double now, const double timestamp, const double unpackTime)
+    {
+        if (lastArrival>=0.0)
+        {
+            double interval=now-lastArrival;
+            sumInterval+=interval;
+            sumInterval2+=interval*interval;
+            if (interval>maxGap)
+                maxGap=interval;
+            intervals++;
+        }
+        lastArrival=now;
+        frames++;
+        latency.add(now-timestamp);
+        unpack.add(unpackTime);
+    }
+
+    double getJitter() const
+    {
+        if (intervals<2)
+            return 0.0;
+        double mean=sumInterval/intervals;
+        double var=sumInterval2/intervals-mean*mean;
+        return (var>0.0)?sqrt(var):0.0;
+    }
+
+    double getMaxGap() const
+    {
+        return maxGap;
+    }
+};
+
+
+class RpcProbe: public RateThread
+{
+protected:
+    KinectWrapperClient &client;
+    Semaphore &rpcMutex;
+    Semaphore mutex;
+    int u,v;
+    LatencyHistogram rtt3D;
+    LatencyHistogram rttFL;
+    unsigned int failures;
+
+public:
+    RpcProbe(KinectWrapperClient &client, Semaphore &rpcMutex, const int period,
+             const int u, const int v) : RateThread(period), client(client),
+             rpcMutex(rpcMutex), mutex(1), u(u), v(v)
+    {
+        failures=0;
+    }
+
+    void run()
+    {
+        yarp::sig::Vector point3D;
+        double focalLength;
+
+        rpcMutex.wait();
+        double t0=monotonicTime();
+        bool ok3D=client.get3DPoint(u,v,point3D);
+        double t1=monotonicTime();
+        bool okFL=client.getFocalLength(focalLength);
+        double t2=monotonicTime();
+        rpcMutex.post();
+
+        mutex.wait();
+        if (ok3D)
+            rtt3D.add(t1-t0);
+        else
+            failures++;
+        if (okFL)
+            rttFL.add(t2-t1);
+        else
+            failures++;
+        mutex.post();
+    }
+
+    void collect(LatencyHistogram &rtt3D, LatencyHistogram &rttFL, unsigned int &failures)
+    {
+        mutex.wait();
+        rtt3D=this->rtt3D;
+        rttFL=this->rttFL;
+        failures=this->failures;
+        this->rtt3D.clear();
+        this->rttFL.clear();
+        this->failures=0;
+        mutex.post();
+    }
+};
+
+
+class KinectBench: public RFModule
+{
+protected:
+    KinectWrapperClient client;
+    Semaphore rpcMutex;
+    RpcProbe *probe;
+    FILE *csv;
+
+    ImageOf<PixelMono16> depth;
+    ImageOf<PixelRgb> rgb;
+    deque<Player> joints;
+
+    bool useRgb;
+    bool useJoints;
+    double period;
+    double summaryPeriod;
+    double windowStart;
+    StreamMeter meters[3];
+    unsigned int skipped0[3];
+
+    void printStream(const double now, const char *name, StreamMeter &meter, const double window,
+                     const unsigned int skipped)
+    {
+        double fps=meter.frames/window;
+        fprintf(stdout,"%-7s %7.2f fps  jitter %6.2f ms  max gap %7.2f ms  latency p50 %6.2f p99 %6.2f ms  "
+                       "unpack p50 %6.3f p99 %6.3f ms  skipped %u\n",
+                name,fps,1e3*meter.getJitter(),1e3*meter.getMaxGap(),
+                1e3*meter.latency.getPercentile(50.0),1e3*meter.latency.getPercentile(99.0),
+                1e3*meter.unpack.getPercentile(50.0),1e3*meter.unpack.getPercentile(99.0),skipped);
+        if (csv!=NULL)
+            fprintf(csv,"%.3f,%s,%u,%g,%g,%g,%g,%g,%g,%g,%g,%g,%u\n",now,name,meter.frames,fps,
+                    1e3*meter.getJitter(),1e3*meter.getMaxGap(),
+                    1e3*meter.latency.getPercentile(50.0),1e3*meter.latency.getPercentile(90.0),
+                    1e3*meter.latency.getPercentile(99.0),1e3*meter.latency.getMax(),
+                    1e3*meter.unpack.getPercentile(50.0),1e3*meter.unpack.getPercentile(99.0),skipped);
+    }
+
+    void printRpc(const double now, const char *name, const LatencyHistogram &rtt)
+    {
+        if (rtt.getCount()==0)
+            return;
+        fprintf(stdout,"%-7s %u calls  rtt p50 %6.2f p90 %6.2f p99 %6.2f max %6.2f ms\n",name,rtt.getCount(),
+                1e3*rtt.getPercentile(50.0),1e3*rtt.getPercentile(90.0),
+                1e3*rtt.getPercentile(99.0),1e3*rtt.getMax());
+        if (csv!=NULL)
+            fprintf(csv,"%.3f,%s,%u,,,,%g,%g,%g,%g,,,\n",now,name,rtt.getCount(),
+                    1e3*rtt.getPercentile(50.0),1e3*rtt.getPercentile(90.0),
+                    1e3*rtt.getPercentile(99.0),1e3*rtt.getMax());
+    }
+
+    void summary(const double now)
+    {
+        Property stats;
+        rpcMutex.wait();
+        client.getFrameStats(stats);
+        rpcMutex.post();
+
+        const char *names[]={"depth","rgb","joints"};
+        bool used[]={true,useRgb,useJoints};
+        double window=now-windowStart;
+
+        fprintf(stdout,"---- last %.1f s\n",window);
+        for (int i=0; i<3; i++)
+        {
+            //skipped frames are net of the withheld ones, which the server
+            //may account before the next frame reaches us: keep the highest
+            unsigned int skipped=(unsigned int)stats.findGroup(names[i]).find("skipped").asInt();
+            if (used[i])
+                printStream(now,names[i],meters[i],window,(skipped>skipped0[i])?skipped-skipped0[i]:0);
+            if (skipped>skipped0[i])
+                skipped0[i]=skipped;
+            meters[i].clear();
+        }
+
+        if (probe!=NULL)
+        {
+            LatencyHistogram rtt3D,rttFL;
+            unsigned int failures;
+            probe->collect(rtt3D,rttFL,failures);
+            printRpc(now,"get3D",rtt3D);
+            printRpc(now,"getFL",rttFL);
+            if (failures>0)
+                fprintf(stdout,"rpc     %u failed calls\n",failures);
+        }
+
+        fflush(stdout);
+        if (csv!=NULL)
+            fflush(csv);
+        windowStart=now;
+    }
+
+public:
+    KinectBench() : rpcMutex(1), probe(NULL), csv(NULL) { }
+
+    bool configure(ResourceFinder &rf)
+    {
+        int verbosity=rf.check("verbosity",Value(0)).asInt();
+        string name=rf.check("name",Value("kinectBench")).asString().c_str();
+        string remote=rf.check("remote",Value("kinectServer")).asString().c_str();
+        period=rf.check("period",Value(0.002)).asDouble();
+        summaryPeriod=rf.check("summary",Value(5.0)).asDouble();
+        double rpcPeriod=rf.check("rpc_period",Value(1.0)).asDouble();
+
+        Property options;
+        if (rf.check("carrier"))
+            options.put("carrier",rf.find("carrier").asString().c_str());
+        if (rf.check("shmem"))
+            options.put("shmem","true");
+        options.put("remote",remote.c_str());
+        options.put("local",(name+"/client").c_str());
+        options.put("verbosity",verbosity);
+
+        if (!client.open(options))
+            return false;
+
+        Property opt;
+        client.getInfo(opt);
+        string info=opt.find("info").asString().c_str();
+        useRgb=(info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_RGB || info==KINECT_TAGS_DEPTH_RGB_PLAYERS);
+        useJoints=(info==KINECT_TAGS_ALL_INFO || info==KINECT_TAGS_DEPTH_JOINTS);
+
+        if (rf.check("csv"))
+        {
+            string fileName=rf.find("csv").asString().c_str();
+            if ((csv=fopen(fileName.c_str(),"a"))==NULL)
+            {
+                fprintf(stdout,"unable to open %s\n",fileName.c_str());
+                client.close();
+                return false;
+            }
+            //the header is written only once, runs are appended
+            fseek(csv,0,SEEK_END);
+            if (ftell(csv)==0)
+                fprintf(csv,"time,stream,count,rate_hz,jitter_ms,max_gap_ms,p50_ms,p90_ms,p99_ms,max_ms,"
+                            "unpack_p50_ms,unpack_p99_ms,skipped\n");
+        }
+
+        Property stats;
+        client.getFrameStats(stats);
+        const char *names[]={"depth","rgb","joints"};
+        for (int i=0; i<3; i++)
+            skipped0[i]=(unsigned int)stats.findGroup(names[i]).find("skipped").asInt();
+
+        //the probes ask for the 3D point at the center of the depth image
+        if (rpcPeriod>0.0)
+        {
+            probe=new RpcProbe(client,rpcMutex,(int)(1000.0*rpcPeriod),
+                               opt.find("depth_width").asInt()/2,opt.find("depth_height").asInt()/2);
+            probe->start();
+        }
+
+        windowStart=monotonicTime();
+        return true;
+    }
+
+    bool close()
+    {
+        if (probe!=NULL)
+        {
+            probe->stop();
+            delete probe;
+            probe=NULL;
+        }
+        client.close();
+        if (csv!=NULL)
+        {
+            fclose(csv);
+            csv=NULL;
+        }
+        Logger::shutdown();
+        return true;
+    }
+
+    double getPeriod()
+    {
+        return period;
+    }
+
+    bool updateModule()
+    {
+        //the probe shares the client, whose buffers the reads may resize;
+        //the timings start once the lock is held
+        rpcMutex.wait();
+
+        double timestamp;
+        double t0=monotonicTime();
+        if (client.getDepth(depth,&timestamp))
+        {
+            double now=monotonicTime();
+            meters[0].arrival(now,timestamp,now-t0);
+        }
+
+        if (useRgb)
+        {
+            t0=monotonicTime();
+            if (client.getRgb(rgb,&timestamp))
+            {
+                double now=monotonicTime();
+                meters[1].arrival(now,timestamp,now-t0);
+            }
+        }
+
+        if (useJoints)
+        {
+            t0=monotonicTime();
+            if (client.getJoints(joints,&timestamp))
+            {
+                double now=monotonicTime();
+                meters[2].arrival(now,timestamp,now-t0);
+            }
+        }
+
+        rpcMutex.post();
+
+        double now=monotonicTime();
+        if (now-windowStart>=summaryPeriod)
+            summary(now);
+
+        return true;
+    }
+};
+
+
+
+int main(int argc, char *argv[])
+{
+    Network yarp;
+    if (!yarp.checkNetwork())
+    {
+        fprintf(stdout, "Yarp network not available\n");
+        return 1;
+    }
+
+    ResourceFinder rf;
+    rf.setVerbose(true);
+    rf.setDefaultContext("kinectBench");
+    rf.configure(argc,argv);
+
+    KinectBench mod;
+    return mod.runModule(rf);
+}
+
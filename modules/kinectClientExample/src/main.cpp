@@ -35,7 +35,9 @@ It requires the \ref kinectServer running.
 - specify the verbosity level of the client print-outs.
 
 --carrier \e carrier
-- specify the protocol used to connect to the server ports.
+- specify the protocol used to connect to the server ports (mcast to
+  join the multicast groups); if not given, the carrier suggested by
+  the server is used, udp otherwise.
 
 --remote \e remote
 - specify the kinectServer name to connect to.
@@ -55,6 +57,7 @@ Modified by Tobias Fischer
 
 #include <kinectWrapper/kinectTags.h>
 #include <kinectWrapper/kinectWrapper_client.h>
+#include <kinectWrapper/kinectLog.h>
 
 using namespace std;
 using namespace yarp::os;
@@ -91,7 +94,6 @@ public:
         string name=rf.check("name",Value("kinectClientExample")).asString().c_str();
         string show=rf.check("showImages",Value("false")).asString().c_str();
         string remote=rf.check("remote",Value("kinectServer")).asString().c_str();
-        string carrier=rf.check("carrier",Value("udp")).asString().c_str();
         showImages=(show=="true");
 
         depthPort.open("/"+name+"/depthPort:o");
@@ -100,7 +102,9 @@ public:
         skeletonPort.open("/"+name+"/skeletonPort:o");
 
         Property options;
-        options.put("carrier",carrier.c_str());
+        //without a carrier the one suggested by the server is used (e.g. mcast)
+        if (rf.check("carrier"))
+            options.put("carrier",rf.find("carrier").asString().c_str());
         options.put("remote",remote.c_str());
         options.put("local",(name+"/client").c_str());
         options.put("verbosity",verbosity);
@@ -152,6 +156,7 @@ public:
         client.close();
         cvReleaseImage(&depthTmp);
         cvReleaseImage(&rgbTmp);
+        Logger::shutdown();
         return true;
     }
 
@@ -0,0 +1,490 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+\defgroup kinectLoad kinectLoad
+
+Load generator simulating many clients of a \ref kinectServer.
+
+\section intro_sec Description
+This module opens, from a single process, many lightweight connections
+to the depth:o and joints:o ports of a \ref kinectServer, e.g. a room
+full of dashboards. Every connection is a bare port with a reader, without
+the buffers and the rpc of a KinectWrapperClient, and behaves as:
+- \e fast: every frame is dropped as soon as it arrives;
+- \e slow: every frame keeps the connection busy for slow_delay seconds;
+- \e stalled: the first frame blocks the connection forever, so that
+  the server sees a consumer that never drains its socket.
+
+Frames are handled by the thread reading the socket of the connection,
+hence slow and stalled connections push back on the server as real
+consumers do.
+
+Each connection counts the frames it receives and, through the frame
+numbers of the envelopes, the frames it skips. Periodically, for every
+stream and behaviour, the module prints the delivered rate of the
+connections (mean, worst and best) and the delivered fraction of the
+frames published by the server in the same window, so that it is
+possible to check that slow and stalled consumers do not degrade the
+fast ones.
+
+It requires the \ref kinectServer running.
+
+\section lib_sec Libraries
+- YARP libraries.
+- \ref kinectWrapper library.
+
+\section parameters_sec Parameters
+--remote \e remote
+- specify the kinectServer name to connect to.
+
+--name \e name
+- specify the stem-name of the connections, kinectLoad by default.
+
+--carrier \e carrier
+- specify the protocol of the connections, tcp by default.
+
+--depth "((\e behaviour \e n) ...)"
+- the connections to depth:o, by default ((fast 50)).
+
+--joints "((\e behaviour \e n) ...)"
+- the connections to joints:o, by default ((fast 200)).
+
+--slow_delay \e delay
+- the seconds a slow connection spends on each frame, 0.2 by default.
+
+--summary \e period
+- the period in seconds of the summaries, by default 5.
+
+--csv \e file
+- append to \e file one line per connection and summary.
+
+\section tested_os_sec Tested OS
+Linux
+*/
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <yarp/os/Network.h>
+#include <yarp/os/RFModule.h>
+#include <yarp/os/Port.h>
+#include <yarp/os/Semaphore.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/os/Time.h>
+#include <yarp/sig/Image.h>
+
+#include <kinectWrapper/kinectTags.h>
+#include <kinectWrapper/kinectFrameStats.h>
+#include <kinectWrapper/kinectClock.h>
+#include <kinectWrapper/kinectLog.h>
+
+using namespace std;
+using namespace yarp::os;
+using namespace yarp::sig;
+using namespace kinectWrapper;
+
+enum Behaviour
+{
+    BEHAVIOUR_FAST,
+    BEHAVIOUR_SLOW,
+    BEHAVIOUR_STALLED,
+    BEHAVIOUR_COUNT
+};
+
+const char *behaviourNames[BEHAVIOUR_COUNT]={"fast","slow","stalled"};
+
+
+struct Delivery
+{
+    unsigned int received;
+    unsigned int skipped;
+    double maxGap;
+};
+
+
+class Connection
+{
+protected:
+    Semaphore mutex;
+    Semaphore stall;
+    FrameStats stats;
+    double lastArrival;
+    double maxGap;
+    bool closing;
+
+    void arrival(Stamp &stamp, const double slowDelay)
+    {
+        double now=monotonicTime();
+        mutex.wait();
+        stats.receive(stamp.getCount());
+        if ((lastArrival>=0.0) && (now-lastArrival>maxGap))
+            maxGap=now-lastArrival;
+        lastArrival=now;
+        bool stop=closing;
+        mutex.post();
+
+        if (stop)
+            return;
+        if (behaviour==BEHAVIOUR_SLOW)
+            Time::delay(slowDelay);
+        else if (behaviour==BEHAVIOUR_STALLED)
+            stall.wait();
+    }
+
+public:
+    Behaviour behaviour;
+    string name;
+    unsigned int received0;
+    unsigned int skipped0;
+
+    Connection(const Behaviour behaviour, const string &name) : mutex(1), stall(0),
+               behaviour(behaviour), name(name)
+    {
+        lastArrival=-1.0;
+        maxGap=0.0;
+        closing=false;
+        received0=skipped0=0;
+    }
+
+    virtual ~Connection() { }
+    virtual bool open(const string &source, const string &carrier) = 0;
+    virtual void close() = 0;
+
+    void release()
+    {
+        mutex.wait();
+        closing=true;
+        mutex.post();
+        //only a stalled connection is waiting, and on one frame at most
+        stall.post();
+    }
+
+    Delivery collect()
+    {
+        Delivery d;
+        mutex.wait();
+        d.received=stats.received-received0;
+        d.skipped=stats.skipped-skipped0;
+        d.maxGap=maxGap;
+        received0=stats.received;
+        skipped0=stats.skipped;
+        maxGap=0.0;
+        mutex.post();
+        return d;
+    }
+};
+
+
+template <class T>
+class TypedConnection: public Connection, public PortReader
+{
+protected:
+    Port port;
+    double slowDelay;
+
+public:
+    TypedConnection(const Behaviour behaviour, const string &name, const double slowDelay) :
+                    Connection(behaviour,name), slowDelay(slowDelay) { }
+
+    bool open(const string &source, const string &carrier)
+    {
+        port.setReader(*this);
+        if (!port.open(name.c_str()))
+            return false;
+        return Network::connect(source.c_str(),name.c_str(),carrier.c_str());
+    }
+
+    void close()
+    {
+        release();
+        port.interrupt();
+        port.close();
+    }
+
+    bool read(ConnectionReader &connection)
+    {
+        T data;
+        if (!data.read(connection))
+            return false;
+
+        Stamp stamp;
+        port.getEnvelope(stamp);
+        arrival(stamp,slowDelay);
+        return true;
+    }
+};
+
+
+class KinectLoad: public RFModule
+{
+protected:
+    string name;
+    string remote;
+    Port rpc;
+    bool useRpc;
+    FILE *csv;
+    double summaryPeriod;
+    double windowStart;
+    vector<Connection*> depth;
+    vector<Connection*> joints;
+    unsigned int published0[2];
+
+    bool getPublished(unsigned int *published)
+    {
+        if (!useRpc)
+            return false;
+
+        Bottle cmd,reply;
+        cmd.addString(KINECT_TAGS_CMD_GETFRAMESTATS);
+        if (!rpc.write(cmd,reply) || (reply.size()==0) || (reply.get(0).asString()!=KINECT_TAGS_CMD_ACK))
+            return false;
+
+        Property stats(reply.tail().toString().c_str());
+        published[0]=(unsigned int)stats.findGroup("depth").find("published").asInt();
+        published[1]=(unsigned int)stats.findGroup("joints").find("published").asInt();
+        return true;
+    }
+
+    template <class T>
+    bool openConnections(Bottle *spec, const string &stream, const string &carrier,
+                         const double slowDelay, vector<Connection*> &connections)
+    {
+        if (spec==NULL)
+            return true;
+
+        for (int i=0; i<spec->size(); i++)
+        {
+            Bottle *group=spec->get(i).asList();
+            if ((group==NULL) || (group->size()<2))
+                continue;
+
+            string behaviourName=group->get(0).asString().c_str();
+            int b;
+            for (b=0; b<BEHAVIOUR_COUNT; b++)
+                if (behaviourName==behaviourNames[b])
+                    break;
+            if (b==BEHAVIOUR_COUNT)
+            {
+                fprintf(stdout,"unknown behaviour %s\n",behaviourName.c_str());
+                return false;
+            }
+
+            int n=group->get(1).asInt();
+            for (int j=0; j<n; j++)
+            {
+                char portName[256];
+                sprintf(portName,"/%s/%s/%s%d:i",name.c_str(),stream.c_str(),behaviourNames[b],j);
+                TypedConnection<T> *c=new TypedConnection<T>((Behaviour)b,portName,slowDelay);
+                connections.push_back(c);
+                if (!c->open("/"+remote+"/"+stream+":o",carrier))
+                {
+                    fprintf(stdout,"unable to connect %s\n",portName);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void summarize(const char *stream, vector<Connection*> &connections, const unsigned int published,
+                   const bool knownPublished, const double window, const double now)
+    {
+        for (int b=0; b<BEHAVIOUR_COUNT; b++)
+        {
+            int n=0;
+            double sum=0.0,worst=0.0,best=0.0,maxGap=0.0;
+            unsigned int skipped=0;
+            for (size_t i=0; i<connections.size(); i++)
+            {
+                if (connections[i]->behaviour!=b)
+                    continue;
+
+                Delivery d=connections[i]->collect();
+                double fps=d.received/window;
+                if ((n==0) || (fps<worst))
+                    worst=fps;
+                if ((n==0) || (fps>best))
+                    best=fps;
+                if (d.maxGap>maxGap)
+                    maxGap=d.maxGap;
+                sum+=fps;
+                skipped+=d.skipped;
+                n++;
+
+                if (csv!=NULL)
+                    fprintf(csv,"%.3f,%s,%s,%s,%u,%u,%g,%g\n",now,stream,behaviourNames[b],
+                            connections[i]->name.c_str(),d.received,d.skipped,fps,1e3*d.maxGap);
+            }
+            if (n==0)
+                continue;
+
+            fprintf(stdout,"%-6s %-7s %4d conns  fps mean %6.2f worst %6.2f best %6.2f  "
+                           "skipped %6u  max gap %8.1f ms",
+                    stream,behaviourNames[b],n,sum/n,worst,best,skipped,1e3*maxGap);
+            if (knownPublished && (published>0))
+                fprintf(stdout,"  delivered %5.1f%%",100.0*(sum/n)*window/published);
+            fprintf(stdout,"\n");
+        }
+    }
+
+public:
+    KinectLoad() : useRpc(false), csv(NULL) { }
+
+    bool configure(ResourceFinder &rf)
+    {
+        remote=rf.check("remote",Value("kinectServer")).asString().c_str();
+        name=rf.check("name",Value("kinectLoad")).asString().c_str();
+        string carrier=rf.check("carrier",Value("tcp")).asString().c_str();
+        double slowDelay=rf.check("slow_delay",Value(0.2)).asDouble();
+        summaryPeriod=rf.check("summary",Value(5.0)).asDouble();
+
+        Bottle depthDefault("(fast 50)");
+        Bottle jointsDefault("(fast 200)");
+        Bottle *depthSpec=rf.check("depth")?rf.find("depth").asList():&depthDefault;
+        Bottle *jointsSpec=rf.check("joints")?rf.find("joints").asList():&jointsDefault;
+
+        //the published frames are asked to the server to tell the delivered fraction
+        rpc.open(("/"+name+"/rpc").c_str());
+        useRpc=Network::connect(rpc.getName().c_str(),("/"+remote+"/rpc").c_str());
+        if (!useRpc)
+            fprintf(stdout,"unable to reach /%s/rpc, the delivered fraction is not given\n",remote.c_str());
+
+        if (!openConnections<ImageOf<PixelMono16> >(depthSpec,"depth",carrier,slowDelay,depth) ||
+            !openConnections<Bottle>(jointsSpec,"joints",carrier,slowDelay,joints))
+        {
+            close();
+            return false;
+        }
+
+        fprintf(stdout,"%d depth and %d joints connections open\n",(int)depth.size(),(int)joints.size());
+
+        if (rf.check("csv"))
+        {
+            string fileName=rf.find("csv").asString().c_str();
+            if ((csv=fopen(fileName.c_str(),"a"))!=NULL)
+            {
+                fseek(csv,0,SEEK_END);
+                if (ftell(csv)==0)
+                    fprintf(csv,"time,stream,behaviour,connection,received,skipped,fps,max_gap_ms\n");
+            }
+            else
+                fprintf(stdout,"unable to open %s\n",fileName.c_str());
+        }
+
+        if (!getPublished(published0))
+            published0[0]=published0[1]=0;
+        for (size_t i=0; i<depth.size(); i++)
+            depth[i]->collect();
+        for (size_t i=0; i<joints.size(); i++)
+            joints[i]->collect();
+        windowStart=monotonicTime();
+
+        return true;
+    }
+
+    bool close()
+    {
+        //stalled callbacks are released first, otherwise the ports cannot close
+        for (size_t i=0; i<depth.size(); i++)
+            depth[i]->release();
+        for (size_t i=0; i<joints.size(); i++)
+            joints[i]->release();
+
+        for (size_t i=0; i<depth.size(); i++)
+        {
+            depth[i]->close();
+            delete depth[i];
+        }
+        depth.clear();
+
+        for (size_t i=0; i<joints.size(); i++)
+        {
+            joints[i]->close();
+            delete joints[i];
+        }
+        joints.clear();
+
+        rpc.interrupt();
+        rpc.close();
+
+        if (csv!=NULL)
+        {
+            fclose(csv);
+            csv=NULL;
+        }
+        Logger::shutdown();
+        return true;
+    }
+
+    double getPeriod()
+    {
+        return summaryPeriod;
+    }
+
+    bool updateModule()
+    {
+        double now=monotonicTime();
+        double window=now-windowStart;
+
+        unsigned int published[2]={0,0};
+        bool knownPublished=getPublished(published);
+        if (knownPublished)
+        {
+            unsigned int tmp[2]={published[0],published[1]};
+            published[0]-=published0[0];
+            published[1]-=published0[1];
+            published0[0]=tmp[0];
+            published0[1]=tmp[1];
+        }
+
+        fprintf(stdout,"---- last %.1f s",window);
+        if (knownPublished)
+            fprintf(stdout,", server published %.2f depth fps and %.2f joints fps",
+                    published[0]/window,published[1]/window);
+        fprintf(stdout,"\n");
+        summarize("depth",depth,published[0],knownPublished,window,now);
+        summarize("joints",joints,published[1],knownPublished,window,now);
+        fflush(stdout);
+        if (csv!=NULL)
+            fflush(csv);
+
+        windowStart=now;
+        return true;
+    }
+};
+
+
+
+int main(int argc, char *argv[])
+{
+    Network yarp;
+    if (!yarp.checkNetwork())
+    {
+        fprintf(stdout, "Yarp network not available\n");
+        return 1;
+    }
+
+    ResourceFinder rf;
+    rf.setVerbose(true);
+    rf.setDefaultContext("kinectLoad");
+    rf.configure(argc,argv);
+
+    KinectLoad mod;
+    return mod.runModule(rf);
+}
+
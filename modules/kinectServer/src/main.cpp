@@ -58,6 +58,165 @@ from a kinect device.
 --device \e device
 - kinect or xtion
 
+--cloud
+- if put inside the options, the organized point cloud computed from
+  each depth frame is streamed over /name/cloud:o.
+
+--voxels
+- if put inside the options, the centroids of the occupied voxels of the
+  points of each depth frame are streamed over /name/voxels:o.
+
+--voxel_size \e size
+- edge of the voxels in [m].
+
+--voxel_box "(\e xmin \e xmax \e ymin \e ymax \e zmin \e zmax)"
+- bounding box of the voxel grid in [m].
+
+--voxel_bands \e bands
+- number of bands the frame is split in to voxelize in parallel.
+
+--rgbd
+- depth and rgb of each frame are streamed together over /name/rgbd:o,
+  each with its own acquisition timestamp, so that clients receive
+  matched pairs. Each message is a Bottle
+  (t_depth t_rgb registered (w h {depth}) (w h {rgb})), see RgbdFrame.
+
+--multicast
+- clients that do not specify a carrier join depth:o, image:o, joints:o
+  and cloud:o through the mcast carrier: each frame is then serialized
+  and sent once, whatever the number of clients.
+
+--shmem
+- depth and rgb frames are also written in shared memory rings, which
+  clients running on the same host and opened with the shmem option
+  read instead of the ports.
+
+--shmem_slots \e slots
+- number of frames held by each ring; a frame read by a client stays
+  valid for \e slots-1 periods.
+
+--trace \e file
+- writes to \e file, when the server is closed, the spans of each frame
+  through the server (device update, reads, processing, publish) in the
+  Chrome trace format. Available only if the library is built with the
+  ENABLE_TRACING option.
+
+--devices "(\e dev0 \e dev1 ...)"
+- runs one server per device in the same process; each device is given
+  by index or by serial and its ports are opened as /name/\e dev. The
+  envelopes of all the devices are stamped with the same host clock.
+  Options specific to a device go in the [device_\e dev] group, while
+  the groups described below can be given per device as
+  [depth_undistortion_\e dev], [rgb_undistortion_\e dev] and
+  [registration_\e dev].
+
+--synthetic
+- serves generated frames (a floor with players walking across it)
+  instead of opening a device, e.g. to test clients or to measure the
+  throughput of the server without the hardware.
+
+--synthetic_players \e n
+- number of players in the generated scene, 2 by default.
+
+--host_clock
+- stamps the envelopes with the host monotonic time at acquisition
+  instead of the device time mapped onto the host monotonic clock
+  (always on with --devices).
+
+--extrinsics \e (r00 r01 r02 tx ... 0 0 0 1)
+- the 4x4 row-major transformation from the camera frame to the frame
+  joints, 3D points, clouds and voxels are given in (e.g. the robot
+  root). It can be changed at run-time through the rpc commands
+  setExtrinsics/getExtrinsics.
+
+[depth_undistortion]
+- if this group is present, depth images are undistorted through a
+  remap table computed at start-up (nearest-neighbour, player bits are
+  preserved). It contains intrinsics (\e fx \e fy \e cx \e cy) at the
+  depth resolution and distortion (\e k1 \e k2 \e p1 \e p2 [\e k3]).
+
+[rgb_undistortion]
+- as [depth_undistortion] for rgb images (bilinear), with intrinsics at
+  the rgb resolution.
+
+[registration]
+- if this group is present and the depth is not aligned with rgb by the
+  driver (see --remap), depth is registered onto the rgb camera in
+  software. It contains:
+  depth_intrinsics (\e fx \e fy \e cx \e cy) at the depth resolution,
+  rgb_intrinsics (\e fx \e fy \e cx \e cy) at the rgb resolution,
+  rotation (\e r00 \e r01 ... \e r22) and translation (\e tx \e ty \e tz)
+  in [m] from the depth to the rgb camera. With rgbd_only, only the depth
+  sent over /name/rgbd:o is registered.
+
+\section portsc_sec Ports Created
+- /name/rpc to receive the commands described below.
+- /name/depth:o, /name/image:o and /name/joints:o stream the frames
+  according to --info.
+- /name/info:o notifies the changes of configuration.
+- /name/stats:o publishes once per second, for depth, rgb and joints,
+  (\e stream (fps \e f) (bytes \e bytes/s) (dropped \e n) (unread \e n) (clients \e n)),
+  where dropped counts the frames that never became ready and unread the
+  ones with no reader on the shared port, which may still have reached
+  subscribers or the shared memory,
+  then (clients (cloud \e n) (voxels \e n) (rgbd \e n) (subscribers \e n)),
+  (cpu (acquisition \e %) (process \e %) (threads (\e name \e id \e %) ...))
+  with the CPU time of the acquisition thread, of the whole process and
+  of each of its threads (acquisition, rpc, telemetry, or the system name
+  for the port threads of YARP; Linux and Windows only), and
+  (latency ...) with the distribution of the time from acquisition to
+  the write of depth, as given by the stats command. These metrics are
+  sampled by the acquisition thread and written by a thread of their
+  own.
+
+\section rpc_sec Rpc Commands
+reconfigure (img_width \e w) (img_height \e h) (depth_width \e w) (depth_height \e h) (info \e info) (period \e ms)
+- changes any subset of these options on the running server, without
+  reopening the device nor disconnecting the clients. The new setting is
+  applied between two frames and then published on /name/info:o; info
+  can only select a subset of the streams the server was started with,
+  and the depth resolution is fixed when [depth_undistortion] or
+  [registration] are given (likewise rgb with [rgb_undistortion]).
+
+subscribe \e id [(adaptive)] [(decimation \e n)] [(max_rate \e hz)]
+- opens the dedicated ports /name/\e id/depth:o and /name/\e id/image:o
+  for a single client and replies with their names. With adaptive, a
+  frame still being sent when the next one is ready counts as a drop,
+  which can only happen on carriers blocking the writer such as tcp (the
+  client connects adaptive streams through tcp instead of udp or mcast):
+  sustained drops lower the rate and then the resolution of that client
+  only, which are restored once it keeps up. decimation and max_rate
+  make the server send one frame every \e n or at most \e hz frames per
+  second to that client, skipping serialization and transmission of the
+  others. The ports are closed by unsubscribe \e id or when the client
+  disconnects; getSubscription \e id replies with the current level,
+  decimation and scale, and with the frames not sent on purpose so far,
+  which clients do not count as skipped.
+
+getFrameStats
+- replies with (depth ...) (rgb ...) (joints ...), each holding the
+  frames acquired from the device, published, unpublished (incomplete
+  frame) and unread (no reader connected to the shared port) and the
+  bytes published. Frames are numbered at acquisition
+  and the number is the count of the envelope of every stream, so that
+  clients can tell skipped and duplicated frames.
+
+trace [\e file]
+- writes the spans recorded so far to \e file, or to the file given
+  with --trace, and forgets them.
+
+stats [reset]
+- replies with the latency of each stage of the acquisition loop:
+  (update ...) waiting for the device, (read_depth ...), (read_rgb ...),
+  (read_skeleton ...), (process ...) for clouds, voxels, rgbd pairs,
+  subscriptions and shared memory, (copy ...) and (write ...) of the
+  streaming ports, along with (tick ...) for the whole loop and
+  (jitter ...) for the deviation of its start from the period. Each one
+  gives (count \e n) (mean \e ms) (p50 \e ms) (p90 \e ms) (p99 \e ms)
+  (max \e ms); (deadline (period \e ms) (ticks \e n) (misses \e n))
+  counts the loops lasting more than the period. With reset, the
+  statistics start over after the reply.
+
 \section tested_os_sec Tested OS
 Windows, Linux
 
@@ -68,16 +227,27 @@ Windows, Linux
 #include <yarp/os/RFModule.h>
 
 #include <kinectWrapper/kinectWrapper_server.h>
+#include <kinectWrapper/kinectLog.h>
 
 using namespace std;
 using namespace yarp::os;
 using namespace yarp::sig;
 using namespace kinectWrapper;
 
+/************************************************************************/
+void copyGroup(ResourceFinder &rf, Property &options, const string &group,
+               const string &section="")
+{
+    Bottle &grp=rf.findGroup((section.empty()?group:section).c_str());
+    if (!grp.isNull())
+        options.fromString(("("+group+" "+grp.tail().toString().c_str()+")").c_str(),false);
+}
+
 class KinectServer: public RFModule
 {
 protected:
-    KinectWrapperServer server;
+    deque<KinectWrapperServer*> servers;
+    string traceFile;
 
 public:
 
@@ -105,13 +275,98 @@ public:
             options.put("remap","true");
         if (rf.check("seatedMode"))
             options.put("seatedMode","true");
+        if (rf.check("cloud"))
+            options.put("cloud","true");
+        if (rf.check("extrinsics"))
+            options.put("extrinsics",rf.find("extrinsics"));
+        copyGroup(rf,options,"depth_undistortion");
+        copyGroup(rf,options,"rgb_undistortion");
+        copyGroup(rf,options,"registration");
+        if (rf.check("voxels"))
+        {
+            options.put("voxels","true");
+            options.put("voxel_size",rf.check("voxel_size",Value(0.02)).asDouble());
+            options.put("voxel_bands",rf.check("voxel_bands",Value(1)).asInt());
+            if (rf.check("voxel_box"))
+                options.put("voxel_box",rf.find("voxel_box"));
+        }
+        if (rf.check("rgbd"))
+            options.put("rgbd","true");
+        if (rf.check("multicast"))
+            options.put("multicast","true");
+        if (rf.check("synthetic"))
+        {
+            options.put("synthetic","true");
+            options.put("synthetic_players",rf.check("synthetic_players",Value(2)).asInt());
+        }
+        if (rf.check("shmem"))
+        {
+            options.put("shmem","true");
+            options.put("shmem_slots",rf.check("shmem_slots",Value(4)).asInt());
+        }
+
+        Bottle *devices=rf.find("devices").asList();
+        if ((devices==NULL) || (devices->size()==0))
+        {
+            if (rf.check("host_clock"))
+                options.put("host_clock","true");
+            if (rf.check("trace"))
+                options.put("trace",rf.find("trace").asString().c_str());
+            servers.push_back(new KinectWrapperServer);
+            return servers.back()->open(options);
+        }
+
+        //the spans of all the devices are written at once, when they are all closed
+        traceFile=rf.check("trace",Value("")).asString().c_str();
+
+        //one server per device, each with its own thread and ports,
+        //all stamping their envelopes with the same host clock
+        for (int i=0; i<devices->size(); i++)
+        {
+            Value &dev=devices->get(i);
+            string label=dev.toString().c_str();
+
+            Property devOptions(options.toString().c_str());
+            devOptions.put("name",(name+"/"+label).c_str());
+            if (dev.isInt())
+                devOptions.put("device_index",dev.asInt());
+            else
+                devOptions.put("device_serial",dev.asString().c_str());
+            devOptions.put("host_clock","true");
+
+            Bottle &grp=rf.findGroup(("device_"+label).c_str());
+            if (!grp.isNull())
+                devOptions.fromString(grp.tail().toString().c_str(),false);
+            copyGroup(rf,devOptions,"depth_undistortion","depth_undistortion_"+label);
+            copyGroup(rf,devOptions,"rgb_undistortion","rgb_undistortion_"+label);
+            copyGroup(rf,devOptions,"registration","registration_"+label);
+
+            servers.push_back(new KinectWrapperServer);
+            if (!servers.back()->open(devOptions))
+            {
+                close();
+                return false;
+            }
+        }
 
-        return server.open(options);
+        return true;
     }
 
     bool close()
     {
-        server.close();
+        for (size_t i=0; i<servers.size(); i++)
+        {
+            servers[i]->close();
+            delete servers[i];
+        }
+        servers.clear();
+
+        if (!traceFile.empty())
+        {
+            Tracer::dump(traceFile);
+            traceFile.clear();
+        }
+        Logger::shutdown();
         return true;
     }
 
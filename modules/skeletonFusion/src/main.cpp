@@ -0,0 +1,294 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+\defgroup skeletonFusion skeletonFusion
+
+Fuses the skeletons streamed by several \ref kinectServer instances.
+
+\section intro_sec Description
+This module reads the joints:o streams of several servers observing
+the same scene, associates the players seen by the different sensors
+and publishes a single list of fused players over /name/joints:o, in the
+same format of the servers. Joints are averaged weighting each sensor by
+the joint confidence and by the inverse squared distance of the player
+from the sensor.
+
+Joints are expected in a common frame: either the servers are given
+their extrinsics (and the module asks them the position of the
+sensors), or the extrinsics are given to this module per sensor.
+
+\section lib_sec Libraries
+- YARP libraries.
+- \ref kinectWrapper library.
+
+\section parameters_sec Parameters
+--name \e name
+- the module stem-name.
+
+--period \e period
+- the fusion period in [ms].
+
+--sensors "(\e server0 \e server1 ...)"
+- the names of the servers to fuse.
+
+--gate \e gate
+- maximum distance in [m] between the centers of mass of two players to
+  be considered the same person.
+
+--min_range \e range
+- range in [m] below which a sensor is not weighted more.
+
+--timeout \e timeout
+- data older than this time in [s] are not fused.
+
+--track_timeout \e timeout
+- time in [s] a fused player not seen any longer keeps its ID for, so
+  that a missed detection does not turn it into a new person.
+
+--carrier \e carrier
+- the protocol used to connect to the servers.
+
+[sensor_\e i]
+- optional group for the i-th sensor, containing its extrinsics
+  (\e r00 \e r01 \e r02 \e tx ... 0 0 0 1) to be applied by this module.
+
+\section tested_os_sec Tested OS
+Windows, Linux
+
+\author Ilaria Gori
+*/
+
+#include <cstdio>
+#include <deque>
+#include <algorithm>
+#include <vector>
+
+#include <yarp/os/Network.h>
+#include <yarp/os/RFModule.h>
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/Port.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/os/Time.h>
+
+#include <kinectWrapper/kinectTags.h>
+#include <kinectWrapper/kinectExtrinsics.h>
+#include <kinectWrapper/kinectSkeleton.h>
+#include <kinectWrapper/kinectSkeletonFusion.h>
+#include <kinectWrapper/kinectLog.h>
+
+using namespace std;
+using namespace yarp::os;
+using namespace kinectWrapper;
+
+class SkeletonFusionModule: public RFModule
+{
+protected:
+    struct Sensor
+    {
+        string remote;
+        BufferedPort<Bottle> *port;
+        ExtrinsicTransform extrinsics;
+        Bottle skeleton;
+        double stamp;
+        double arrival;
+    };
+
+    vector<Sensor> sensors;
+    BufferedPort<Bottle> jointsPort;
+    SkeletonFusion fusion;
+    Stamp ts;
+    double period;
+    double timeout;
+
+    /************************************************************************/
+    bool queryOrigin(const string &name, const string &remote, double *origin)
+    {
+        Port rpc;
+        rpc.open(name.c_str());
+        bool ok=Network::connect(rpc.getName().c_str(),("/"+remote+"/rpc").c_str());
+        if (ok)
+        {
+            Bottle cmd,reply;
+            cmd.addString(KINECT_TAGS_CMD_GETEXTRINSICS);
+            ok=rpc.write(cmd,reply);
+            Bottle *H=(reply.size()>1)?reply.get(1).asList():NULL;
+            ok=ok && (reply.get(0).asString()==KINECT_TAGS_CMD_ACK) && (H!=NULL) && (H->size()==16);
+            if (ok)
+            {
+                origin[0]=H->get(3).asDouble();
+                origin[1]=H->get(7).asDouble();
+                origin[2]=H->get(11).asDouble();
+            }
+        }
+        rpc.close();
+        return ok;
+    }
+
+public:
+    /************************************************************************/
+    bool configure(ResourceFinder &rf)
+    {
+        string name=rf.check("name",Value("skeletonFusion")).asString().c_str();
+        string carrier=rf.check("carrier",Value("udp")).asString().c_str();
+        period=rf.check("period",Value(30)).asInt()/1000.0;
+        timeout=rf.check("timeout",Value(0.2)).asDouble();
+        double gate=rf.check("gate",Value(0.5)).asDouble();
+        double minRange=rf.check("min_range",Value(0.5)).asDouble();
+        double trackTimeout=rf.check("track_timeout",Value(1.0)).asDouble();
+
+        Bottle *remotes=rf.find("sensors").asList();
+        if (remotes==NULL)
+        {
+            fprintf(stdout,"no sensors given\n");
+            return false;
+        }
+
+        if (!fusion.configure(remotes->size(),gate,minRange,trackTimeout))
+        {
+            fprintf(stdout,"wrong fusion configuration\n");
+            return false;
+        }
+
+        sensors.resize(remotes->size());
+        for (int i=0; i<remotes->size(); i++)
+        {
+            Sensor &sensor=sensors[i];
+            sensor.remote=remotes->get(i).asString().c_str();
+            sensor.stamp=sensor.arrival=-1.0;
+
+            char stem[256];
+            sprintf(stem,"/%s/%d",name.c_str(),i);
+            sensor.port=new BufferedPort<Bottle>;
+            sensor.port->open((string(stem)+"/joints:i").c_str());
+            if (!Network::connect(("/"+sensor.remote+"/joints:o").c_str(),sensor.port->getName().c_str(),carrier.c_str()))
+                fprintf(stdout,"unable to connect to %s, will keep on waiting for it\n",sensor.remote.c_str());
+
+            //extrinsics given here are applied locally, otherwise joints
+            //are supposed to be already transformed by the server
+            double origin[3]={0.0, 0.0, 0.0};
+            sprintf(stem,"sensor_%d",i);
+            Bottle *H=rf.findGroup(stem).find("extrinsics").asList();
+            if ((H!=NULL) && (H->size()==16))
+            {
+                double h[16];
+                for (int k=0; k<16; k++)
+                    h[k]=H->get(k).asDouble();
+                if (!sensor.extrinsics.set(h))
+                {
+                    fprintf(stdout,"wrong extrinsics for %s\n",sensor.remote.c_str());
+                    return false;
+                }
+                origin[0]=h[3];
+                origin[1]=h[7];
+                origin[2]=h[11];
+            }
+            else
+            {
+                sprintf(stem,"/%s/%d/rpc",name.c_str(),i);
+                if (!queryOrigin(stem,sensor.remote,origin))
+                    fprintf(stdout,"unable to retrieve the extrinsics of %s, assuming it in the origin\n",sensor.remote.c_str());
+            }
+            fusion.setSensorOrigin(i,origin);
+        }
+
+        jointsPort.open(("/"+name+"/joints:o").c_str());
+        return true;
+    }
+
+    /************************************************************************/
+    bool close()
+    {
+        for (size_t i=0; i<sensors.size(); i++)
+        {
+            sensors[i].port->interrupt();
+            sensors[i].port->close();
+            delete sensors[i].port;
+        }
+        sensors.clear();
+        jointsPort.interrupt();
+        jointsPort.close();
+        Logger::shutdown();
+        return true;
+    }
+
+    /************************************************************************/
+    double getPeriod()
+    {
+        return period;
+    }
+
+    /************************************************************************/
+    bool updateModule()
+    {
+        double now=Time::now();
+        double latest=-1.0;
+        vector<deque<Player> > players(sensors.size());
+        for (size_t i=0; i<sensors.size(); i++)
+        {
+            Sensor &sensor=sensors[i];
+            if (Bottle *skeleton=sensor.port->read(false))
+            {
+                sensor.skeleton=*skeleton;
+                sensor.extrinsics.apply(sensor.skeleton);
+                Stamp stamp;
+                sensor.port->getEnvelope(stamp);
+                sensor.stamp=stamp.isValid()?stamp.getTime():now;
+                sensor.arrival=now;
+            }
+
+            if ((sensor.arrival>=0.0) && (now-sensor.arrival<timeout))
+            {
+                parseSkeleton(sensor.skeleton,players[i]);
+                latest=std::max(latest,sensor.stamp);
+            }
+        }
+
+        if (latest<0.0)
+            return true;
+
+        deque<Player> fused;
+        fusion.fuse(players,fused,now);
+
+        writeSkeleton(fused,jointsPort.prepare());
+        ts.update(latest);
+        jointsPort.setEnvelope(ts);
+        jointsPort.write();
+
+        return true;
+    }
+};
+
+
+/************************************************************************/
+int main(int argc, char *argv[])
+{
+    Network yarp;
+    if (!yarp.checkNetwork())
+    {
+        fprintf(stdout, "Yarp network not available\n");
+        return 1;
+    }
+
+    ResourceFinder rf;
+    rf.setVerbose(true);
+    rf.setDefaultContext("skeletonFusion");
+    rf.setDefaultConfigFile("config.ini");
+    rf.configure(argc,argv);
+
+    SkeletonFusionModule mod;
+    return mod.runModule(rf);
+}
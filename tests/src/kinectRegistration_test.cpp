@@ -0,0 +1,203 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+\defgroup kinectRegistration_test kinectRegistration_test
+
+Unit test of the software registration on synthetic frames.
+
+\section intro_sec Description
+DepthRegistration is fed with synthetic packed depth buffers, so that
+neither a device nor a YARP network are needed. The test checks that:
+- identity extrinsics with the same intrinsics leave the frame as is;
+- a known translation shifts the pixels by the expected disparity;
+- when two points land on the same pixel the closest one is kept;
+- the player bits travel along with the depth.
+
+The exit code is the number of failed checks.
+
+\section tested_os_sec Tested OS
+Linux
+*/
+
+#include <stdio.h>
+#include <vector>
+
+#include <yarp/sig/Image.h>
+
+#include <kinectWrapper/kinectRegistration.h>
+
+using namespace std;
+using namespace yarp::sig;
+using namespace kinectWrapper;
+
+#define WIDTH       64
+#define HEIGHT      48
+#define FOCAL       200.0
+
+namespace
+{
+
+int failures=0;
+
+const double identity[9]={1.0,0.0,0.0, 0.0,1.0,0.0, 0.0,0.0,1.0};
+const double intrinsics[4]={FOCAL,FOCAL,WIDTH/2.0,HEIGHT/2.0};
+
+/************************************************************************/
+void check(const bool condition, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stdout,"FAILED: %s\n",what);
+        failures++;
+    }
+}
+
+/************************************************************************/
+unsigned short pack(const int mm, const int player)
+{
+    return (unsigned short)((mm<<3)|(player&0x0007));
+}
+
+/************************************************************************/
+bool setup(DepthRegistration &registration, const double tx)
+{
+    double translation[3]={tx,0.0,0.0};
+    return registration.setup(WIDTH,HEIGHT,intrinsics,WIDTH,HEIGHT,intrinsics,
+                              identity,translation);
+}
+
+/************************************************************************/
+void testIdentity()
+{
+    DepthRegistration registration;
+    check(setup(registration,0.0),"identity: setup");
+    check(registration.isReady(),"identity: ready");
+
+    //a slanted plane with a different player on each band of rows
+    vector<unsigned short> depth(WIDTH*HEIGHT);
+    for (int v=0; v<HEIGHT; v++)
+        for (int u=0; u<WIDTH; u++)
+            depth[v*WIDTH+u]=pack(800+10*u+v,v/8);
+    //holes stay holes
+    depth[5*WIDTH+7]=0;
+
+    vector<unsigned short> registered(WIDTH*HEIGHT);
+    registration.apply(&depth[0],&registered[0]);
+
+    int mismatches=0;
+    for (int i=0; i<WIDTH*HEIGHT; i++)
+        if (registered[i]!=depth[i])
+            mismatches++;
+    check(mismatches==0,"identity: the frame is left as is");
+}
+
+/************************************************************************/
+void testShift()
+{
+    //a fronto-parallel plane at 1 m with a 5 cm baseline: the disparity
+    //is FOCAL*0.05/1.0 = 10 pixels
+    const int mm=1000;
+    const int shift=10;
+
+    DepthRegistration registration;
+    check(setup(registration,0.05),"shift: setup");
+
+    vector<unsigned short> depth(WIDTH*HEIGHT);
+    for (int v=0; v<HEIGHT; v++)
+        for (int u=0; u<WIDTH; u++)
+            depth[v*WIDTH+u]=pack(mm,(u/4)%8);
+
+    vector<unsigned short> registered(WIDTH*HEIGHT);
+    registration.apply(&depth[0],&registered[0]);
+
+    int mismatches=0;
+    for (int v=0; v<HEIGHT; v++)
+    {
+        for (int u=0; u<WIDTH; u++)
+        {
+            //the first columns are not hit by any depth pixel
+            unsigned short expected=(u<shift)?0:depth[v*WIDTH+u-shift];
+            if (registered[v*WIDTH+u]!=expected)
+                mismatches++;
+        }
+    }
+    check(mismatches==0,"shift: pixels move by the disparity, players included");
+}
+
+/************************************************************************/
+void testOcclusion(const double tx, const int nearU, const int farU, const char *what)
+{
+    //the disparity is FOCAL*|tx|/z: 20 pixels at 0.5 m, 10 pixels at 1 m
+    DepthRegistration registration;
+    check(setup(registration,tx),what);
+
+    vector<unsigned short> depth(WIDTH*HEIGHT,0);
+    const int v=HEIGHT/2;
+    depth[v*WIDTH+nearU]=pack(500,1);
+    depth[v*WIDTH+farU]=pack(1000,2);
+
+    vector<unsigned short> registered(WIDTH*HEIGHT);
+    registration.apply(&depth[0],&registered[0]);
+
+    int target=nearU+((tx>0.0)?20:-20);
+    check(registered[v*WIDTH+target]==pack(500,1),what);
+
+    int hit=0;
+    for (int i=0; i<WIDTH*HEIGHT; i++)
+        if (registered[i]!=0)
+            hit++;
+    check(hit==1,what);
+}
+
+/************************************************************************/
+void testImage()
+{
+    DepthRegistration registration;
+    setup(registration,0.0);
+
+    ImageOf<PixelMono16> depth,registered;
+    depth.resize(WIDTH,HEIGHT);
+    for (int v=0; v<HEIGHT; v++)
+        for (int u=0; u<WIDTH; u++)
+            depth(u,v)=pack(1500,3);
+
+    check(registration.apply(depth,registered),"image: apply");
+    check((registered.width()==WIDTH) && (registered.height()==HEIGHT),"image: size");
+    check(registered(WIDTH/2,HEIGHT/2)==pack(1500,3),"image: content");
+
+    depth.resize(WIDTH/2,HEIGHT/2);
+    check(!registration.apply(depth,registered),"image: wrong size is rejected");
+}
+
+} //end unnamed namespace
+
+/************************************************************************/
+int main()
+{
+    testIdentity();
+    testShift();
+    //the near point is scanned first, then the far one overwrites nothing
+    testOcclusion(0.05,10,20,"z-buffer: the closest point is kept (near first)");
+    //the far point is scanned first, then the near one replaces it
+    testOcclusion(-0.05,30,20,"z-buffer: the closest point is kept (far first)");
+    testImage();
+
+    if (failures==0)
+        fprintf(stdout,"all checks passed\n");
+
+    return failures;
+}
@@ -0,0 +1,214 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+\defgroup kinectSkeletonFusion_test kinectSkeletonFusion_test
+
+Unit test of the fusion of the skeletons seen by several sensors.
+
+\section intro_sec Description
+SkeletonFusion is fed with synthetic players, so that neither a device
+nor a YARP network are needed. The test checks that:
+- the views of the same person from two sensors are fused, weighting
+  the closer sensor more;
+- two players seen by the same sensor are never merged;
+- fused players keep their ID while they move, and also through missed
+  detections shorter than the timeout;
+- the ID of a player not seen for longer than the timeout is retired.
+
+The exit code is the number of failed checks.
+
+\section tested_os_sec Tested OS
+Linux
+*/
+
+#include <stdio.h>
+#include <math.h>
+#include <deque>
+#include <vector>
+
+#include <kinectWrapper/kinectSkeletonFusion.h>
+
+using namespace std;
+using namespace kinectWrapper;
+
+#define TIMEOUT     1.0
+#define TOLERANCE   1e-9
+
+namespace
+{
+
+int failures=0;
+
+/************************************************************************/
+void check(const bool condition, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stdout,"FAILED: %s\n",what);
+        failures++;
+    }
+}
+
+/************************************************************************/
+Player makePlayer(const int ID, const double x, const double z)
+{
+    //head above the center of mass, both fully confident
+    Player p;
+    p.ID=ID;
+    Joint joint;
+    joint.u=joint.v=0;
+    joint.x=x;
+    joint.y=0.0;
+    joint.z=z;
+    joint.confidence=1.0;
+    p.skeleton[KINECT_TAGS_BODYPART_COM]=joint;
+    joint.y=0.6;
+    p.skeleton[KINECT_TAGS_BODYPART_HEAD]=joint;
+    return p;
+}
+
+/************************************************************************/
+void setup(SkeletonFusion &fusion)
+{
+    //the second sensor faces the first one from 4 m away
+    fusion.configure(2,0.5,0.5,TIMEOUT);
+    const double origin[3]={0.0,0.0,4.0};
+    fusion.setSensorOrigin(1,origin);
+}
+
+/************************************************************************/
+void testFusion()
+{
+    SkeletonFusion fusion;
+    setup(fusion);
+
+    //a person 1 m from the first sensor and 3 m from the second one
+    vector<deque<Player> > players(2);
+    players[0].push_back(makePlayer(1,0.0,1.0));
+    players[1].push_back(makePlayer(5,0.1,1.0));
+
+    deque<Player> fused;
+    fusion.fuse(players,fused,0.0);
+    check(fused.size()==1,"fusion: the two views are merged");
+    if (fused.size()==1)
+    {
+        //weights go with the inverse squared range of the centers of mass
+        double w=1.0/(0.1*0.1+3.0*3.0);
+        double expected=(0.1*w)/(1.0+w);
+        check(fabs(fused[0].skeleton[KINECT_TAGS_BODYPART_HEAD].x-expected)<TOLERANCE,
+              "fusion: the closer sensor weighs more");
+        check(fabs(fused[0].skeleton[KINECT_TAGS_BODYPART_HEAD].y-0.6)<TOLERANCE,
+              "fusion: all the joints are fused");
+    }
+}
+
+/************************************************************************/
+void testSameSensor()
+{
+    SkeletonFusion fusion;
+    setup(fusion);
+
+    //two people closer than the gate, both seen by the first sensor only
+    vector<deque<Player> > players(2);
+    players[0].push_back(makePlayer(1,0.0,2.0));
+    players[0].push_back(makePlayer(2,0.3,2.0));
+
+    deque<Player> fused;
+    fusion.fuse(players,fused,0.0);
+    check(fused.size()==2,"same sensor: players are never merged");
+    if (fused.size()==2)
+        check(fused[0].ID!=fused[1].ID,"same sensor: distinct IDs");
+}
+
+/************************************************************************/
+int getID(const deque<Player> &fused, const double x)
+{
+    for (size_t i=0; i<fused.size(); i++)
+    {
+        Skeleton::const_iterator com=fused[i].skeleton.find(KINECT_TAGS_BODYPART_COM);
+        if ((com!=fused[i].skeleton.end()) && (fabs(com->second.x-x)<0.25))
+            return fused[i].ID;
+    }
+    return -1;
+}
+
+/************************************************************************/
+void testTracking()
+{
+    SkeletonFusion fusion;
+    setup(fusion);
+
+    vector<deque<Player> > players(2);
+    deque<Player> fused;
+
+    //two people walking side by side
+    players[0].push_back(makePlayer(1,-1.0,2.0));
+    players[0].push_back(makePlayer(2,1.0,2.0));
+    fusion.fuse(players,fused,0.0);
+    int left=getID(fused,-1.0);
+    int right=getID(fused,1.0);
+    check((left>0) && (right>0) && (left!=right),"tracking: distinct IDs");
+
+    players[0].clear();
+    players[0].push_back(makePlayer(1,-0.9,2.0));
+    players[0].push_back(makePlayer(2,1.1,2.0));
+    fusion.fuse(players,fused,0.1);
+    check((getID(fused,-0.9)==left) && (getID(fused,1.1)==right),"tracking: IDs follow the motion");
+
+    //the left person is missed for a few frames
+    players[0].clear();
+    players[0].push_back(makePlayer(2,1.1,2.0));
+    fusion.fuse(players,fused,0.2);
+    fusion.fuse(players,fused,0.3);
+    check((fused.size()==1) && (getID(fused,1.1)==right),"tracking: missed player is not reported");
+
+    players[0].clear();
+    players[0].push_back(makePlayer(1,-0.9,2.0));
+    players[0].push_back(makePlayer(2,1.1,2.0));
+    fusion.fuse(players,fused,0.4);
+    check(getID(fused,-0.9)==left,"tracking: ID kept through a missed detection");
+    check(getID(fused,1.1)==right,"tracking: other IDs are not affected");
+
+    //the left person goes away for longer than the timeout
+    players[0].clear();
+    players[0].push_back(makePlayer(2,1.1,2.0));
+    fusion.fuse(players,fused,1.0);
+    fusion.fuse(players,fused,1.0+TIMEOUT);
+
+    players[0].clear();
+    players[0].push_back(makePlayer(1,-0.9,2.0));
+    players[0].push_back(makePlayer(2,1.1,2.0));
+    fusion.fuse(players,fused,1.1+TIMEOUT);
+    int newLeft=getID(fused,-0.9);
+    check((newLeft>0) && (newLeft!=left) && (newLeft!=right),"tracking: ID retired after the timeout");
+    check(getID(fused,1.1)==right,"tracking: continuous track keeps its ID");
+}
+
+} //end unnamed namespace
+
+/************************************************************************/
+int main()
+{
+    testFusion();
+    testSameSensor();
+    testTracking();
+
+    if (failures==0)
+        fprintf(stdout,"all checks passed\n");
+
+    return failures;
+}
@@ -0,0 +1,250 @@
+/* Copyright: (C) 2014 iCub Facility - Istituto Italiano di Tecnologia
+ * Authors: Ilaria Gori, Tobias Fischer
+ * email:   ilaria.gori@iit.it, t.fischer@imperial.ac.uk
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found in the file LICENSE located in the
+ * root directory.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+\defgroup kinectVoxelGrid_test kinectVoxelGrid_test
+
+Unit test of the voxel grid on synthetic frames.
+
+\section intro_sec Description
+VoxelGrid is fed with synthetic packed depth images, so that neither a
+device nor a YARP network are needed. The centroids are compared with
+the ones of a plain serial accumulation in double precision. The test
+checks that:
+- one to five bands give the same voxels and centroids as the serial
+  accumulation, also over consecutive frames;
+- holes and points outside the bounding box are discarded;
+- depth images whose size differs from the projector one are rejected.
+
+The exit code is the number of failed checks.
+
+\section tested_os_sec Tested OS
+Linux
+*/
+
+#include <stdio.h>
+#include <math.h>
+#include <map>
+#include <vector>
+
+#include <yarp/sig/Image.h>
+
+#include <kinectWrapper/kinectCloud.h>
+#include <kinectWrapper/kinectVoxelGrid.h>
+
+using namespace std;
+using namespace yarp::sig;
+using namespace kinectWrapper;
+
+#define WIDTH       160
+#define HEIGHT      120
+#define VOXEL       0.02
+#define TOLERANCE   1e-4
+
+namespace
+{
+
+int failures=0;
+
+const double box[6]={-0.5,0.5, -0.4,0.4, 0.5,1.6};
+
+/************************************************************************/
+void check(const bool condition, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stdout,"FAILED: %s\n",what);
+        failures++;
+    }
+}
+
+/************************************************************************/
+void setupProjector(CloudProjector &projector)
+{
+    projector.setup(WIDTH,HEIGHT,1.0862,0.7878);
+}
+
+/************************************************************************/
+void makeFrame(const int seed, ImageOf<PixelMono16> &depth)
+{
+    //a slanted plane running out of the box, with holes and players
+    depth.resize(WIDTH,HEIGHT);
+    unsigned int state=seed;
+    for (int v=0; v<HEIGHT; v++)
+    {
+        for (int u=0; u<WIDTH; u++)
+        {
+            state=state*1103515245U+12345U;
+            int mm=600+8*u+3*v+seed*40+(int)((state>>16)%7);
+            if ((u*7+v*3)%13==0)
+                mm=0;
+            depth(u,v)=(unsigned short)((mm<<3)|((u/20)&0x0007));
+        }
+    }
+}
+
+/************************************************************************/
+void getReference(const ImageOf<PixelMono16> &depth, CloudProjector &projector,
+                  vector<double> &centroids)
+{
+    ImageOf<PixelRgbFloat> cloud;
+    projector.project(depth,cloud);
+
+    //same binning of the grid, then plain sums in double precision
+    float scale=(float)(1.0/VOXEL);
+    map<int,vector<double> > voxels;
+    for (int v=0; v<HEIGHT; v++)
+    {
+        for (int u=0; u<WIDTH; u++)
+        {
+            const PixelRgbFloat &p=cloud(u,v);
+            if ((p.r>=(float)box[0]) && (p.r<=(float)box[1]) &&
+                (p.g>=(float)box[2]) && (p.g<=(float)box[3]) &&
+                (p.b>=(float)box[4]) && (p.b<=(float)box[5]))
+            {
+                int ix=(int)((p.r-(float)box[0])*scale);
+                int iy=(int)((p.g-(float)box[2])*scale);
+                int iz=(int)((p.b-(float)box[4])*scale);
+                vector<double> &s=voxels[(iz*1000+iy)*1000+ix];
+                s.resize(4,0.0);
+                s[0]+=p.r;
+                s[1]+=p.g;
+                s[2]+=p.b;
+                s[3]+=1.0;
+            }
+        }
+    }
+
+    centroids.clear();
+    for (map<int,vector<double> >::iterator it=voxels.begin(); it!=voxels.end(); it++)
+        for (int i=0; i<3; i++)
+            centroids.push_back(it->second[i]/it->second[3]);
+}
+
+/************************************************************************/
+bool matches(const ImageOf<PixelRgbFloat> &centroids, const vector<double> &reference)
+{
+    int n=(int)reference.size()/3;
+    if ((centroids.width()!=n) || ((n>0) && (centroids.height()!=1)))
+        return false;
+
+    //every centroid has to match a distinct reference one
+    vector<bool> taken(n,false);
+    for (int i=0; i<n; i++)
+    {
+        const PixelRgbFloat &c=centroids(i,0);
+        int found=-1;
+        for (int j=0; (j<n) && (found<0); j++)
+        {
+            if (!taken[j] && (fabs(c.r-reference[3*j])<TOLERANCE) &&
+                (fabs(c.g-reference[3*j+1])<TOLERANCE) &&
+                (fabs(c.b-reference[3*j+2])<TOLERANCE))
+                found=j;
+        }
+
+        if (found<0)
+            return false;
+        taken[found]=true;
+    }
+
+    return true;
+}
+
+/************************************************************************/
+void testBands(const int nBands)
+{
+    char what[64];
+    sprintf(what,"%d band(s)",nBands);
+
+    CloudProjector projector;
+    setupProjector(projector);
+    VoxelGrid grid;
+    check(grid.configure(box,VOXEL,nBands),what);
+
+    //the grid has to start anew on each frame
+    for (int seed=0; seed<3; seed++)
+    {
+        ImageOf<PixelMono16> depth;
+        makeFrame(seed,depth);
+        vector<double> reference;
+        getReference(depth,projector,reference);
+
+        ImageOf<PixelRgbFloat> centroids;
+        int n=grid.compute(depth,projector,centroids);
+        check((n>0) && (n==(int)reference.size()/3),what);
+        check(matches(centroids,reference),what);
+    }
+}
+
+/************************************************************************/
+void testDiscarded()
+{
+    CloudProjector projector;
+    setupProjector(projector);
+    VoxelGrid grid;
+    grid.configure(box,VOXEL,3);
+
+    ImageOf<PixelRgbFloat> centroids;
+    ImageOf<PixelMono16> depth;
+    depth.resize(WIDTH,HEIGHT);
+
+    //all holes
+    for (int v=0; v<HEIGHT; v++)
+        for (int u=0; u<WIDTH; u++)
+            depth(u,v)=0x0001;
+    check(grid.compute(depth,projector,centroids)==0,"holes are discarded");
+
+    //all beyond the far side of the box
+    for (int v=0; v<HEIGHT; v++)
+        for (int u=0; u<WIDTH; u++)
+            depth(u,v)=(unsigned short)(3000<<3);
+    check(grid.compute(depth,projector,centroids)==0,"points out of the box are discarded");
+}
+
+/************************************************************************/
+void testSize()
+{
+    CloudProjector projector;
+    VoxelGrid grid;
+    grid.configure(box,VOXEL,2);
+
+    ImageOf<PixelRgbFloat> centroids;
+    ImageOf<PixelMono16> depth;
+    makeFrame(0,depth);
+    check(grid.compute(depth,projector,centroids)<0,"size: projector not ready is rejected");
+
+    setupProjector(projector);
+    depth.resize(WIDTH*2,HEIGHT*2);
+    check(grid.compute(depth,projector,centroids)<0,"size: larger depth is rejected");
+    depth.resize(WIDTH/2,HEIGHT/2);
+    check(grid.compute(depth,projector,centroids)<0,"size: smaller depth is rejected");
+}
+
+} //end unnamed namespace
+
+/************************************************************************/
+int main()
+{
+    for (int nBands=1; nBands<=5; nBands++)
+        testBands(nBands);
+    testDiscarded();
+    testSize();
+
+    if (failures==0)
+        fprintf(stdout,"all checks passed\n");
+
+    return failures;
+}